@@ -0,0 +1,337 @@
+/*
+ * SyntheticCorpus.cpp
+ */
+
+#include "SyntheticCorpus.h"
+
+#include <cstdio>
+
+#include "src/JsonWriter.h"
+
+namespace {
+
+const char *const kOnes[] = {"zero",    "one",     "two",       "three",    "four",     "five",    "six",
+                             "seven",   "eight",   "nine",      "ten",      "eleven",   "twelve",  "thirteen",
+                             "fourteen", "fifteen", "sixteen",  "seventeen", "eighteen", "nineteen"};
+const char *const kTens[] = {"", "", "twenty", "thirty", "forty", "fifty", "sixty", "seventy", "eighty", "ninety"};
+
+// a word index favoring the start of the vocabulary
+size_t SkewedWord(CorpusRandom &random, size_t vocabulary_size) {
+  double f = random.Fraction();
+  return static_cast<size_t>(f * f * vocabulary_size);
+}
+
+// seconds with the precision of the NLP and CTM files
+std::string Seconds(double seconds) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.4f", seconds);
+  return buffer;
+}
+
+double SpokenDuration(const std::string &word) { return 0.2 + 0.01 * (word.size() % 10); }
+
+void Append(std::vector<std::string> &words, const std::vector<std::string> &more) {
+  words.insert(words.end(), more.begin(), more.end());
+}
+
+// e.g. nineteen eighty seven, nineteen oh five or twenty twelve
+std::vector<std::string> SpellYear(int year) {
+  if (year % 1000 < 10) {
+    // two thousand (and) five
+    return SpellNumber(year);
+  }
+  std::vector<std::string> words = SpellNumber(year / 100);
+  if (year % 100 == 0) {
+    words.push_back("hundred");
+  } else if (year % 100 < 10) {
+    words.push_back("oh");
+    Append(words, SpellNumber(year % 100));
+  } else {
+    Append(words, SpellNumber(year % 100));
+  }
+  return words;
+}
+
+// a number, a year or an amount of money, the written tokens and their verbalizations
+SyntheticEntity MakeEntity(CorpusRandom &random, size_t index, std::vector<std::string> &tokens) {
+  SyntheticEntity entity;
+  entity.id = std::to_string(index);
+  switch (random.Below(3)) {
+    case 0: {
+      int number = random.Below(1000);
+      entity.label = "CARDINAL";
+      tokens.push_back(std::to_string(number));
+      entity.verbalizations.push_back(SpellNumber(number));
+      if (number >= 100 && number % 100 >= 10) {
+        // one twenty three
+        auto shortened = SpellNumber(number / 100);
+        Append(shortened, SpellNumber(number % 100));
+        entity.verbalizations.push_back(shortened);
+      }
+      break;
+    }
+    case 1: {
+      int year = 1900 + random.Below(200);
+      entity.label = "YEAR";
+      tokens.push_back(std::to_string(year));
+      entity.verbalizations.push_back(SpellYear(year));
+      if (entity.verbalizations[0] != SpellNumber(year)) {
+        entity.verbalizations.push_back(SpellNumber(year));
+      } else if (year > 2000 && year < 2010) {
+        entity.verbalizations.push_back({"two", "thousand", "and", kOnes[year % 10]});
+      }
+      break;
+    }
+    default: {
+      int amount = 1 + random.Below(999);
+      entity.label = "MONEY";
+      tokens.push_back("$");
+      tokens.push_back(std::to_string(amount));
+      auto words = SpellNumber(amount);
+      words.push_back(amount == 1 ? "dollar" : "dollars");
+      entity.verbalizations.push_back(words);
+      break;
+    }
+  }
+  return entity;
+}
+
+}  // namespace
+
+uint64_t CorpusRandom::Next() {
+  uint64_t z = (state_ += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+size_t CorpusRandom::Below(size_t n) { return n == 0 ? 0 : Next() % n; }
+
+double CorpusRandom::Fraction() { return (Next() >> 11) * (1.0 / 9007199254740992.0); }
+
+std::string CorpusWord(size_t index) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "w%06zu", index);
+  return buffer;
+}
+
+std::vector<std::string> SpellNumber(int number) {
+  std::vector<std::string> words;
+  if (number >= 1000) {
+    words = SpellNumber(number / 1000);
+    words.push_back("thousand");
+    number %= 1000;
+    if (number == 0) {
+      return words;
+    }
+  }
+  if (number >= 100) {
+    words.push_back(kOnes[number / 100]);
+    words.push_back("hundred");
+    number %= 100;
+    if (number == 0) {
+      return words;
+    }
+  }
+  if (number >= 20) {
+    words.push_back(kTens[number / 10]);
+    if (number % 10 != 0) {
+      words.push_back(kOnes[number % 10]);
+    }
+  } else if (number > 0 || words.empty()) {
+    words.push_back(kOnes[number]);
+  }
+  return words;
+}
+
+SyntheticCorpus GenerateCorpus(const CorpusOptions &options) {
+  CorpusRandom random(options.seed);
+  size_t vocabulary_size = options.vocabulary_size > 0 ? options.vocabulary_size : 1;
+  int num_speakers = options.num_speakers > 0 ? options.num_speakers : 1;
+
+  SyntheticCorpus corpus;
+  corpus.ref.reserve(options.ref_words);
+  corpus.ref_rows.reserve(options.ref_words);
+  corpus.hyp.reserve(options.ref_words * (1 + options.insertion_rate));
+  corpus.hyp_timings.reserve(corpus.hyp.capacity());
+
+  double ts = 0;
+  int speaker = 1;
+  size_t words_left_in_sentence = 8 + random.Below(9);
+  size_t sentences_left_in_turn = 1 + random.Below(4);
+
+  std::vector<std::string> tokens;
+  for (size_t i = 0; i < options.ref_words; i++) {
+    // a word, or an entity written with its own tokens
+    tokens.clear();
+    int entity = -1;
+    const std::vector<std::string> *spoken = &tokens;
+    if (options.entity_rate > 0 && random.Fraction() < options.entity_rate) {
+      entity = corpus.entities.size();
+      corpus.entities.push_back(MakeEntity(random, corpus.entities.size(), tokens));
+      auto &verbalizations = corpus.entities.back().verbalizations;
+      spoken = &verbalizations[random.Fraction() < 0.8 ? 0 : random.Below(verbalizations.size())];
+    } else {
+      tokens.push_back(CorpusWord(SkewedWord(random, vocabulary_size)));
+    }
+
+    // the hypothesis words
+    double start = ts;
+    for (auto &word : *spoken) {
+      double duration = SpokenDuration(word);
+      corpus.spoken_ref_words++;
+      double edit = random.Fraction();
+      if (edit < options.deletion_rate) {
+        corpus.deletions++;
+      } else if (edit < options.deletion_rate + options.substitution_rate) {
+        // any other word
+        size_t other = random.Below(vocabulary_size);
+        std::string substitute = CorpusWord(other);
+        if (substitute == word) {
+          substitute = CorpusWord((other + 1) % vocabulary_size);
+        }
+        corpus.substitutions++;
+        corpus.hyp.push_back(substitute);
+        corpus.hyp_timings.push_back({ts, duration});
+      } else {
+        corpus.hyp.push_back(word);
+        corpus.hyp_timings.push_back({ts, duration});
+      }
+
+      if (random.Fraction() < options.insertion_rate) {
+        corpus.insertions++;
+        corpus.hyp.push_back(CorpusWord(random.Below(vocabulary_size)));
+        corpus.hyp_timings.push_back({ts + duration, 0.05});
+      }
+      ts += duration + 0.05;
+    }
+
+    // the reference rows share the time of what was said
+    double row_duration = (ts - 0.05 - start) / tokens.size();
+    for (size_t t = 0; t < tokens.size(); t++) {
+      ReferenceRow row;
+      row.speaker = speaker;
+      row.start = start + t * row_duration;
+      row.end = row.start + row_duration;
+      row.entity = entity;
+      corpus.ref.push_back(tokens[t]);
+      corpus.ref_rows.push_back(row);
+    }
+
+    if (--words_left_in_sentence == 0) {
+      corpus.ref_rows.back().sentence_end = true;
+      ts += 0.5;
+      words_left_in_sentence = 8 + random.Below(9);
+      if (--sentences_left_in_turn == 0) {
+        if (num_speakers > 1) {
+          // anyone but the current speaker
+          speaker = (speaker + random.Below(num_speakers - 1)) % num_speakers + 1;
+        }
+        sentences_left_in_turn = 1 + random.Below(4);
+      }
+    }
+  }
+
+  return corpus;
+}
+
+std::vector<std::string> GenerateSynonymRules(const SyntheticCorpus &corpus, size_t num_rules, uint64_t seed) {
+  CorpusRandom random(seed);
+  std::vector<std::string> rules;
+  rules.reserve(num_rules);
+  for (size_t r = 0; r < num_rules; r++) {
+    std::string lhs;
+    size_t at = corpus.ref.size() >= 2 ? random.Below(corpus.ref.size() - 1) : 0;
+    if (corpus.ref.size() >= 2 && random.Below(4) != 0 && corpus.ref_rows[at].entity < 0 &&
+        corpus.ref_rows[at + 1].entity < 0) {
+      lhs = corpus.ref[at] + " " + corpus.ref[at + 1];
+    } else {
+      // unlikely to match, like most rules of a large set
+      lhs = "s" + CorpusWord(random.Below(1000000)).substr(1);
+    }
+
+    // one or two alternatives of one to three words
+    std::string rhs;
+    size_t num_alternatives = 1 + random.Below(2);
+    for (size_t a = 0; a < num_alternatives; a++) {
+      if (a > 0) {
+        rhs += "; ";
+      }
+      size_t num_words = 1 + random.Below(3);
+      for (size_t w = 0; w < num_words; w++) {
+        if (w > 0) {
+          rhs += " ";
+        }
+        rhs += "r" + CorpusWord(random.Below(100000)).substr(1);
+      }
+    }
+    rules.push_back(lhs + " | " + rhs);
+  }
+  return rules;
+}
+
+void WriteNlp(const SyntheticCorpus &corpus, std::ostream &out) {
+  out << "token|speaker|ts|endTs|punctuation|case|tags|wer_tags\n";
+  for (size_t i = 0; i < corpus.ref.size(); i++) {
+    auto &row = corpus.ref_rows[i];
+    out << corpus.ref[i] << '|' << row.speaker << '|' << Seconds(row.start) << '|' << Seconds(row.end) << '|'
+        << (row.sentence_end ? "." : "");
+    if (row.entity >= 0) {
+      auto &entity = corpus.entities[row.entity];
+      out << "|CA|['" << entity.id << ':' << entity.label << "']|[]\n";
+    } else {
+      out << "|LC|[]|[]\n";
+    }
+  }
+}
+
+void WriteNorm(const SyntheticCorpus &corpus, std::ostream &out) {
+  JsonWriter writer(out);
+  writer.BeginObject();
+  for (auto &entity : corpus.entities) {
+    writer.Key(entity.id);
+    writer.BeginObject();
+    writer.Key("candidates");
+    writer.BeginArray();
+    size_t num_candidates = entity.verbalizations.size();
+    for (size_t c = 0; c < num_candidates; c++) {
+      writer.BeginObject();
+      double probability = num_candidates == 1 ? 1.0 : (c == 0 ? 0.8 : 0.2 / (num_candidates - 1));
+      writer.Member("probability", probability);
+      writer.Key("verbalization");
+      writer.BeginArray();
+      for (auto &word : entity.verbalizations[c]) {
+        writer.Value(word);
+      }
+      writer.EndArray();
+      writer.EndObject();
+    }
+    writer.EndArray();
+    writer.Member("class", entity.label);
+    writer.EndObject();
+  }
+  writer.EndObject();
+  out << '\n';
+}
+
+void WriteCtm(const SyntheticCorpus &corpus, std::ostream &out) {
+  for (size_t i = 0; i < corpus.hyp.size(); i++) {
+    auto &timing = corpus.hyp_timings[i];
+    out << "synthetic.wav 1 " << Seconds(timing.start) << ' ' << Seconds(timing.duration) << ' ' << corpus.hyp[i]
+        << ' ' << (i % 7 == 0 ? "0.62" : "0.97") << '\n';
+  }
+}
+
+void WriteText(const std::vector<std::string> &tokens, std::ostream &out) {
+  for (size_t i = 0; i < tokens.size(); i++) {
+    out << tokens[i] << (i % 12 == 11 || i + 1 == tokens.size() ? '\n' : ' ');
+  }
+}
+
+void WriteSynonymRules(const std::vector<std::string> &rules, std::ostream &out) {
+  out << "# synthetic synonym rules\n";
+  out << "# format : LHS<pipe>RHS\n";
+  for (auto &rule : rules) {
+    out << rule << '\n';
+  }
+}
@@ -0,0 +1,108 @@
+/*
+ * SyntheticCorpus.h
+ *
+ * Reference/hypothesis pairs with a targeted error rate, generated from a seed
+ * for the benchmarks and scaling tests.  The reference can have speakers and
+ * entities normalized by a JSON sidecar, like the NLP files of production, and
+ * the hypothesis timings for a CTM.  The generator doesn't rely on the std
+ * distributions, so a seed gives the same corpus with every compiler and platform.
+ */
+
+#ifndef __SYNTHETIC_CORPUS_H__
+#define __SYNTHETIC_CORPUS_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct CorpusOptions {
+  uint64_t seed = 1;
+  size_t ref_words = 1000;
+  size_t vocabulary_size = 10000;
+  // fractions of the spoken reference words deleted, substituted or followed by an inserted word
+  double deletion_rate = 0.05;
+  double substitution_rate = 0.05;
+  double insertion_rate = 0.05;
+  int num_speakers = 2;
+  // fraction of the reference words replaced by an entity: a number, a year or an amount of money
+  double entity_rate = 0;
+};
+
+// splitmix64
+class CorpusRandom {
+ public:
+  explicit CorpusRandom(uint64_t seed) : state_(seed) {}
+  uint64_t Next();
+  // in [0, n)
+  size_t Below(size_t n);
+  // in [0, 1)
+  double Fraction();
+
+ private:
+  uint64_t state_;
+};
+
+// an entity of the reference and its verbalizations, the first one being the likeliest
+struct SyntheticEntity {
+  std::string id;
+  std::string label;
+  std::vector<std::vector<std::string>> verbalizations;
+};
+
+// the NLP row of a reference token, besides the token
+struct ReferenceRow {
+  int speaker = 1;
+  bool sentence_end = false;
+  double start = 0;
+  double end = 0;
+  // index in SyntheticCorpus::entities, -1 for plain words
+  int entity = -1;
+};
+
+struct HypothesisTiming {
+  double start = 0;
+  double duration = 0;
+};
+
+struct SyntheticCorpus {
+  // the reference tokens, as written in the NLP rows: an entity can span several
+  std::vector<std::string> ref;
+  std::vector<ReferenceRow> ref_rows;
+  std::vector<SyntheticEntity> entities;
+
+  // the hypothesis words, the entities being spoken out
+  std::vector<std::string> hyp;
+  std::vector<HypothesisTiming> hyp_timings;
+
+  // the edits of the spoken reference words making the hypothesis
+  size_t spoken_ref_words = 0;
+  size_t insertions = 0;
+  size_t deletions = 0;
+  size_t substitutions = 0;
+};
+
+// w000000, w000001, ...
+std::string CorpusWord(size_t index);
+// e.g. one hundred twenty three, for 0 to 999999
+std::vector<std::string> SpellNumber(int number);
+
+// The words are drawn with a skew towards the start of the vocabulary, so that
+// some of them repeat a lot like in real transcripts.
+SyntheticCorpus GenerateCorpus(const CorpusOptions &options);
+
+// "lhs | rhs" synonym rules, most of them matching a bigram of the reference
+std::vector<std::string> GenerateSynonymRules(const SyntheticCorpus &corpus, size_t num_rules, uint64_t seed);
+
+// the reference rows, lower-cased, with a period ending the sentences and the entity labels
+void WriteNlp(const SyntheticCorpus &corpus, std::ostream &out);
+// the normalization sidecar of the NLP entities
+void WriteNorm(const SyntheticCorpus &corpus, std::ostream &out);
+// one CTM row per hypothesis word, with timings and confidences
+void WriteCtm(const SyntheticCorpus &corpus, std::ostream &out);
+// plain text, a few words per line
+void WriteText(const std::vector<std::string> &tokens, std::ostream &out);
+void WriteSynonymRules(const std::vector<std::string> &rules, std::ostream &out);
+
+#endif  // __SYNTHETIC_CORPUS_H__
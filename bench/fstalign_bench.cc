@@ -0,0 +1,285 @@
+/*
+ * fstalign_bench.cc
+ *
+ * Micro benchmarks of the alignment hot paths and end-to-end runs on synthetic
+ * corpora, e.g.
+ *   fstalign_bench --benchmark_filter=Fstalign
+ */
+
+#include <benchmark/benchmark.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <unordered_map>
+
+#include "SyntheticCorpus.h"
+#include "src/AdaptedComposition.h"
+#include "src/Ctm.h"
+#include "src/Nlp.h"
+#include "src/OneBestFstLoader.h"
+#include "src/PathHeap.h"
+#include "src/SynonymEngine.h"
+#include "src/fast-d.h"
+#include "src/fstalign.h"
+
+namespace {
+
+// a corpus of ref_words with errors at a rate of wer_percent, a third of each kind
+CorpusOptions BenchCorpus(size_t ref_words, int wer_percent) {
+  CorpusOptions options;
+  options.ref_words = ref_words;
+  options.deletion_rate = options.substitution_rate = options.insertion_rate = wer_percent / 300.0;
+  return options;
+}
+
+std::vector<int> TokenIds(const std::vector<std::string> &tokens, std::unordered_map<std::string, int> &ids) {
+  std::vector<int> token_ids;
+  token_ids.reserve(tokens.size());
+  for (auto &token : tokens) {
+    token_ids.push_back(ids.emplace(token, ids.size() + 1).first->second);
+  }
+  return token_ids;
+}
+
+fst::StdVectorFst LinearFst(const std::vector<std::string> &tokens, SymbolInterner &vocab) {
+  OneBestFstLoader loader;
+  loader.LoadTokens(tokens);
+  auto token_ids = loader.convertToIntVector(vocab);
+  return loader.convertToFst(vocab, token_ids, {});
+}
+
+// a file removed when going out of scope
+class TemporaryFile {
+ public:
+  explicit TemporaryFile(const std::string &extension) {
+    const char *dir = getenv("TMPDIR");
+    path_ = std::string(dir ? dir : "/tmp") + "/fstalign_bench." + std::to_string(getpid()) + extension;
+  }
+  ~TemporaryFile() { std::remove(path_.c_str()); }
+  const std::string &path() const { return path_; }
+
+ private:
+  std::string path_;
+};
+
+}  // namespace
+
+static void BM_GetEditDistance(benchmark::State &state) {
+  std::unordered_map<std::string, int> ids;
+  auto corpus = GenerateCorpus(BenchCorpus(state.range(0), 15));
+  auto a = TokenIds(corpus.ref, ids);
+  auto b = TokenIds(corpus.hyp, ids);
+  for (auto _ : state) {
+    std::vector<int> mapA;
+    std::vector<int> mapB;
+    benchmark::DoNotOptimize(GetEditDistance(a, mapA, b, mapB));
+  }
+  state.SetItemsProcessed(state.iterations() * a.size());
+}
+BENCHMARK(BM_GetEditDistance)->Arg(250)->Arg(1000)->Arg(4000)->Arg(16000)->Unit(benchmark::kMicrosecond);
+
+static void BM_GetEditDistanceOnly(benchmark::State &state) {
+  std::unordered_map<std::string, int> ids;
+  auto corpus = GenerateCorpus(BenchCorpus(state.range(0), 15));
+  auto a = TokenIds(corpus.ref, ids);
+  auto b = TokenIds(corpus.hyp, ids);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(GetEditDistanceOnly(a, b));
+  }
+  state.SetItemsProcessed(state.iterations() * a.size());
+}
+BENCHMARK(BM_GetEditDistanceOnly)->Arg(250)->Arg(1000)->Arg(4000)->Arg(16000)->Unit(benchmark::kMicrosecond);
+
+// fills a heap with range(0) paths then prunes it down to the walker's default target
+static void BM_PathHeapInsertPrune(benchmark::State &state) {
+  CorpusRandom random(1);
+  std::vector<std::shared_ptr<ShortlistEntry>> entries;
+  for (int i = 0; i < state.range(0); i++) {
+    auto entry = std::make_shared<ShortlistEntry>();
+    entry->currentState = i;
+    entry->numWords = 100 + random.Below(20);
+    entry->numErrors = random.Below(30);
+    entry->numInsert = random.Below(entry->numErrors + 1);
+    entry->costSoFar = entry->numErrors + 0.5f * random.Below(10);
+    entries.push_back(entry);
+  }
+
+  for (auto _ : state) {
+    PathHeap heap;
+    for (auto &entry : entries) {
+      heap.insert(entry);
+    }
+    benchmark::DoNotOptimize(heap.prune(20));
+  }
+  state.SetItemsProcessed(state.iterations() * entries.size());
+}
+BENCHMARK(BM_PathHeapInsertPrune)->RangeMultiplier(4)->Range(64, 16384);
+
+// expands the first composed states of a fresh composition, in the order they were created
+static void BM_TryGetArcsAtState(benchmark::State &state) {
+  const StateId kMaxExpandedStates = 20000;
+  SymbolTable symbols("symbols");
+  SymbolInterner vocab(symbols);
+  auto corpus = GenerateCorpus(BenchCorpus(state.range(0), 15));
+  auto refFst = LinearFst(corpus.ref, vocab);
+  auto hypFst = LinearFst(corpus.hyp, vocab);
+  // prepared like Fstalign() does for the adapted composition
+  RmEpsilon(&refFst, true);
+  ArcSort(&refFst, ReverseOLabelCompare<StdArc>());
+
+  int64_t expanded = 0;
+  for (auto _ : state) {
+    AdaptedCompositionFst composed(refFst, hypFst, symbols);
+    composed.Start();
+    vector<StdArc> arcs;
+    for (StateId s = 0; s < kMaxExpandedStates; s++) {
+      arcs.clear();
+      if (!composed.TryGetArcsAtState(s, &arcs)) {
+        break;
+      }
+      expanded++;
+    }
+  }
+  state.SetItemsProcessed(expanded);
+}
+BENCHMARK(BM_TryGetArcsAtState)->Arg(100)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
+
+// applies range(0) rules to a 5000 words reference
+static void BM_SynonymApplyToFst(benchmark::State &state) {
+  SymbolTable symbols("symbols");
+  SymbolInterner vocab(symbols);
+  auto corpus = GenerateCorpus(BenchCorpus(5000, 15));
+  auto refFst = LinearFst(corpus.ref, vocab);
+  SynonymEngine engine(SynonymOptions{});
+  engine.ParseStrings(GenerateSynonymRules(corpus, state.range(0), 2));
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto fst = refFst;
+    SymbolTable job_symbols = symbols;
+    state.ResumeTiming();
+    benchmark::DoNotOptimize(engine.ApplyToFst(fst, job_symbols));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SynonymApplyToFst)->RangeMultiplier(10)->Range(100, 100000)->Unit(benchmark::kMillisecond);
+
+static void BM_NlpReader(benchmark::State &state) {
+  TemporaryFile file(".nlp");
+  {
+    std::ofstream out(file.path());
+    WriteNlp(GenerateCorpus(BenchCorpus(state.range(0), 0)), out);
+  }
+
+  NlpReader reader;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(reader.read_from_disk(file.path()));
+  }
+  std::ifstream in(file.path(), std::ios::ate);
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(in.tellg()));
+}
+BENCHMARK(BM_NlpReader)->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMillisecond);
+
+static void BM_CtmReader(benchmark::State &state) {
+  TemporaryFile file(".ctm");
+  {
+    std::ofstream out(file.path());
+    WriteCtm(GenerateCorpus(BenchCorpus(state.range(0), 0)), out);
+  }
+
+  CtmReader reader;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(reader.read_from_disk(file.path()));
+  }
+  std::ifstream in(file.path(), std::ios::ate);
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(in.tellg()));
+}
+BENCHMARK(BM_CtmReader)->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMillisecond);
+
+// `fstalign wer` with the default options on range(0) words at a WER of range(1)%.  With
+// synonyms matching the reference, the alignment goes through the fst composition.
+static void RunFstalign(benchmark::State &state, bool with_synonyms) {
+  auto corpus = GenerateCorpus(BenchCorpus(state.range(0), state.range(1)));
+  SynonymEngine engine(SynonymOptions{});
+  if (with_synonyms) {
+    engine.ParseStrings(GenerateSynonymRules(corpus, 100, 2));
+  }
+  AlignerOptions options;
+  options.speaker_switch_context_size = 5;
+  options.record_case_stats = false;
+  options.levenstein_first_pass = true;
+
+  for (auto _ : state) {
+    OneBestFstLoader ref;
+    ref.LoadTokens(corpus.ref);
+    OneBestFstLoader hyp;
+    hyp.LoadTokens(corpus.hyp);
+    SynonymEngine job_engine(engine);
+    WerReport report;
+    HandleWer(ref, hyp, job_engine, "", "", options, report);
+    benchmark::DoNotOptimize(report.best_wer);
+  }
+  state.SetItemsProcessed(state.iterations() * corpus.ref.size());
+}
+
+// longer inputs take too long through the composition for a routine run
+static void BM_Fstalign(benchmark::State &state) { RunFstalign(state, true); }
+BENCHMARK(BM_Fstalign)
+    ->ArgsProduct({{1000, 4000}, {5, 20, 50}})
+    ->ArgNames({"words", "wer"})
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_FstalignLevenshteinFastPath(benchmark::State &state) { RunFstalign(state, false); }
+BENCHMARK(BM_FstalignLevenshteinFastPath)
+    ->ArgsProduct({{1000, 4000, 16000}, {5, 20, 50}})
+    ->ArgNames({"words", "wer"})
+    ->Unit(benchmark::kMillisecond);
+
+// `fstalign wer` on an NLP reference with entities normalized by its sidecar, a CTM
+// hypothesis and 1000 synonym rules, like production workloads, files loading included
+static void BM_FstalignNlp(benchmark::State &state) {
+  auto options = BenchCorpus(state.range(0), state.range(1));
+  options.entity_rate = 0.03;
+  auto corpus = GenerateCorpus(options);
+  TemporaryFile nlp(".nlp");
+  TemporaryFile norm(".norm.json");
+  TemporaryFile ctm(".ctm");
+  {
+    std::ofstream nlp_out(nlp.path());
+    WriteNlp(corpus, nlp_out);
+    std::ofstream norm_out(norm.path());
+    WriteNorm(corpus, norm_out);
+    std::ofstream ctm_out(ctm.path());
+    WriteCtm(corpus, ctm_out);
+  }
+  SynonymEngine engine(SynonymOptions{});
+  engine.ParseStrings(GenerateSynonymRules(corpus, 1000, 2));
+  AlignerOptions aligner_options;
+  aligner_options.speaker_switch_context_size = 5;
+  aligner_options.record_case_stats = false;
+  aligner_options.levenstein_first_pass = true;
+
+  for (auto _ : state) {
+    // read like `fstalign wer --ref x.nlp --ref-json x.norm.json --hyp x.ctm` does
+    Json::Value norm_json;
+    std::ifstream norm_in(norm.path());
+    Json::CharReaderBuilder builder;
+    JSONCPP_STRING errors;
+    Json::parseFromStream(builder, norm_in, &norm_json, &errors);
+    NlpFstLoader ref(NlpReader().read_from_disk(nlp.path()), std::move(norm_json), Json::Value(Json::objectValue),
+                     true);
+    CtmFstLoader hyp(CtmReader().read_from_disk(ctm.path()));
+    SynonymEngine job_engine(engine);
+    WerReport report;
+    HandleWer(ref, hyp, job_engine, "", "", aligner_options, report);
+    benchmark::DoNotOptimize(report.best_wer);
+  }
+  state.SetItemsProcessed(state.iterations() * corpus.spoken_ref_words);
+}
+BENCHMARK(BM_FstalignNlp)
+    ->ArgsProduct({{1000, 4000}, {5, 20, 50}})
+    ->ArgNames({"words", "wer"})
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,84 @@
+/*
+ * fstalign_corpus_gen.cc
+ *
+ * Writes a synthetic NLP reference with its normalization sidecar, the matching
+ * CTM and text hypotheses and synonym rules, e.g.
+ *   fstalign_corpus_gen --words 100000 --wer 0.15 --entity-rate 0.03 --synonym-rules 5000 --output-prefix big
+ * then
+ *   fstalign wer --ref big.ref.nlp --ref-json big.norm.json --hyp big.hyp.ctm --syn big.synonyms.txt
+ */
+
+#include <CLI/CLI.hpp>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+
+#include "SyntheticCorpus.h"
+
+namespace {
+
+void WriteFile(const std::string &filename, const std::function<void(std::ostream &)> &write) {
+  std::ofstream out(filename);
+  if (!out) {
+    throw std::runtime_error("couldn't open " + filename + " for writing");
+  }
+  write(out);
+  std::cout << "wrote " << filename << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  CorpusOptions options;
+  double wer = -1;
+  size_t num_synonym_rules = 1000;
+  std::string output_prefix = "synthetic";
+
+  CLI::App app("Deterministic synthetic corpora for the fstalign scaling tests");
+  app.add_option("--seed", options.seed, "Seed of the generator, the same seed and options give the same files");
+  app.add_option("--words", options.ref_words, "Words spoken in the reference, an entity counting as one");
+  app.add_option("--vocabulary", options.vocabulary_size, "Number of distinct plain words");
+  app.add_option("--ins", options.insertion_rate, "Fraction of the spoken reference words followed by an insertion");
+  app.add_option("--del", options.deletion_rate, "Fraction of the spoken reference words deleted");
+  app.add_option("--sub", options.substitution_rate, "Fraction of the spoken reference words substituted");
+  app.add_option("--wer", wer, "Target WER, split evenly between insertions, deletions and substitutions");
+  app.add_option("--speakers", options.num_speakers, "Number of speakers taking turns");
+  app.add_option("--entity-rate", options.entity_rate,
+                 "Fraction of the reference words replaced by a labeled entity (number, year or money)");
+  app.add_option("--synonym-rules", num_synonym_rules, "Number of synonym rules to write");
+  app.add_option("--output-prefix", output_prefix,
+                 "Prefix of the .ref.nlp, .norm.json, .ref.txt, .hyp.ctm, .hyp.txt and .synonyms.txt outputs");
+
+  try {
+    app.parse(argc, argv);
+  } catch (const CLI::ParseError &e) {
+    return app.exit(e);
+  }
+
+  if (wer >= 0) {
+    options.insertion_rate = options.deletion_rate = options.substitution_rate = wer / 3;
+  }
+
+  try {
+    auto corpus = GenerateCorpus(options);
+    WriteFile(output_prefix + ".ref.nlp", [&](std::ostream &out) { WriteNlp(corpus, out); });
+    WriteFile(output_prefix + ".norm.json", [&](std::ostream &out) { WriteNorm(corpus, out); });
+    WriteFile(output_prefix + ".ref.txt", [&](std::ostream &out) { WriteText(corpus.ref, out); });
+    WriteFile(output_prefix + ".hyp.ctm", [&](std::ostream &out) { WriteCtm(corpus, out); });
+    WriteFile(output_prefix + ".hyp.txt", [&](std::ostream &out) { WriteText(corpus.hyp, out); });
+    auto rules = GenerateSynonymRules(corpus, num_synonym_rules, options.seed);
+    WriteFile(output_prefix + ".synonyms.txt", [&](std::ostream &out) { WriteSynonymRules(rules, out); });
+
+    size_t num_edits = corpus.insertions + corpus.deletions + corpus.substitutions;
+    std::cout << corpus.ref.size() << " reference rows, " << corpus.entities.size() << " entities, "
+              << corpus.hyp.size() << " hypothesis words" << std::endl;
+    std::cout << corpus.insertions << " INS, " << corpus.deletions << " DEL, " << corpus.substitutions << " SUB over "
+              << corpus.spoken_ref_words << " spoken reference words, expected WER "
+              << (corpus.spoken_ref_words > 0 ? (double)num_edits / corpus.spoken_ref_words : 0) << std::endl;
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,241 @@
+/*
+ * fstalign_trace_summary.cc
+ *
+ * Summarizes a trace of the alignment graph search written by
+ *   fstalign wer --ref ref.nlp --hyp hyp.ctm --walker-trace trace.csv.gz
+ * with the number of states expanded, how far they stray from the diagonal of
+ * the reference and hypothesis, a heatmap of the expansions and the stretches of
+ * the reference where the search spent its time, e.g.
+ *   fstalign_trace_summary trace.csv.gz --bins 60 --grid-csv grid.csv
+ */
+
+#include <CLI/CLI.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+#include "src/utilities.h"
+
+namespace {
+
+struct TraceRow {
+  bool prune;
+  int64_t refA;
+  int64_t refB;
+};
+
+struct Trace {
+  std::vector<TraceRow> rows;
+  int64_t expansions = 0;
+  int64_t prunings = 0;
+  int64_t prunedPaths = 0;
+  int64_t enqueued = 0;
+  int64_t maxHeapSize = 0;
+  // the expansions of states the composition couldn't map back, e.g. with --composition-approach standard
+  int64_t unpaired = 0;
+  int64_t maxRefA = 0;
+  int64_t maxRefB = 0;
+};
+
+// the columns of Walker::TraceRow()
+enum Column { kEvent, kLoop, kState, kRefA, kRefB, kNumWords, kNumErrors, kCost, kHeapA, kHeapB, kEnqueued, kPruned };
+const size_t kNumColumns = kPruned + 1;
+
+Trace ReadTrace(const std::string &filename) {
+  auto input = OpenInput(filename);
+  Trace trace;
+  std::string line;
+  if (!std::getline(*input, line) || line.compare(0, 6, "event,") != 0) {
+    throw std::runtime_error(filename + " isn't a walker trace, its header is missing");
+  }
+
+  std::vector<std::string> fields;
+  while (std::getline(*input, line)) {
+    fields.clear();
+    size_t start = 0;
+    for (size_t comma = line.find(','); comma != std::string::npos; comma = line.find(',', start)) {
+      fields.push_back(line.substr(start, comma - start));
+      start = comma + 1;
+    }
+    fields.push_back(line.substr(start));
+    if (fields.size() != kNumColumns) {
+      throw std::runtime_error("unexpected walker trace row: " + line);
+    }
+
+    TraceRow row;
+    row.prune = fields[kEvent] == "prune";
+    row.refA = std::atoll(fields[kRefA].c_str());
+    row.refB = std::atoll(fields[kRefB].c_str());
+    trace.rows.push_back(row);
+
+    if (row.prune) {
+      trace.prunings++;
+      trace.prunedPaths += std::atoll(fields[kPruned].c_str());
+    } else {
+      trace.expansions++;
+      trace.enqueued += std::atoll(fields[kEnqueued].c_str());
+      int64_t heap_size = std::atoll(fields[kHeapA].c_str()) + std::atoll(fields[kHeapB].c_str());
+      trace.maxHeapSize = std::max(trace.maxHeapSize, heap_size);
+      if (row.refA < 0 || row.refB < 0) {
+        trace.unpaired++;
+      }
+    }
+    trace.maxRefA = std::max(trace.maxRefA, row.refA);
+    trace.maxRefB = std::max(trace.maxRefB, row.refB);
+  }
+  return trace;
+}
+
+// how far a hypothesis state is from where the diagonal crosses the reference state
+double DiagonalOffset(const Trace &trace, const TraceRow &row) {
+  double expected = trace.maxRefA > 0 ? (double)row.refA * trace.maxRefB / trace.maxRefA : 0;
+  return std::fabs(row.refB - expected);
+}
+
+// ' ' for no expansion to '@' for the most, on a log scale so the sparse cells still show
+char Shade(int64_t count, int64_t max_count) {
+  const char kShades[] = " .:-=+*#%@";
+  const int kNumShades = sizeof(kShades) - 1;
+  if (count == 0 || max_count == 0) {
+    return kShades[0];
+  }
+  int shade = 1 + (int)((kNumShades - 2) * std::log1p(count) / std::log1p(max_count) + 0.5);
+  return kShades[std::min(shade, kNumShades - 1)];
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::string trace_filename;
+  int num_bins = 40;
+  int num_stretches = 10;
+  std::string grid_csv_filename;
+
+  CLI::App app("Summary of an fstalign --walker-trace");
+  app.add_option("trace", trace_filename, "The trace written with --walker-trace")->required();
+  app.add_option("--bins", num_bins, "Rows and columns of the heatmap, defaults to 40");
+  app.add_option("--top", num_stretches, "Number of the busiest reference stretches to list, defaults to 10");
+  app.add_option("--grid-csv", grid_csv_filename,
+                 "Also write the expansions of each heatmap cell to this CSV file, e.g. for plotting");
+
+  try {
+    app.parse(argc, argv);
+  } catch (const CLI::ParseError &e) {
+    return app.exit(e);
+  }
+
+  try {
+    Trace trace = ReadTrace(trace_filename);
+    std::cout << std::setprecision(3);
+    if (trace.expansions == 0) {
+      std::cout << "no state expanded" << std::endl;
+      return 0;
+    }
+
+    std::cout << trace.expansions << " states expanded, " << trace.prunings << " prunings dropping "
+              << trace.prunedPaths << " paths" << std::endl;
+    std::cout << (double)trace.enqueued / trace.expansions << " paths enqueued per expansion, heaps up to "
+              << trace.maxHeapSize << " paths" << std::endl;
+    if (trace.unpaired == trace.expansions) {
+      std::cout << "the reference and hypothesis states aren't known, the trace comes from the standard composition"
+                << std::endl;
+      return 0;
+    }
+    if (trace.unpaired > 0) {
+      std::cout << trace.unpaired << " expansions without their reference and hypothesis states are left out"
+                << std::endl;
+    }
+
+    // the rows of the heatmap are the stretches of the reference
+    num_bins = std::max(num_bins, 1);
+    int64_t ref_states_per_bin = trace.maxRefA / num_bins + 1;
+    int64_t hyp_states_per_bin = trace.maxRefB / num_bins + 1;
+    int ref_bins = trace.maxRefA / ref_states_per_bin + 1;
+    int hyp_bins = trace.maxRefB / hyp_states_per_bin + 1;
+    std::vector<std::vector<int64_t>> grid(ref_bins, std::vector<int64_t>(hyp_bins, 0));
+    std::vector<int64_t> stretch_expansions(ref_bins, 0);
+    std::vector<int64_t> stretch_prunings(ref_bins, 0);
+    std::vector<double> stretch_offsets(ref_bins, 0);
+    double total_offset = 0;
+    double max_offset = 0;
+    for (auto &row : trace.rows) {
+      if (row.refA < 0 || row.refB < 0) {
+        continue;
+      }
+      int ref_bin = row.refA / ref_states_per_bin;
+      if (row.prune) {
+        stretch_prunings[ref_bin]++;
+        continue;
+      }
+      grid[ref_bin][row.refB / hyp_states_per_bin]++;
+      stretch_expansions[ref_bin]++;
+      double offset = DiagonalOffset(trace, row);
+      stretch_offsets[ref_bin] += offset;
+      total_offset += offset;
+      max_offset = std::max(max_offset, offset);
+    }
+
+    int64_t paired = trace.expansions - trace.unpaired;
+    std::cout << "reference states 0-" << trace.maxRefA << ", hypothesis states 0-" << trace.maxRefB << ", "
+              << (double)paired / (trace.maxRefA + 1) << " expansions per reference state" << std::endl;
+    std::cout << "expanded states are " << total_offset / paired << " hypothesis states off the diagonal on average, "
+              << max_offset << " at most" << std::endl;
+
+    int64_t max_count = 0;
+    for (auto &cells : grid) {
+      max_count = std::max(max_count, *std::max_element(cells.begin(), cells.end()));
+    }
+    std::cout << std::endl
+              << "expansions, reference states down and hypothesis states across, " << ref_states_per_bin << " x "
+              << hyp_states_per_bin << " states per cell, from ' ' for none to '@' for " << max_count << std::endl;
+    for (int r = 0; r < ref_bins; r++) {
+      char label[32];
+      snprintf(label, sizeof(label), "%10lld |", (long long)(r * ref_states_per_bin));
+      std::string line = label;
+      for (int h = 0; h < hyp_bins; h++) {
+        line += Shade(grid[r][h], max_count);
+      }
+      std::cout << line << '|' << std::endl;
+    }
+
+    // the stretches of the reference where the search spent its time
+    std::vector<int> stretches;
+    for (int r = 0; r < ref_bins; r++) {
+      stretches.push_back(r);
+    }
+    std::stable_sort(stretches.begin(), stretches.end(),
+                     [&](int a, int b) { return stretch_expansions[a] > stretch_expansions[b]; });
+    std::cout << std::endl << "busiest reference stretches" << std::endl;
+    for (int i = 0; i < std::min(num_stretches, ref_bins) && stretch_expansions[stretches[i]] > 0; i++) {
+      int r = stretches[i];
+      int64_t expansions = stretch_expansions[r];
+      std::cout << "  reference states " << r * ref_states_per_bin << "-" << (r + 1) * ref_states_per_bin - 1 << ": "
+                << expansions << " expansions (" << 100.0 * expansions / paired << "%), "
+                << stretch_offsets[r] / expansions << " off the diagonal on average, " << stretch_prunings[r]
+                << " prunings" << std::endl;
+    }
+
+    if (!grid_csv_filename.empty()) {
+      std::ofstream grid_csv(grid_csv_filename);
+      if (!grid_csv) {
+        throw std::runtime_error("couldn't open " + grid_csv_filename + " for writing");
+      }
+      grid_csv << "refStart,hypStart,expansions\n";
+      for (int r = 0; r < ref_bins; r++) {
+        for (int h = 0; h < hyp_bins; h++) {
+          grid_csv << r * ref_states_per_bin << ',' << h * hyp_states_per_bin << ',' << grid[r][h] << '\n';
+        }
+      }
+      std::cout << std::endl << "wrote " << grid_csv_filename << std::endl;
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -10,12 +10,12 @@ AdaptedComposition.cpp
 #include "AdaptedComposition.h"
 #include <chrono>
 #include <ctime>
+#include "MemoryUsage.h"
 #include "logging.h"
 
 AdaptedCompositionFst::AdaptedCompositionFst(const fst::StdFst &fstA, const fst::StdFst &fstB)
     : fstA_{fstA}, fstB_{fstB}, symbols_{NULL} {
   logger_ = logger::GetOrCreateLogger("AdaptedCompositionFst");
-  logger_->set_level(spdlog::level::info);
 #if TRACE
   logger_->set_level(spdlog::level::trace);
 #endif
@@ -24,7 +24,6 @@ AdaptedCompositionFst::AdaptedCompositionFst(const fst::StdFst &fstA, const fst:
 AdaptedCompositionFst::AdaptedCompositionFst(const fst::StdFst &fstA, const fst::StdFst &fstB, SymbolTable &symbols)
     : fstA_{fstA}, fstB_{fstB} {
   logger_ = logger::GetOrCreateLogger("AdaptedCompositionFst");
-  logger_->set_level(spdlog::level::info);
 #if TRACE
   logger_->set_level(spdlog::level::trace);
 #endif
@@ -174,6 +173,7 @@ and we exit it on state 20 with an arc leaving state 20 to come back to state 1
 
 */
 bool AdaptedCompositionFst::IsEntityReacheable(int target_entity_label_id, StateId refA, StateId refB) {
+  reachability_checks++;
   for (ArcIterator<StdFst> aiter(fstA_, refA); !aiter.Done(); aiter.Next()) {
     const fst::StdArc &arcA = aiter.Value();
     // logger_->info("{}:{} asking if {}/{} is reacheable from state {}", __FILE__ , __LINE__, target_entity_label_id,
@@ -210,6 +210,29 @@ bool AdaptedCompositionFst::IsEntityReacheable(int target_entity_label_id, State
   return false;
 }
 
+void AdaptedCompositionFst::RecordPerf(PerfStats &perf) const {
+  perf.Count("composedStates", composed_states.size());
+  perf.Count("composedStatesExpanded", dbg_count);
+  perf.Count("composedArcsEmitted", arcs_emitted);
+  perf.Count("reachabilityChecks", reachability_checks);
+}
+
+int64_t AdaptedCompositionFst::ApproxMemoryBytes() const {
+  return composed_states.size() * ApproxTreeNodeBytes(sizeof(pair<const StatePair, StateId>)) +
+         reversed_composed_states.size() * ApproxTreeNodeBytes(sizeof(pair<const StateId, StatePair>)) +
+         entity_exit_states.size() * ApproxTreeNodeBytes(sizeof(pair<StateId, int>));
+}
+
+bool AdaptedCompositionFst::TryGetStatePair(StateId composedStateId, StateId *refA, StateId *refB) const {
+  auto found = reversed_composed_states.find(composedStateId);
+  if (found == reversed_composed_states.end()) {
+    return false;
+  }
+  *refA = found->second.first;
+  *refB = found->second.second;
+  return true;
+}
+
 bool AdaptedCompositionFst::TryGetArcsAtState(StateId fromStateId, vector<fst::StdArc> *out_vector) {
   assert(out_vector != NULL);
 
@@ -244,6 +267,7 @@ bool AdaptedCompositionFst::TryGetArcsAtState(StateId fromStateId, vector<fst::S
   int num_entity = 0;
 
   int arc_added = 0;
+  size_t num_arcs_before = out_vector->size();
 
   for (ArcIterator<StdFst> aiter(fstA_, refA); !aiter.Done(); aiter.Next()) {
     const fst::StdArc &arcA = aiter.Value();
@@ -399,6 +423,7 @@ bool AdaptedCompositionFst::TryGetArcsAtState(StateId fromStateId, vector<fst::S
     }
   }
 
+  arcs_emitted += out_vector->size() - num_arcs_before;
   return true;
 }
 
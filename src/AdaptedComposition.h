@@ -9,9 +9,11 @@ AdaptedComposition.h
 #define __ADAPTEDCOMPOSITION_H__
 
 #include <fst/fstlib.h>
+#include <tuple>
 #include <unordered_map>
 #include <utility>
 #include "IComposition.h"
+#include "PerfStats.h"
 #include "utilities.h"
 
 using namespace std;
@@ -33,6 +35,24 @@ struct hash_pair {
   }
 };
 
+// Compare class for comparing output labels of arcs.  The reference fst is sorted
+// with it, after its epsilons are removed, before being composed.
+template <class Arc>
+class ReverseOLabelCompare {
+ public:
+  constexpr ReverseOLabelCompare() {}
+
+  constexpr bool operator()(const Arc &lhs, const Arc &rhs) const {
+    return std::forward_as_tuple(lhs.olabel, lhs.ilabel) > std::forward_as_tuple(rhs.olabel, rhs.ilabel);
+  }
+
+  constexpr uint64 Properties(uint64 props) const {
+    return (props & fst::kArcSortProperties) | fst::kOLabelSorted | (props & fst::kAcceptor ? fst::kILabelSorted : 0);
+  }
+};
+
+using StdReverseOlabelCompare = ReverseOLabelCompare<fst::StdArc>;
+
 /*
  * Calculates edit distance between two FSTs through manual single-step composition.
  * Optimizes the search space of the composed graph by greedily expanding composition states.
@@ -53,6 +73,9 @@ class AdaptedCompositionFst : public IComposition {
   std::vector<bool> entity_label_ids;
 
   int dbg_count = 0;
+  // the work done for the walker, reported by RecordPerf()
+  int64_t arcs_emitted = 0;
+  int64_t reachability_checks = 0;
 
   // possible optimizations : limit to const FST or limit to StdVectorFst
   const fst::StdFst &fstA_;
@@ -81,6 +104,14 @@ class AdaptedCompositionFst : public IComposition {
   void SetSymbols(fst::SymbolTable *symbols);
 
   void DebugComposedGraph();
+
+  // adds the composed states created, the states expanded, their arcs and the entity
+  // reachability checks to the stats counters
+  void RecordPerf(PerfStats &perf) const;
+
+  // the maps of the composed states and the entity exits
+  int64_t ApproxMemoryBytes() const;
+  bool TryGetStatePair(StateId composedStateId, StateId *refA, StateId *refB) const;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,93 @@
+/*
+ * Aligner.cpp
+ */
+
+#include "Aligner.h"
+
+#include <sstream>
+
+#include "JsonWriter.h"
+#include "OneBestFstLoader.h"
+
+// same defaults as the wer subcommand
+AlignerConfig::AlignerConfig() {
+  options.speaker_switch_context_size = 5;
+  options.numBests = kDefaultNumBests;
+  options.record_case_stats = false;
+}
+
+string AlignmentResult::ToJson(bool pretty) const {
+  std::ostringstream json;
+  JsonWriter writer(json, pretty);
+  report.Write(writer);
+  return json.str();
+}
+
+Aligner::Aligner(const AlignerConfig &config) : config_(config), engine_(config.synonym_options) {
+  if (!config_.synonyms_filename.empty()) {
+    engine_.LoadFile(config_.synonyms_filename);
+  }
+  // each alignment copies the engine, the loaded rules aren't
+  engine_.ShareRules();
+}
+
+std::unique_ptr<FstLoader> Aligner::MakeReference(const vector<RawNlpRecord> &ref,
+                                                  const Json::Value &normalizations) const {
+  return std::make_unique<NlpFstLoader>(ref, normalizations, Json::Value(Json::objectValue), true,
+                                        config_.use_punctuation, config_.use_case);
+}
+
+std::unique_ptr<FstLoader> Aligner::MakeTokens(const vector<string> &tokens) const {
+  auto loader = std::make_unique<OneBestFstLoader>(config_.use_case);
+  loader->LoadTokens(tokens);
+  return std::move(loader);
+}
+
+AlignmentResult Aligner::Align(const vector<string> &ref, const vector<string> &hyp) const {
+  auto refLoader = MakeTokens(ref);
+  auto hypLoader = MakeTokens(hyp);
+  return Run(*refLoader, *hypLoader);
+}
+
+AlignmentResult Aligner::Align(const vector<RawNlpRecord> &ref, const Json::Value &normalizations,
+                               const vector<RawCtmRecord> &hyp) const {
+  auto refLoader = MakeReference(ref, normalizations);
+  CtmFstLoader hypLoader(hyp, config_.use_case);
+  return Run(*refLoader, hypLoader);
+}
+
+AlignmentResult Aligner::Align(const vector<RawNlpRecord> &ref, const Json::Value &normalizations,
+                               const vector<string> &hyp) const {
+  auto refLoader = MakeReference(ref, normalizations);
+  auto hypLoader = MakeTokens(hyp);
+  return Run(*refLoader, *hypLoader);
+}
+
+AlignmentResult Aligner::Run(FstLoader &refLoader, FstLoader &hypLoader) const {
+  // synonyms generated from this pair's vocabulary stay with this call
+  SynonymEngine engine(engine_);
+
+  AlignmentResult result;
+  vector<Stitching> stitches;
+  HandleWer(refLoader, hypLoader, engine, "", "", config_.options, result.report, false, config_.use_case, &stitches);
+
+  result.tokens.reserve(stitches.size());
+  for (auto &stitch : stitches) {
+    if (stitch.reftk == NOOP) {
+      continue;
+    }
+    result.tokens.emplace_back();
+    AlignedToken &token = result.tokens.back();
+    token.ref = std::move(stitch.reftk);
+    token.hyp = std::move(stitch.hyptk);
+    token.comment = std::move(stitch.comment);
+    if (stitch.classLabel != TK_GLOBAL_CLASS) {
+      token.class_label = std::move(stitch.classLabel);
+    }
+    token.speaker = std::move(stitch.nlpRow.speakerId);
+    token.start_ts = stitch.start_ts;
+    token.end_ts = stitch.end_ts;
+    token.confidence = stitch.confidence;
+  }
+  return result;
+}
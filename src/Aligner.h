@@ -0,0 +1,78 @@
+/*
+ * Aligner.h
+ *
+ * In-process interface of the fstaligner library: aligns references and hypotheses
+ * held in memory and returns the results as structures, without going through files.
+ * The C API of fstalign_c.h wraps it for other languages.
+ *
+ */
+
+#ifndef __ALIGNER_H__
+#define __ALIGNER_H__
+
+#include <string>
+#include <vector>
+
+#include "fstalign.h"
+
+struct AlignerConfig {
+  AlignerOptions options;
+  SynonymOptions synonym_options;
+  // rules loaded once, when the Aligner is created.  Empty for none
+  string synonyms_filename;
+  bool use_punctuation = false;
+  bool use_case = false;
+
+  AlignerConfig();
+};
+
+// one pair of the best alignment, in reference order
+struct AlignedToken {
+  string ref;  // <ins> for an insertion
+  string hyp;  // <del> for a deletion
+  // empty when correct, "ins", "del" or "sub(<hyp>)" otherwise
+  string comment;
+  // label of the normalized class the token belongs to, empty outside of classes
+  string class_label;
+  // from the NLP reference, empty otherwise
+  string speaker;
+  // from CTM/NLP hypotheses, 0 otherwise
+  float start_ts = 0;
+  float end_ts = 0;
+  float confidence = 0;
+};
+
+struct AlignmentResult {
+  // everything --json-log would hold: best, speaker, class... WER and n-gram stats
+  WerReport report;
+  vector<AlignedToken> tokens;
+
+  const WerResult &wer() const { return report.best_wer; }
+  // the --json-log of the alignment, compact by default
+  string ToJson(bool pretty = false) const;
+};
+
+// Safe to share between threads: Align() only reads the aligner.
+class Aligner {
+ public:
+  explicit Aligner(const AlignerConfig &config);
+
+  // plain token sequences, e.g. the words of two transcripts
+  AlignmentResult Align(const vector<string> &ref, const vector<string> &hyp) const;
+  // NLP reference rows, with their normalizations (see --ref-json), against CTM rows
+  AlignmentResult Align(const vector<RawNlpRecord> &ref, const Json::Value &normalizations,
+                        const vector<RawCtmRecord> &hyp) const;
+  // NLP reference rows, with their normalizations, against plain tokens
+  AlignmentResult Align(const vector<RawNlpRecord> &ref, const Json::Value &normalizations,
+                        const vector<string> &hyp) const;
+
+ private:
+  std::unique_ptr<FstLoader> MakeReference(const vector<RawNlpRecord> &ref, const Json::Value &normalizations) const;
+  std::unique_ptr<FstLoader> MakeTokens(const vector<string> &tokens) const;
+  AlignmentResult Run(FstLoader &refLoader, FstLoader &hypLoader) const;
+
+  AlignerConfig config_;
+  SynonymEngine engine_;
+};
+
+#endif  // __ALIGNER_H__
@@ -0,0 +1,359 @@
+/*
+ * AlignmentServer.cpp
+ *
+ * Requests and responses are compact JSON objects on a single line:
+ *   {"id":1, "ref":"a.nlp", "hyp":"a.ctm", "ref_json":..., "wer_sidecar":..., "syn":...,
+ *    "output_sbs":..., "output_nlp":...}
+ *   {"id":1, "log":{...the --json-log of wer...}}  or  {"id":1, "error":"..."}
+ * "command" selects "wer" (the default), "ping", "stats" or "shutdown".
+ *
+ */
+
+#include "AlignmentServer.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "CompiledReference.h"
+#include "FstFileLoader.h"
+#include "JsonWriter.h"
+#include "ThreadPool.h"
+
+// how often blocked accept/read calls look for a shutdown, in milliseconds
+static const int kPollInterval = 200;
+
+// modification time and size of the inputs, a cached entry is stale once it changes
+static string InputStamp(const vector<string> &filenames) {
+  string stamp;
+  for (auto &filename : filenames) {
+    struct stat sb;
+    if (!filename.empty() && stat(filename.c_str(), &sb) == 0) {
+      stamp += to_string(sb.st_mtim.tv_sec) + "." + to_string(sb.st_mtim.tv_nsec) + ":" + to_string(sb.st_size);
+    }
+    stamp += ";";
+  }
+  return stamp;
+}
+
+static string GetString(const Json::Value &request, const char *name) {
+  const Json::Value &value = request[name];
+  if (value.isNull()) {
+    return "";
+  }
+  if (!value.isString()) {
+    throw std::runtime_error(string("the request field ") + name + " must be a string");
+  }
+  return value.asString();
+}
+
+AlignmentServer::AlignmentServer(const AlignerOptions &alignerOptions, const string &synonyms_filename,
+                                 SynonymsLoader load_synonyms, ReferenceLoader load_reference,
+                                 HypothesisLoader load_hypothesis, size_t max_references, bool add_inserts_nlp,
+                                 bool use_case)
+    : alignerOptions_(alignerOptions),
+      synonyms_filename_(synonyms_filename),
+      load_synonyms_(load_synonyms),
+      load_reference_(load_reference),
+      load_hypothesis_(load_hypothesis),
+      max_references_(max_references),
+      add_inserts_nlp_(add_inserts_nlp),
+      use_case_(use_case),
+      shutdown_(false),
+      num_requests_(0),
+      num_reference_hits_(0),
+      num_reference_misses_(0) {
+  // warm up the default rules before the first request
+  GetSynonyms(synonyms_filename_);
+}
+
+std::shared_ptr<const SynonymEngine> AlignmentServer::GetSynonyms(const string &filename) {
+  // loading the rules is quick enough to be done under the lock
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  string stamp = InputStamp({filename});
+  auto &cached = synonyms_[filename];
+  if (!cached.engine || cached.stamp != stamp) {
+    auto logger = logger::GetOrCreateLogger("serve");
+    logger->info("loading synonyms from [{}]", filename);
+    cached.engine = load_synonyms_(filename);
+    cached.stamp = stamp;
+  }
+  return cached.engine;
+}
+
+std::shared_ptr<FstLoader> AlignmentServer::GetReference(const BatchJob &job, const string &synonyms_filename,
+                                                         const SynonymEngine &engine) {
+  string key = job.ref_filename + "\t" + job.json_norm_filename + "\t" + job.wer_sidecar_filename + "\t" +
+               synonyms_filename;
+  string stamp = InputStamp({job.ref_filename, job.json_norm_filename, job.wer_sidecar_filename, synonyms_filename});
+  {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    for (auto it = references_.begin(); it != references_.end(); ++it) {
+      if (it->key == key && it->stamp == stamp) {
+        references_.splice(references_.begin(), references_, it);
+        num_reference_hits_++;
+        return references_.front().loader;
+      }
+    }
+  }
+  num_reference_misses_++;
+
+  // compiled outside of the lock, a reference requested twice meanwhile is compiled twice
+  std::shared_ptr<FstLoader> loader = load_reference_(job);
+  if (dynamic_cast<FstFileLoader *>(loader.get())) {
+    // FST references aren't prepared, there's nothing to keep
+    return loader;
+  }
+  if (!loader->getCompiledReference()) {
+    CompiledReference::Compile(*loader, engine, alignerOptions_.symbols_filename);
+  }
+
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  references_.remove_if([&](const CachedReference &cached) { return cached.key == key; });
+  references_.push_front({key, stamp, loader});
+  while (references_.size() > max_references_) {
+    references_.pop_back();
+  }
+  return loader;
+}
+
+string AlignmentServer::HandleRequest(const string &line) {
+  num_requests_++;
+  std::ostringstream response;
+  JsonWriter writer(response, false);
+  writer.BeginObject();
+
+  Json::Value request;
+  try {
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    JSONCPP_STRING errs;
+    if (!reader->parse(line.data(), line.data() + line.size(), &request, &errs) || !request.isObject()) {
+      throw std::runtime_error("the request isn't a JSON object: " + errs);
+    }
+
+    // echoed as is, so clients can match the responses of pipelined requests
+    const Json::Value &id = request["id"];
+    if (id.isIntegral()) {
+      writer.Member("id", static_cast<int64_t>(id.asInt64()));
+    } else if (id.isString()) {
+      writer.Member("id", id.asString());
+    } else if (!id.isNull()) {
+      throw std::runtime_error("the request id must be a string or an integer");
+    }
+
+    string command = request.isMember("command") ? GetString(request, "command") : "wer";
+    if (command == "ping") {
+      writer.Member("status", "ok");
+    } else if (command == "stats") {
+      std::lock_guard<std::mutex> lock(cache_mutex_);
+      writer.Member("requests", static_cast<uint64_t>(num_requests_));
+      writer.Member("cachedReferences", static_cast<uint64_t>(references_.size()));
+      writer.Member("referenceHits", static_cast<uint64_t>(num_reference_hits_));
+      writer.Member("referenceMisses", static_cast<uint64_t>(num_reference_misses_));
+    } else if (command == "shutdown") {
+      shutdown_ = true;
+      writer.Member("status", "ok");
+    } else if (command == "wer") {
+      BatchJob job;
+      job.ref_filename = GetString(request, "ref");
+      job.hyp_filename = GetString(request, "hyp");
+      job.json_norm_filename = GetString(request, "ref_json");
+      job.wer_sidecar_filename = GetString(request, "wer_sidecar");
+      job.output_sbs = GetString(request, "output_sbs");
+      job.output_nlp = GetString(request, "output_nlp");
+      if (job.ref_filename.empty() || job.hyp_filename.empty()) {
+        throw std::runtime_error("a wer request needs a ref and a hyp");
+      }
+      string synonyms_filename = request.isMember("syn") ? GetString(request, "syn") : synonyms_filename_;
+
+      auto synonyms = GetSynonyms(synonyms_filename);
+      auto refLoader = GetReference(job, synonyms_filename, *synonyms);
+      auto hypLoader = load_hypothesis_(job.hyp_filename);
+
+      // the rules generated from the reference vocabulary were compiled with it
+      SynonymEngine engine(*synonyms);
+      if (refLoader->getCompiledReference()) {
+        engine = refLoader->getCompiledReference()->engine;
+      }
+
+      WerReport report;
+      HandleWer(*refLoader, *hypLoader, engine, job.output_sbs, job.output_nlp, alignerOptions_, report,
+                add_inserts_nlp_, use_case_);
+      writer.Key("log");
+      report.Write(writer);
+    } else {
+      throw std::runtime_error("unknown command [" + command + "]");
+    }
+  } catch (const std::exception &e) {
+    // the fields written so far are complete, only the id can precede the error
+    writer.Member("error", e.what());
+  }
+
+  writer.EndObject();
+  return response.str();
+}
+
+void AlignmentServer::Serve(std::istream &in, std::ostream &out) {
+  string line;
+  while (!shutdown_ && getline(in, line)) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    if (line.empty()) {
+      continue;
+    }
+    out << HandleRequest(line) << '\n';
+    out.flush();
+  }
+}
+
+void AlignmentServer::ServeConnection(int fd) {
+  string buffer;
+  char chunk[4096];
+  while (!shutdown_) {
+    struct pollfd pfd = {fd, POLLIN, 0};
+    int ready = poll(&pfd, 1, kPollInterval);
+    if (ready < 0 && errno != EINTR) {
+      break;
+    }
+    if (ready <= 0) {
+      continue;
+    }
+
+    ssize_t size = read(fd, chunk, sizeof(chunk));
+    if (size < 0 && errno == EINTR) {
+      continue;
+    }
+    if (size <= 0) {
+      break;
+    }
+    buffer.append(chunk, size);
+
+    size_t newline;
+    bool connected = true;
+    while (connected && (newline = buffer.find('\n')) != string::npos) {
+      string line = buffer.substr(0, newline);
+      buffer.erase(0, newline + 1);
+      if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+      }
+      if (line.empty()) {
+        continue;
+      }
+
+      string response = HandleRequest(line) + "\n";
+      for (size_t sent = 0; sent < response.size();) {
+        ssize_t written = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) {
+          continue;
+        }
+        if (written <= 0) {
+          connected = false;
+          break;
+        }
+        sent += written;
+      }
+    }
+    if (!connected) {
+      break;
+    }
+  }
+  close(fd);
+}
+
+void AlignmentServer::ServeSocket(const string &path, int max_connections) {
+  auto logger = logger::GetOrCreateLogger("serve");
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("the socket path " + path + " is too long");
+  }
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+  // the socket of a previous server is replaced, any other file is left alone
+  struct stat sb;
+  if (lstat(path.c_str(), &sb) == 0) {
+    if (!S_ISSOCK(sb.st_mode)) {
+      throw std::runtime_error("Cannot listen on " + path + ": the file exists and isn't a socket");
+    }
+    if (unlink(path.c_str()) != 0) {
+      throw std::runtime_error("Cannot remove the socket " + path + ": " + strerror(errno));
+    }
+  }
+
+  int server = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (server < 0) {
+    throw std::runtime_error(string("Cannot create a socket: ") + strerror(errno));
+  }
+  if (bind(server, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0) {
+    string error = strerror(errno);
+    close(server);
+    throw std::runtime_error("Cannot listen on " + path + ": " + error);
+  }
+  // the socket file is created with the umask, it's restricted before anyone can connect
+  if (chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0 || listen(server, 16) != 0) {
+    string error = strerror(errno);
+    close(server);
+    unlink(path.c_str());
+    throw std::runtime_error("Cannot listen on " + path + ": " + error);
+  }
+  // the same default as the workers of batch
+  size_t connection_limit = ThreadPool(max_connections).NumThreads();
+  logger->info("listening on {}, serving up to {} connections at once", path, connection_limit);
+
+  struct Connection {
+    std::thread thread;
+    std::shared_ptr<std::atomic<bool>> done;
+  };
+  std::list<Connection> connections;
+  while (!shutdown_) {
+    // join the threads of the closed connections
+    connections.remove_if([](Connection &connection) {
+      if (!*connection.done) {
+        return false;
+      }
+      connection.thread.join();
+      return true;
+    });
+    if (connections.size() >= connection_limit) {
+      // the next connections wait in the listen queue until one is closed
+      std::this_thread::sleep_for(std::chrono::milliseconds(kPollInterval));
+      continue;
+    }
+
+    struct pollfd pfd = {server, POLLIN, 0};
+    if (poll(&pfd, 1, kPollInterval) <= 0) {
+      continue;
+    }
+    int fd = accept(server, nullptr, nullptr);
+    if (fd < 0) {
+      continue;
+    }
+
+    auto done = std::make_shared<std::atomic<bool>>(false);
+    connections.push_back({std::thread([this, fd, done]() {
+                             ServeConnection(fd);
+                             *done = true;
+                           }),
+                           done});
+  }
+
+  close(server);
+  unlink(path.c_str());
+  for (auto &connection : connections) {
+    connection.thread.join();
+  }
+  logger->info("stopped listening on {}", path);
+}
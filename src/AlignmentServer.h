@@ -0,0 +1,86 @@
+/*
+ * AlignmentServer.h
+ *
+ * Backs `fstalign serve`: answers alignment requests, one JSON object per line,
+ * read from stdin or from the connections of a unix domain socket.  The synonym
+ * rules and the compiled references stay loaded between requests.
+ *
+ */
+
+#ifndef __ALIGNMENT_SERVER_H__
+#define __ALIGNMENT_SERVER_H__
+
+#include <atomic>
+#include <functional>
+#include <istream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+#include "fstalign.h"
+
+class AlignmentServer {
+ public:
+  // loads the rules of a synonyms file, an empty filename giving an engine without rules
+  typedef std::function<std::unique_ptr<SynonymEngine>(const string &)> SynonymsLoader;
+  typedef std::function<std::unique_ptr<FstLoader>(const BatchJob &)> ReferenceLoader;
+  typedef std::function<std::unique_ptr<FstLoader>(const string &)> HypothesisLoader;
+
+  // `synonyms_filename` is used by the requests not naming their own, and at most
+  // `max_references` compiled references are kept, the least recently used are dropped
+  AlignmentServer(const AlignerOptions &alignerOptions, const string &synonyms_filename,
+                  SynonymsLoader load_synonyms, ReferenceLoader load_reference, HypothesisLoader load_hypothesis,
+                  size_t max_references, bool add_inserts_nlp = false, bool use_case = false);
+
+  // Answers one request line, the response is a single line without its newline
+  string HandleRequest(const string &line);
+
+  // Answers the requests of `in` on `out` until the end of the input or a shutdown request
+  void Serve(std::istream &in, std::ostream &out);
+  // Accepts connections on a unix domain socket, each served on its own thread, until
+  // a shutdown request.  At most `max_connections` are served at once, <= 0 for one per
+  // core, the others wait in the listen queue.  A stale socket file left at `path` is
+  // replaced, and the socket is only accessible to the user running the server.
+  void ServeSocket(const string &path, int max_connections = 0);
+
+ private:
+  struct CachedSynonyms {
+    string stamp;
+    std::shared_ptr<const SynonymEngine> engine;
+  };
+  struct CachedReference {
+    string key;
+    string stamp;
+    std::shared_ptr<FstLoader> loader;
+  };
+
+  std::shared_ptr<const SynonymEngine> GetSynonyms(const string &filename);
+  // the compiled reference of a job, from the cache when its inputs didn't change since
+  std::shared_ptr<FstLoader> GetReference(const BatchJob &job, const string &synonyms_filename,
+                                          const SynonymEngine &engine);
+  void ServeConnection(int fd);
+
+  AlignerOptions alignerOptions_;
+  string synonyms_filename_;
+  SynonymsLoader load_synonyms_;
+  ReferenceLoader load_reference_;
+  HypothesisLoader load_hypothesis_;
+  size_t max_references_;
+  bool add_inserts_nlp_;
+  bool use_case_;
+
+  std::mutex cache_mutex_;
+  std::map<string, CachedSynonyms> synonyms_;
+  // most recently used first
+  std::list<CachedReference> references_;
+
+  std::atomic<bool> shutdown_;
+  std::atomic<size_t> num_requests_;
+  std::atomic<size_t> num_reference_hits_;
+  std::atomic<size_t> num_reference_misses_;
+};
+
+#endif  // __ALIGNMENT_SERVER_H__
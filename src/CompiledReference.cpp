@@ -0,0 +1,333 @@
+/*
+ * CompiledReference.cpp
+ *
+ * Bundle layout, all integers little-endian:
+ *   magic "FSTALREF", format version, fstalign version string,
+ *   loader metadata (kind first), synonym engine,
+ *   token ids, token states, first synonym label, symbol table blob, fst blob
+ *
+ */
+
+#include "CompiledReference.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <streambuf>
+
+#include "Ctm.h"
+#include "Nlp.h"
+#include "OneBestFstLoader.h"
+#include "version.h"
+
+using namespace std;
+using namespace fst;
+
+const uint32_t CompiledReference::kFormatVersion = 2;
+const char *const CompiledReference::kExtension = ".fstalign-ref";
+
+static const char kMagic[8] = {'F', 'S', 'T', 'A', 'L', 'R', 'E', 'F'};
+
+/***************************************
+    Bundle Writer/Reader Class Start
+ ***************************************/
+BundleWriter::BundleWriter(std::ostream &out) : out_(out) {}
+
+void BundleWriter::WriteUInt32(uint32_t value) {
+  char bytes[4];
+  for (int i = 0; i < 4; i++) {
+    bytes[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+  }
+  out_.write(bytes, 4);
+}
+
+void BundleWriter::WriteInt32(int32_t value) { WriteUInt32(static_cast<uint32_t>(value)); }
+
+void BundleWriter::WriteFloat(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  WriteUInt32(bits);
+}
+
+void BundleWriter::WriteBool(bool value) { out_.put(value ? 1 : 0); }
+
+void BundleWriter::WriteString(const std::string &value) {
+  WriteUInt32(value.size());
+  out_.write(value.data(), value.size());
+}
+
+void BundleWriter::WriteStrings(const std::vector<std::string> &values) {
+  WriteUInt32(values.size());
+  for (auto &value : values) {
+    WriteString(value);
+  }
+}
+
+void BundleWriter::WriteInts(const std::vector<int> &values) {
+  WriteUInt32(values.size());
+  for (int value : values) {
+    WriteInt32(value);
+  }
+}
+
+BundleReader::BundleReader(const char *begin, const char *end, const std::string &filename)
+    : cur_(begin), end_(end), filename_(filename) {}
+
+void BundleReader::Need(size_t bytes) {
+  if (static_cast<size_t>(end_ - cur_) < bytes) {
+    throw std::runtime_error("the compiled file " + filename_ + " is truncated");
+  }
+}
+
+uint32_t BundleReader::ReadUInt32() {
+  Need(4);
+  uint32_t value = 0;
+  for (int i = 0; i < 4; i++) {
+    value |= static_cast<uint32_t>(static_cast<unsigned char>(cur_[i])) << (8 * i);
+  }
+  cur_ += 4;
+  return value;
+}
+
+int32_t BundleReader::ReadInt32() { return static_cast<int32_t>(ReadUInt32()); }
+
+float BundleReader::ReadFloat() {
+  uint32_t bits = ReadUInt32();
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+bool BundleReader::ReadBool() {
+  Need(1);
+  return *cur_++ != 0;
+}
+
+std::string BundleReader::ReadString() {
+  uint32_t size = ReadUInt32();
+  Need(size);
+  std::string value(cur_, size);
+  cur_ += size;
+  return value;
+}
+
+std::vector<std::string> BundleReader::ReadStrings() {
+  uint32_t size = ReadUInt32();
+  std::vector<std::string> values;
+  values.reserve(size);
+  for (uint32_t i = 0; i < size; i++) {
+    values.push_back(ReadString());
+  }
+  return values;
+}
+
+std::vector<int> BundleReader::ReadInts() {
+  uint32_t size = ReadUInt32();
+  Need(static_cast<size_t>(size) * 4);
+  std::vector<int> values;
+  values.reserve(size);
+  for (uint32_t i = 0; i < size; i++) {
+    values.push_back(ReadInt32());
+  }
+  return values;
+}
+
+void BundleReader::ReadBlob(const char *&begin, const char *&end) {
+  uint32_t size = ReadUInt32();
+  Need(size);
+  begin = cur_;
+  end = cur_ + size;
+  cur_ += size;
+}
+
+/***************************************
+    Bundle Writer/Reader Class End
+ ***************************************/
+
+// read-only istream over a range of the mapped bundle, so OpenFST reads without copies
+class MemoryStreamBuf : public std::streambuf {
+ public:
+  MemoryStreamBuf(const char *begin, const char *end) {
+    char *p = const_cast<char *>(begin);
+    setg(p, p, const_cast<char *>(end));
+  }
+};
+
+/***************************************
+    Compiled Reference Class Start
+ ***************************************/
+CompiledReference::CompiledReference() : first_synonym_label(0), engine(SynonymOptions()) {}
+
+void CompiledReference::Compile(FstLoader &loader, const SynonymEngine &engine, const std::string &symbols_filename) {
+  auto logger = logger::GetOrCreateLogger("CompiledReference");
+  auto compiled = std::make_shared<CompiledReference>();
+
+  FstAlignOption options;
+  if (!symbols_filename.empty()) {
+    std::ifstream strm(symbols_filename, std::ios_base::in);
+    compiled->symbols.reset(SymbolTable::ReadText(strm, "symbols"));
+  } else {
+    compiled->symbols.reset(new SymbolTable("symbols"));
+  }
+  options.RegisterSymbols(*compiled->symbols);
+
+  // same steps and order as Fstalign(), minus the hypothesis
+  SymbolInterner vocab(*compiled->symbols);
+  compiled->token_ids = loader.convertToIntVector(vocab);
+  compiled->first_synonym_label = compiled->symbols->AvailableKey();
+  compiled->fst.reset(
+      new StdVectorFst(loader.convertToFst(vocab, compiled->token_ids, {}, &compiled->token_states)));
+
+  compiled->engine = engine;
+  SynonymEngine reference_engine(engine);
+  reference_engine.GenerateSynFromSymbolTable(*compiled->symbols);
+  reference_engine.ApplyToFst(*compiled->fst, *compiled->symbols);
+
+  logger->info("compiled a reference of {} tokens into {} states and {} symbols", compiled->token_ids.size(),
+               compiled->fst->NumStates(), compiled->symbols->NumSymbols());
+  loader.setCompiledReference(compiled);
+}
+
+void CompiledReference::Write(const FstLoader &loader, const std::string &filename) {
+  auto compiled = loader.getCompiledReference();
+  if (!compiled) {
+    throw std::runtime_error("the reference must be compiled before being written");
+  }
+
+  std::ofstream out(filename, std::ios::binary);
+  if (!out.is_open()) {
+    throw std::runtime_error("Cannot open output file " + filename);
+  }
+
+  out.write(kMagic, sizeof(kMagic));
+  BundleWriter writer(out);
+  writer.WriteUInt32(kFormatVersion);
+  writer.WriteString(to_string(FSTALIGNER_VERSION_MAJOR) + "." + to_string(FSTALIGNER_VERSION_MINOR) + "." +
+                     to_string(FSTALIGNER_VERSION_PATCH));
+
+  loader.WriteCompiled(writer);
+  compiled->engine.Write(writer);
+  writer.WriteInts(compiled->token_ids);
+  writer.WriteInts(compiled->token_states);
+  writer.WriteInt32(compiled->first_synonym_label);
+
+  std::ostringstream symbols_blob;
+  compiled->symbols->Write(symbols_blob);
+  writer.WriteString(symbols_blob.str());
+
+  std::ostringstream fst_blob;
+  compiled->fst->Write(fst_blob, FstWriteOptions(filename));
+  writer.WriteString(fst_blob.str());
+
+  out.close();
+  if (!out) {
+    throw std::runtime_error("failed to write the compiled reference " + filename);
+  }
+}
+
+std::unique_ptr<FstLoader> CompiledReference::Read(const std::string &filename) {
+  auto logger = logger::GetOrCreateLogger("CompiledReference");
+  MappedFile file(filename);
+  if (file.size() < sizeof(kMagic) || memcmp(file.begin(), kMagic, sizeof(kMagic)) != 0) {
+    throw std::runtime_error(filename + " isn't a compiled fstalign reference");
+  }
+
+  BundleReader reader(file.begin() + sizeof(kMagic), file.end(), filename);
+  uint32_t version = reader.ReadUInt32();
+  std::string compiled_by = reader.ReadString();
+  if (version != kFormatVersion) {
+    throw std::runtime_error(filename + " was compiled by fstalign " + compiled_by + " in format version " +
+                             to_string(version) + ", this version reads format " + to_string(kFormatVersion) +
+                             ", recompile the reference");
+  }
+
+  std::unique_ptr<FstLoader> loader;
+  std::string kind = reader.ReadString();
+  if (kind == "nlp") {
+    loader = NlpFstLoader::ReadCompiled(reader);
+  } else if (kind == "ctm") {
+    loader = CtmFstLoader::ReadCompiled(reader);
+  } else if (kind == "text") {
+    loader = OneBestFstLoader::ReadCompiled(reader);
+  } else {
+    throw std::runtime_error("unknown reference type [" + kind + "] in " + filename);
+  }
+
+  auto compiled = std::make_shared<CompiledReference>();
+  compiled->engine.Read(reader);
+  compiled->token_ids = reader.ReadInts();
+  compiled->token_states = reader.ReadInts();
+  compiled->first_synonym_label = reader.ReadInt32();
+
+  // OpenFST builds both straight from the mapped blobs
+  const char *begin, *end;
+  reader.ReadBlob(begin, end);
+  {
+    MemoryStreamBuf buffer(begin, end);
+    std::istream strm(&buffer);
+    compiled->symbols.reset(SymbolTable::Read(strm, filename));
+    if (!compiled->symbols) {
+      throw std::runtime_error("invalid symbol table in " + filename);
+    }
+  }
+
+  reader.ReadBlob(begin, end);
+  {
+    MemoryStreamBuf buffer(begin, end);
+    std::istream strm(&buffer);
+    compiled->fst.reset(StdVectorFst::Read(strm, FstReadOptions(filename)));
+    if (!compiled->fst) {
+      throw std::runtime_error("invalid reference fst in " + filename);
+    }
+  }
+
+  if (compiled->token_states.size() != compiled->token_ids.size()) {
+    throw std::runtime_error("inconsistent token data in " + filename);
+  }
+
+  logger->info("loaded a compiled reference of {} tokens from {} (fstalign {})", compiled->token_ids.size(),
+               filename, compiled_by);
+  loader->setCompiledReference(compiled);
+  return loader;
+}
+
+void CompiledReference::ApplyLevenshteinMap(StdVectorFst &ref_fst, const std::vector<int> &map) const {
+  int map_sz = map.size();
+  for (int wc = 0; wc < map_sz && wc < token_states.size(); wc++) {
+    if (map[wc] <= 0) {
+      continue;
+    }
+    MutableArcIterator<StdVectorFst> aiter(&ref_fst, token_states[wc]);
+    StdArc arc = aiter.Value();
+    arc.weight = 1.0f;
+    aiter.SetValue(arc);
+  }
+}
+
+bool CompiledReference::CoversHypothesis(const SymbolTable &hyp_symbols, const std::vector<int> &hyp_ids) const {
+  if (hyp_symbols.NumSymbols() != symbols->NumSymbols()) {
+    return false;
+  }
+  for (int id : hyp_ids) {
+    if (id >= first_synonym_label) {
+      return false;
+    }
+  }
+  return true;
+}
+
+SymbolTable CompiledReference::ReferenceSymbols() const {
+  // the symbols are iterated in the order they were added, with their original labels
+  SymbolTable reference_symbols(symbols->Name());
+  for (SymbolTableIterator siter(*symbols); !siter.Done(); siter.Next()) {
+    if (siter.Value() < first_synonym_label) {
+      reference_symbols.AddSymbol(siter.Symbol(), siter.Value());
+    }
+  }
+  return reference_symbols;
+}
+
+/***************************************
+    Compiled Reference Class End
+ ***************************************/
@@ -0,0 +1,99 @@
+/*
+ * CompiledReference.h
+ *
+ * A reference prepared once by `fstalign compile-ref` and stored as a versioned
+ * binary bundle (.fstalign-ref), so that later wer/align runs against many
+ * hypotheses skip parsing, normalization expansion and synonym application.
+ *
+ */
+
+#ifndef __COMPILED_REFERENCE_H__
+#define __COMPILED_REFERENCE_H__
+
+#include <cstdint>
+#include <memory>
+
+#include "FstLoader.h"
+#include "MappedFile.h"
+#include "SynonymEngine.h"
+
+// Little-endian, length-prefixed primitives the bundle is made of
+class BundleWriter {
+ public:
+  BundleWriter(std::ostream &out);
+  void WriteUInt32(uint32_t value);
+  void WriteInt32(int32_t value);
+  void WriteFloat(float value);
+  void WriteBool(bool value);
+  void WriteString(const std::string &value);
+  void WriteStrings(const std::vector<std::string> &values);
+  void WriteInts(const std::vector<int> &values);
+
+ private:
+  std::ostream &out_;
+};
+
+// Reads the primitives straight from the mapped bundle, throwing on truncated input
+class BundleReader {
+ public:
+  BundleReader(const char *begin, const char *end, const std::string &filename);
+  uint32_t ReadUInt32();
+  int32_t ReadInt32();
+  float ReadFloat();
+  bool ReadBool();
+  std::string ReadString();
+  std::vector<std::string> ReadStrings();
+  std::vector<int> ReadInts();
+  // returns the next length-prefixed blob as a [begin, end) range of the mapping
+  void ReadBlob(const char *&begin, const char *&end);
+
+ private:
+  void Need(size_t bytes);
+
+  const char *cur_;
+  const char *end_;
+  std::string filename_;
+};
+
+class CompiledReference {
+ public:
+  static const uint32_t kFormatVersion;
+  static const char *const kExtension;
+
+  CompiledReference();
+
+  // Prepares the reference the way Fstalign() would, up to the steps depending on the
+  // hypothesis, and attaches the result to the loader.
+  static void Compile(FstLoader &loader, const SynonymEngine &engine, const std::string &symbols_filename);
+  // Writes the loader metadata and its attached compiled reference
+  static void Write(const FstLoader &loader, const std::string &filename);
+  // Restores the reference loader, with the compiled reference attached to it
+  static std::unique_ptr<FstLoader> Read(const std::string &filename);
+
+  // gives the levenshtein-aligned token arcs the same weight convertToFst() would have
+  void ApplyLevenshteinMap(fst::StdVectorFst &ref_fst, const std::vector<int> &map) const;
+
+  // True when the hypothesis ids, interned into a copy of `symbols`, added no symbol and
+  // are all reference symbols.  A direct run then has the same symbols, synonym rules and
+  // reference fst as the compiled ones, so both break the ties of the walk the same way.
+  bool CoversHypothesis(const fst::SymbolTable &hyp_symbols, const std::vector<int> &hyp_ids) const;
+  // the symbols a direct run has after interning the reference tokens, to prepare the
+  // reference again from its loader when the hypothesis isn't covered
+  fst::SymbolTable ReferenceSymbols() const;
+
+  // symbols of the reference, normalizations and synonyms
+  std::unique_ptr<fst::SymbolTable> symbols;
+  // reference FST with synonyms applied, before epsilon removal and arc sorting
+  std::unique_ptr<fst::StdVectorFst> fst;
+  // label of each reference token, as returned by convertToIntVector()
+  std::vector<int> token_ids;
+  // state holding the arc of each reference token, always its first arc
+  std::vector<int> token_states;
+  // first label added by the synonym rules, the labels before it are the reference symbols
+  int64_t first_synonym_label;
+  // the synonym rules the reference was compiled with, before the rules generated from
+  // its vocabulary, i.e. the engine a direct run starts from
+  SynonymEngine engine;
+};
+
+#endif  // __COMPILED_REFERENCE_H__
@@ -0,0 +1,393 @@
+/*
+ * CompressedStream.cpp
+ *
+ * zstd is optional: fstalign is built with it when CMake finds the library
+ * (FSTALIGN_WITH_ZSTD), .zst files are rejected otherwise.
+ */
+
+#include "CompressedStream.h"
+
+#include <zlib.h>
+#include <fstream>
+#include <stdexcept>
+#include <streambuf>
+#include <vector>
+
+#ifdef FSTALIGN_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include "utilities.h"
+
+// size of the compressed and uncompressed buffers of the streams
+static const size_t kBufferSize = 1 << 16;
+
+Compression CompressionOf(const std::string &filename) {
+  if (EndsWithCaseInsensitive(filename, ".gz")) {
+    return Compression::kGzip;
+  } else if (EndsWithCaseInsensitive(filename, ".zst")) {
+    return Compression::kZstd;
+  }
+  return Compression::kNone;
+}
+
+std::string WithoutCompressionExtension(const std::string &filename) {
+  switch (CompressionOf(filename)) {
+    case Compression::kGzip:
+      return filename.substr(0, filename.size() - 3);
+    case Compression::kZstd:
+      return filename.substr(0, filename.size() - 4);
+    default:
+      return filename;
+  }
+}
+
+namespace {
+
+enum class CodecMode { kContinue, kFlush, kFinish };
+
+// One step of a (de)compression: consumes [in, in_end) and fills [out, out_end),
+// advancing both pointers.  Returns true once there's nothing left to output for
+// `mode`: the end of a compressed stream when decompressing, the end of the flush
+// or of the stream when compressing.
+class Codec {
+ public:
+  virtual ~Codec() {}
+  virtual bool Process(const char *&in, const char *in_end, char *&out, char *out_end, CodecMode mode) = 0;
+};
+
+class GzipDecoder : public Codec {
+ public:
+  explicit GzipDecoder(const std::string &filename) : filename_(filename) {
+    stream_ = {};
+    // 32: accept both the gzip and zlib headers
+    if (inflateInit2(&stream_, 15 + 32) != Z_OK) {
+      throw std::runtime_error("Cannot initialize the decompression of " + filename_);
+    }
+  }
+  ~GzipDecoder() { inflateEnd(&stream_); }
+
+  bool Process(const char *&in, const char *in_end, char *&out, char *out_end, CodecMode) override {
+    if (at_end_) {
+      if (in == in_end) {
+        return true;
+      }
+      // concatenated gzip members, as written by `gzip -c a >> b`
+      inflateReset(&stream_);
+      at_end_ = false;
+    }
+    stream_.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in));
+    stream_.avail_in = in_end - in;
+    stream_.next_out = reinterpret_cast<Bytef *>(out);
+    stream_.avail_out = out_end - out;
+    int ret = inflate(&stream_, Z_NO_FLUSH);
+    in = reinterpret_cast<const char *>(stream_.next_in);
+    out = reinterpret_cast<char *>(stream_.next_out);
+    if (ret == Z_STREAM_END) {
+      at_end_ = true;
+      return true;
+    }
+    if (ret != Z_OK && ret != Z_BUF_ERROR) {
+      throw std::runtime_error("Corrupt gzip data in " + filename_);
+    }
+    return false;
+  }
+
+ private:
+  std::string filename_;
+  z_stream stream_;
+  bool at_end_ = false;
+};
+
+class GzipEncoder : public Codec {
+ public:
+  explicit GzipEncoder(const std::string &filename) : filename_(filename) {
+    stream_ = {};
+    // 16: write a gzip header rather than a zlib one
+    if (deflateInit2(&stream_, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+      throw std::runtime_error("Cannot initialize the compression of " + filename_);
+    }
+  }
+  ~GzipEncoder() { deflateEnd(&stream_); }
+
+  bool Process(const char *&in, const char *in_end, char *&out, char *out_end, CodecMode mode) override {
+    stream_.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in));
+    stream_.avail_in = in_end - in;
+    stream_.next_out = reinterpret_cast<Bytef *>(out);
+    stream_.avail_out = out_end - out;
+    int flush = mode == CodecMode::kFinish ? Z_FINISH : mode == CodecMode::kFlush ? Z_SYNC_FLUSH : Z_NO_FLUSH;
+    int ret = deflate(&stream_, flush);
+    in = reinterpret_cast<const char *>(stream_.next_in);
+    out = reinterpret_cast<char *>(stream_.next_out);
+    if (ret == Z_STREAM_ERROR) {
+      throw std::runtime_error("Cannot compress the data of " + filename_);
+    }
+    if (mode == CodecMode::kFinish) {
+      return ret == Z_STREAM_END;
+    }
+    // output space left: the input was consumed and everything flushed
+    return stream_.avail_out != 0;
+  }
+
+ private:
+  std::string filename_;
+  z_stream stream_;
+};
+
+#ifdef FSTALIGN_WITH_ZSTD
+class ZstdDecoder : public Codec {
+ public:
+  explicit ZstdDecoder(const std::string &filename) : filename_(filename), stream_(ZSTD_createDStream()) {
+    if (stream_ == nullptr) {
+      throw std::runtime_error("Cannot initialize the decompression of " + filename_);
+    }
+  }
+  ~ZstdDecoder() { ZSTD_freeDStream(stream_); }
+
+  bool Process(const char *&in, const char *in_end, char *&out, char *out_end, CodecMode) override {
+    if (at_end_ && in == in_end) {
+      return true;
+    }
+    ZSTD_inBuffer input = {in, static_cast<size_t>(in_end - in), 0};
+    ZSTD_outBuffer output = {out, static_cast<size_t>(out_end - out), 0};
+    size_t ret = ZSTD_decompressStream(stream_, &output, &input);
+    if (ZSTD_isError(ret)) {
+      throw std::runtime_error("Corrupt zstd data in " + filename_ + ": " + ZSTD_getErrorName(ret));
+    }
+    in += input.pos;
+    out += output.pos;
+    // 0 once a frame is decoded and flushed, the following frames are decoded by the same stream
+    at_end_ = ret == 0;
+    return at_end_;
+  }
+
+ private:
+  std::string filename_;
+  ZSTD_DStream *stream_;
+  bool at_end_ = false;
+};
+
+class ZstdEncoder : public Codec {
+ public:
+  explicit ZstdEncoder(const std::string &filename) : filename_(filename), stream_(ZSTD_createCCtx()) {
+    if (stream_ == nullptr) {
+      throw std::runtime_error("Cannot initialize the compression of " + filename_);
+    }
+  }
+  ~ZstdEncoder() { ZSTD_freeCCtx(stream_); }
+
+  bool Process(const char *&in, const char *in_end, char *&out, char *out_end, CodecMode mode) override {
+    ZSTD_inBuffer input = {in, static_cast<size_t>(in_end - in), 0};
+    ZSTD_outBuffer output = {out, static_cast<size_t>(out_end - out), 0};
+    ZSTD_EndDirective directive =
+        mode == CodecMode::kFinish ? ZSTD_e_end : mode == CodecMode::kFlush ? ZSTD_e_flush : ZSTD_e_continue;
+    size_t remaining = ZSTD_compressStream2(stream_, &output, &input, directive);
+    if (ZSTD_isError(remaining)) {
+      throw std::runtime_error("Cannot compress the data of " + filename_ + ": " + ZSTD_getErrorName(remaining));
+    }
+    in += input.pos;
+    out += output.pos;
+    if (mode == CodecMode::kContinue) {
+      return input.pos == input.size;
+    }
+    return remaining == 0;
+  }
+
+ private:
+  std::string filename_;
+  ZSTD_CCtx *stream_;
+};
+#endif
+
+std::unique_ptr<Codec> MakeCodec(const std::string &filename, Compression compression, bool decode) {
+  switch (compression) {
+    case Compression::kGzip:
+      if (decode) {
+        return std::unique_ptr<Codec>(new GzipDecoder(filename));
+      }
+      return std::unique_ptr<Codec>(new GzipEncoder(filename));
+    case Compression::kZstd:
+#ifdef FSTALIGN_WITH_ZSTD
+      if (decode) {
+        return std::unique_ptr<Codec>(new ZstdDecoder(filename));
+      }
+      return std::unique_ptr<Codec>(new ZstdEncoder(filename));
+#else
+      throw std::runtime_error("Cannot read or write " + filename + ", fstalign was built without zstd support");
+#endif
+    default:
+      throw std::runtime_error("Unknown compression for " + filename);
+  }
+}
+
+// Reads the decompressed data of `source`
+class DecompressingBuf : public std::streambuf {
+ public:
+  DecompressingBuf(std::streambuf *source, std::unique_ptr<Codec> codec, const std::string &filename)
+      : source_(source), codec_(std::move(codec)), filename_(filename), in_(kBufferSize), out_(kBufferSize) {
+    in_pos_ = in_end_ = in_.data();
+  }
+
+ protected:
+  int_type underflow() override {
+    if (gptr() < egptr()) {
+      return traits_type::to_int_type(*gptr());
+    }
+    for (;;) {
+      if (in_pos_ == in_end_ && !source_done_) {
+        std::streamsize size = source_->sgetn(in_.data(), in_.size());
+        source_done_ = size <= 0;
+        in_pos_ = in_.data();
+        in_end_ = in_.data() + (size > 0 ? size : 0);
+      }
+
+      char *out = out_.data();
+      bool ended = codec_->Process(in_pos_, in_end_, out, out_.data() + out_.size(), CodecMode::kContinue);
+      if (out != out_.data()) {
+        setg(out_.data(), out_.data(), out);
+        return traits_type::to_int_type(*gptr());
+      }
+      if (source_done_ && in_pos_ == in_end_) {
+        if (!ended) {
+          throw std::runtime_error("Truncated compressed input " + filename_);
+        }
+        return traits_type::eof();
+      }
+    }
+  }
+
+ private:
+  std::streambuf *source_;
+  std::unique_ptr<Codec> codec_;
+  std::string filename_;
+  std::vector<char> in_;
+  std::vector<char> out_;
+  const char *in_pos_;
+  const char *in_end_;
+  bool source_done_ = false;
+};
+
+// Writes the compressed data to `sink`
+class CompressingBuf : public std::streambuf {
+ public:
+  CompressingBuf(std::streambuf *sink, std::unique_ptr<Codec> codec, const std::string &filename)
+      : sink_(sink), codec_(std::move(codec)), filename_(filename), in_(kBufferSize), out_(kBufferSize) {
+    setp(in_.data(), in_.data() + in_.size());
+  }
+
+  // ends the compressed stream, nothing can be written afterwards
+  void Finish() {
+    if (!finished_) {
+      finished_ = true;
+      Compress(CodecMode::kFinish);
+      sink_->pubsync();
+    }
+  }
+
+ protected:
+  int_type overflow(int_type c) override {
+    if (finished_) {
+      return traits_type::eof();
+    }
+    Compress(CodecMode::kContinue);
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+
+  int sync() override {
+    // a flush of the compressor costs a few bytes, skip it when there's nothing new
+    if (finished_ || (pptr() == pbase() && !pending_)) {
+      return 0;
+    }
+    Compress(CodecMode::kFlush);
+    pending_ = false;
+    return sink_->pubsync();
+  }
+
+ private:
+  void Compress(CodecMode mode) {
+    const char *in = pbase();
+    const char *in_end = pptr();
+    pending_ = pending_ || in != in_end;
+    bool done = false;
+    while (in != in_end || !done) {
+      char *out = out_.data();
+      done = codec_->Process(in, in_end, out, out_.data() + out_.size(), mode);
+      std::streamsize size = out - out_.data();
+      if (size > 0 && sink_->sputn(out_.data(), size) != size) {
+        throw std::runtime_error("Cannot write to output file " + filename_);
+      }
+    }
+    setp(in_.data(), in_.data() + in_.size());
+  }
+
+  std::streambuf *sink_;
+  std::unique_ptr<Codec> codec_;
+  std::string filename_;
+  std::vector<char> in_;
+  std::vector<char> out_;
+  bool pending_ = false;
+  bool finished_ = false;
+};
+
+// The streams own their file, stdin and stdout are only borrowed
+class CompressedInput : public std::istream {
+ public:
+  CompressedInput(const std::string &filename, Compression compression) : std::istream(nullptr) {
+    std::streambuf *source = std::cin.rdbuf();
+    if (filename != "-") {
+      if (!file_.open(filename, std::ios::in | std::ios::binary)) {
+        throw std::runtime_error("Cannot open input file " + filename);
+      }
+      source = &file_;
+    }
+    buf_.reset(new DecompressingBuf(source, MakeCodec(filename, compression, true), filename));
+    rdbuf(buf_.get());
+    // otherwise the errors of the data would only set the badbit, and look like the end of the file
+    exceptions(std::ios::badbit);
+  }
+
+ private:
+  std::filebuf file_;
+  std::unique_ptr<DecompressingBuf> buf_;
+};
+
+class CompressedOutput : public std::ostream {
+ public:
+  CompressedOutput(const std::string &filename, Compression compression) : std::ostream(nullptr) {
+    std::streambuf *sink = std::cout.rdbuf();
+    if (filename != "-") {
+      if (!file_.open(filename, std::ios::out | std::ios::trunc | std::ios::binary)) {
+        throw std::runtime_error("Cannot open output file " + filename);
+      }
+      sink = &file_;
+    }
+    buf_.reset(new CompressingBuf(sink, MakeCodec(filename, compression, false), filename));
+    rdbuf(buf_.get());
+  }
+
+  ~CompressedOutput() {
+    // like the close of an ofstream, a failure can't be reported from here
+    try {
+      buf_->Finish();
+    } catch (const std::exception &) {
+    }
+  }
+
+ private:
+  std::filebuf file_;
+  std::unique_ptr<CompressingBuf> buf_;
+};
+
+}  // namespace
+
+std::unique_ptr<std::istream> OpenCompressedInput(const std::string &filename, Compression compression) {
+  return std::unique_ptr<std::istream>(new CompressedInput(filename, compression));
+}
+
+std::unique_ptr<std::ostream> OpenCompressedOutput(const std::string &filename, Compression compression) {
+  return std::unique_ptr<std::ostream>(new CompressedOutput(filename, compression));
+}
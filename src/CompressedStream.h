@@ -0,0 +1,28 @@
+/*
+ * CompressedStream.h
+ *
+ * Streaming gzip and zstd (de)compression of the inputs and outputs, picked
+ * from the extension of their files: .gz or .zst.  Nothing is written to disk
+ * uncompressed, the data is (de)compressed as it's read or written.
+ */
+
+#ifndef __COMPRESSED_STREAM_H__
+#define __COMPRESSED_STREAM_H__
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+enum class Compression { kNone, kGzip, kZstd };
+
+Compression CompressionOf(const std::string &filename);
+// e.g. call.nlp for call.nlp.gz, so the format of the input can be told from the rest of its name
+std::string WithoutCompressionExtension(const std::string &filename);
+
+// Streams over compressed files, "-" being stdin/stdout.  Both throw when the
+// file can't be opened, and the input stream throws on corrupt or truncated data.
+// The output is complete once the stream is destroyed.
+std::unique_ptr<std::istream> OpenCompressedInput(const std::string &filename, Compression compression);
+std::unique_ptr<std::ostream> OpenCompressedOutput(const std::string &filename, Compression compression);
+
+#endif  // __COMPRESSED_STREAM_H__
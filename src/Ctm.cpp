@@ -9,7 +9,11 @@
 
 #include "Ctm.h"
 
-#include <csv/csv.h>
+#include <cstring>
+#include <stdexcept>
+
+#include "CompiledReference.h"
+#include "MappedFile.h"
 
 using namespace std;
 using namespace fst;
@@ -17,16 +21,18 @@ using namespace fst;
 /***************************************
     CTM FST Loader Class Start
  ***************************************/
-CtmFstLoader::CtmFstLoader(vector<RawCtmRecord> &records, bool use_case) : FstLoader() {
+CtmFstLoader::CtmFstLoader(vector<RawCtmRecord> records, bool use_case) : FstLoader() {
   {
-    mCtmRows = records;
+    mCtmRows = std::move(records);
     mUseCase = use_case;
+    CaseFolder folder;
+    mToken.reserve(mCtmRows.size());
     for (auto &row : mCtmRows) {
-      std::string token = std::string(row.word);
-      if (!mUseCase) {
-        token = UnicodeLowercase(row.word);
+      if (mUseCase) {
+        mToken.push_back(row.word);
+      } else {
+        mToken.push_back(folder.Lowercase(row.word));
       }
-      mToken.push_back(token);
     }
   }
 }
@@ -34,13 +40,23 @@ CtmFstLoader::CtmFstLoader(vector<RawCtmRecord> &records, bool use_case) : FstLo
 CtmFstLoader::~CtmFstLoader() {
   // TODO Auto-generated destructor stub
 }
-void CtmFstLoader::addToSymbolTable(SymbolTable &symbol) const {
-  for (auto &s : mToken) {
-    AddSymbolIfNeeded(symbol, s);
+std::vector<int> CtmFstLoader::convertToIntVector(SymbolInterner &vocab) const {
+  auto logger = logger::GetOrCreateLogger("ctmloader");
+  std::vector<int> vect;
+  int sz = mToken.size();
+  logger->info("creating std::vector<int> for CTM for {} tokens", sz);
+  vect.reserve(sz);
+
+  // mToken content is already lowercased when needed
+  for (auto &token : mToken) {
+    vect.emplace_back(vocab.Intern(token));
   }
+
+  return vect;
 }
 
-StdVectorFst CtmFstLoader::convertToFst(const SymbolTable &symbol, std::vector<int> map) const {
+StdVectorFst CtmFstLoader::convertToFst(const SymbolInterner &vocab, const std::vector<int> &token_ids,
+                                        const std::vector<int> &map, std::vector<int> *token_states) const {
   auto logger = logger::GetOrCreateLogger("ctmloader");
   //
   StdVectorFst transducer;
@@ -53,17 +69,16 @@ StdVectorFst CtmFstLoader::convertToFst(const SymbolTable &symbol, std::vector<i
   int nextState = 1;
   int wc = 0;
   int map_sz = map.size();
-  for (TokenType::const_iterator i = mToken.begin(); i != mToken.end(); ++i) {
-    std::string token = *i;
-    if (!mUseCase) {
-      token = UnicodeLowercase(token);
-    }
+  for (int token_sym : token_ids) {
     transducer.AddState();
 
+    if (token_states) {
+      token_states->push_back(prevState);
+    }
     if (map_sz > wc && map[wc] > 0) {
-      transducer.AddArc(prevState, StdArc(symbol.Find(token), symbol.Find(token), 1.0f, nextState));
+      transducer.AddArc(prevState, StdArc(token_sym, token_sym, 1.0f, nextState));
     } else {
-      transducer.AddArc(prevState, StdArc(symbol.Find(token), symbol.Find(token), 0.0f, nextState));
+      transducer.AddArc(prevState, StdArc(token_sym, token_sym, 0.0f, nextState));
     }
 
     prevState = nextState;
@@ -75,25 +90,36 @@ StdVectorFst CtmFstLoader::convertToFst(const SymbolTable &symbol, std::vector<i
   return transducer;
 }
 
-std::vector<int> CtmFstLoader::convertToIntVector(fst::SymbolTable &symbol) const {
-  auto logger = logger::GetOrCreateLogger("ctmloader");
-  std::vector<int> vect;
-  addToSymbolTable(symbol);
-  int sz = mToken.size();
-  logger->info("creating std::vector<int> for CTM for {} tokens", sz);
-  vect.reserve(sz);
-
-  FstAlignOption options;
-  for (TokenType::const_iterator i = mToken.begin(); i != mToken.end(); ++i) {
-    std::string token = *i;
-    int token_sym = symbol.Find(token);
-    if (token_sym == -1) {
-      token_sym = symbol.Find(options.symUnk);
-    }
-    vect.emplace_back(token_sym);
+void CtmFstLoader::WriteCompiled(BundleWriter &writer) const {
+  writer.WriteString("ctm");
+  writer.WriteBool(mUseCase);
+  writer.WriteStrings(mToken);
+  writer.WriteUInt32(mCtmRows.size());
+  for (auto &row : mCtmRows) {
+    writer.WriteString(row.recording);
+    writer.WriteString(row.channel);
+    writer.WriteFloat(row.start_time_secs);
+    writer.WriteFloat(row.duration_secs);
+    writer.WriteString(row.word);
+    writer.WriteFloat(row.confidence);
   }
+}
 
-  return vect;
+std::unique_ptr<CtmFstLoader> CtmFstLoader::ReadCompiled(BundleReader &reader) {
+  bool use_case = reader.ReadBool();
+  auto loader = std::make_unique<CtmFstLoader>(vector<RawCtmRecord>(), use_case);
+  loader->mToken = reader.ReadStrings();
+  uint32_t num_rows = reader.ReadUInt32();
+  loader->mCtmRows.resize(num_rows);
+  for (auto &row : loader->mCtmRows) {
+    row.recording = reader.ReadString();
+    row.channel = reader.ReadString();
+    row.start_time_secs = reader.ReadFloat();
+    row.duration_secs = reader.ReadFloat();
+    row.word = reader.ReadString();
+    row.confidence = reader.ReadFloat();
+  }
+  return loader;
 }
 
 /***************************************
@@ -105,80 +131,82 @@ std::vector<int> CtmFstLoader::convertToIntVector(fst::SymbolTable &symbol) cons
    ***************************************/
 CtmReader::CtmReader() {}
 
-vector<RawCtmRecord> read_from_disk_no_conf(const string &filename) {
-  vector<RawCtmRecord> vect;
-  io::CSVReader<5, io::trim_chars<' ', '\t'>, io::no_quote_escape<' '>, io::throw_on_overflow, io::empty_line_comment>
-      input_ctm(filename);
-
-  input_ctm.set_header("audiofile", "channel", "start", "duration", "word");
-
-  string audiofile, channel, start, duration, word, confidence;
-  while (input_ctm.read_row(audiofile, channel, start, duration, word)) {
-    RawCtmRecord record;
-    record.recording = audiofile;
-    record.channel = channel;
-    record.start_time_secs = stof(start);
-    record.duration_secs = stof(duration);
-    record.word = word;
-    record.confidence = 1;
-    vect.push_back(record);
+// stof() equivalent working on a range of the mapped file, which isn't null-terminated
+static float ParseCtmFloat(const char *begin, const char *end, size_t line_number, const string &filename) {
+  char buffer[64];
+  size_t len = end - begin;
+  if (len == 0 || len >= sizeof(buffer)) {
+    throw std::runtime_error("invalid number on line " + to_string(line_number) + " of " + filename);
   }
-
-  return vect;
-}
-
-vector<RawCtmRecord> read_from_disk_with_conf(const string &filename) {
-  vector<RawCtmRecord> vect;
-  io::CSVReader<6, io::trim_chars<' ', '\t'>, io::no_quote_escape<' '>, io::throw_on_overflow, io::empty_line_comment>
-      input_ctm(filename);
-
-  input_ctm.set_header("audiofile", "channel", "start", "duration", "word", "confidence");
-
-  string audiofile, channel, start, duration, word, confidence;
-  while (input_ctm.read_row(audiofile, channel, start, duration, word, confidence)) {
-    RawCtmRecord record;
-    record.recording = audiofile;
-    record.channel = channel;
-    record.start_time_secs = stof(start);
-    record.duration_secs = stof(duration);
-    record.word = word;
-    record.confidence = stof(confidence);
-    vect.push_back(record);
+  memcpy(buffer, begin, len);
+  buffer[len] = '\0';
+
+  char *parsed_end;
+  float value = strtof(buffer, &parsed_end);
+  if (parsed_end == buffer) {
+    throw std::runtime_error("invalid number [" + string(buffer) + "] on line " + to_string(line_number) + " of " +
+                             filename);
   }
-
-  return vect;
+  return value;
 }
 
 vector<RawCtmRecord> CtmReader::read_from_disk(const string &filename) {
-  ifstream ctm_peek(filename);
-  string first_line;
-  if (!std::getline(ctm_peek, first_line)) {
-    vector<RawCtmRecord> vect;
-    return vect;
-  }
-
-  int sz = 1;
-  char lastChar = 'x';
-
-  for (auto &c : first_line) {
-    if (c == ' ' || c == '\t') {
-      if (lastChar != ' ' && lastChar != '\t') {
-        sz++;
+  vector<RawCtmRecord> vect;
+  MappedFile file(filename);
+  LineCursor cursor(file.begin(), file.end());
+
+  // audiofile, channel, start, duration, word and the optional confidence score
+  const int max_fields = 6;
+  const char *field_begin[max_fields];
+  const char *field_end[max_fields];
+
+  const char *line_begin, *line_end;
+  while (cursor.NextLine(line_begin, line_end)) {
+    // any mix of spaces and tabs separates the columns, extra columns are ignored
+    int num_fields = 0;
+    const char *p = line_begin;
+    while (p < line_end && num_fields < max_fields) {
+      while (p < line_end && (*p == ' ' || *p == '\t')) {
+        p++;
+      }
+      if (p == line_end) {
+        break;
+      }
+      field_begin[num_fields] = p;
+      while (p < line_end && *p != ' ' && *p != '\t') {
+        p++;
       }
+      field_end[num_fields] = p;
+      num_fields++;
     }
 
-    lastChar = c;
-  }
+    if (num_fields == 0) {
+      // skipping empty lines
+      continue;
+    }
 
-  // Minimum CTM columns should be: audiofile, channel, start, duration, word
-  // Sixth confidence score column is optional
-  bool hasConf = sz > 5 ? true : false;
+    // Minimum CTM columns should be: audiofile, channel, start, duration, word
+    if (num_fields < 5) {
+      throw std::runtime_error("line " + to_string(cursor.LineNumber()) + " of " + filename + " has " +
+                               to_string(num_fields) + " columns, at least 5 expected");
+    }
 
-  if (hasConf) {
-    return read_from_disk_with_conf(filename);
-  } else {
-    return read_from_disk_no_conf(filename);
+    vect.emplace_back();
+    RawCtmRecord &record = vect.back();
+    record.recording.assign(field_begin[0], field_end[0]);
+    record.channel.assign(field_begin[1], field_end[1]);
+    record.start_time_secs = ParseCtmFloat(field_begin[2], field_end[2], cursor.LineNumber(), filename);
+    record.duration_secs = ParseCtmFloat(field_begin[3], field_end[3], cursor.LineNumber(), filename);
+    record.word.assign(field_begin[4], field_end[4]);
+    // Sixth confidence score column is optional
+    if (num_fields > 5) {
+      record.confidence = ParseCtmFloat(field_begin[5], field_end[5], cursor.LineNumber(), filename);
+    } else {
+      record.confidence = 1;
+    }
   }
+
+  return vect;
 }
 
 /***************************************
@@ -27,12 +27,16 @@ struct RawCtmRecord {
 
 class CtmFstLoader : public FstLoader {
  public:
-  CtmFstLoader(std::vector<RawCtmRecord> &records, bool use_case = false);
+  // records are a sink, std::move() them in when they aren't needed anymore
+  CtmFstLoader(std::vector<RawCtmRecord> records, bool use_case = false);
   ~CtmFstLoader();
   vector<RawCtmRecord> mCtmRows;
-  virtual void addToSymbolTable(fst::SymbolTable &symbol) const;
-  virtual fst::StdVectorFst convertToFst(const fst::SymbolTable &symbol, std::vector<int> map) const;
-  virtual std::vector<int> convertToIntVector(fst::SymbolTable &symbol) const;
+  virtual std::vector<int> convertToIntVector(SymbolInterner &vocab) const;
+  virtual fst::StdVectorFst convertToFst(const SymbolInterner &vocab, const std::vector<int> &token_ids,
+                                         const std::vector<int> &map,
+                                         std::vector<int> *token_states = nullptr) const;
+  virtual void WriteCompiled(BundleWriter &writer) const;
+  static std::unique_ptr<CtmFstLoader> ReadCompiled(BundleReader &reader);
   virtual const std::string &getToken(int index) const { return mToken.at(index); }
  private:
   bool mUseCase;
@@ -3,24 +3,31 @@
  */
 #include "FstFileLoader.h"
 
-FstFileLoader::FstFileLoader(std::string filename) : FstLoader(), filename_(filename) {}
+#include "CompressedStream.h"
 
-void FstFileLoader::addToSymbolTable(fst::SymbolTable& symbol) const { return; }
+FstFileLoader::FstFileLoader(std::string filename) : FstLoader(), filename_(filename) {}
 
-fst::StdVectorFst FstFileLoader::convertToFst(const fst::SymbolTable& symbol, std::vector<int> map) const {
+fst::StdVectorFst FstFileLoader::convertToFst(const SymbolInterner& vocab, const std::vector<int>& token_ids,
+                                              const std::vector<int>& map, std::vector<int>* token_states) const {
   auto logger = logger::GetOrCreateLogger("FstFileLoader");
-  fst::StdVectorFst* transducer = fst::StdVectorFst::Read(filename_);
+  fst::StdVectorFst* transducer;
+  if (CompressionOf(filename_) != Compression::kNone) {
+    auto input = OpenInput(filename_);
+    transducer = fst::StdVectorFst::Read(*input, fst::FstReadOptions(filename_));
+  } else {
+    // OpenFST reads stdin when given an empty filename
+    transducer = fst::StdVectorFst::Read(filename_ == "-" ? "" : filename_);
+  }
+  if (transducer == nullptr) {
+    throw std::runtime_error("Cannot read the FST of " + filename_);
+  }
   logger->info("Total FST has {} states.", transducer->NumStates());
   return (*transducer);
 }
 
-std::vector<int> FstFileLoader::convertToIntVector(fst::SymbolTable& symbol) const {
-  auto logger = logger::GetOrCreateLogger("FstFileLoader");
-  std::vector<int> vect;
-  logger->error("convertToIntVector isn't implemented for FST inputs");
-  vect.reserve(0);
-  vect.resize(0);
-  return vect;
+std::vector<int> FstFileLoader::convertToIntVector(SymbolInterner& vocab) const {
+  // serialized FSTs already use the labels of the symbols file, there's nothing to intern
+  return std::vector<int>();
 }
 
 FstFileLoader::~FstFileLoader() {}
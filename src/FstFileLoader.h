@@ -22,9 +22,10 @@ class FstFileLoader : public FstLoader {
   FstFileLoader(std::string filename);
   ~FstFileLoader();
 
-  virtual void addToSymbolTable(fst::SymbolTable &symbol) const;
-  virtual fst::StdVectorFst convertToFst(const fst::SymbolTable &symbol, std::vector<int> map) const;
-  virtual std::vector<int> convertToIntVector(fst::SymbolTable &symbol) const;
+  virtual std::vector<int> convertToIntVector(SymbolInterner &vocab) const;
+  virtual fst::StdVectorFst convertToFst(const SymbolInterner &vocab, const std::vector<int> &token_ids,
+                                         const std::vector<int> &map,
+                                         std::vector<int> *token_states = nullptr) const;
 
  private:
   std::string filename_;
@@ -6,6 +6,9 @@ FstLoader.cpp
 */
 
 #include "FstLoader.h"
+
+#include <stdexcept>
+
 #include "utilities.h"
 
 FstLoader::FstLoader() {
@@ -16,8 +19,32 @@ FstLoader::~FstLoader() {
   // TODO Auto-generated destructor stub
 }
 
-void FstLoader::AddSymbolIfNeeded(fst::SymbolTable &symbol, std::string str_value) {
-  if (symbol.Find(str_value) == -1) {
-    symbol.AddSymbol(str_value);
+void FstLoader::WriteCompiled(BundleWriter &writer) const {
+  throw std::runtime_error("this input type can't be compiled into a reference bundle");
+}
+
+SymbolInterner::SymbolInterner(fst::SymbolTable &symbols) : symbols_(symbols) {
+  ids_.reserve(symbols.NumSymbols());
+  for (fst::SymbolTableIterator siter(symbols); !siter.Done(); siter.Next()) {
+    ids_.emplace(siter.Symbol(), siter.Value());
+  }
+}
+
+int SymbolInterner::Intern(const std::string &token) {
+  auto it = ids_.find(token);
+  if (it != ids_.end()) {
+    return it->second;
+  }
+
+  int id = symbols_.AddSymbol(token);
+  ids_.emplace(token, id);
+  return id;
+}
+
+int SymbolInterner::Find(const std::string &token) const {
+  auto it = ids_.find(token);
+  if (it == ids_.end()) {
+    return -1;
   }
+  return it->second;
 }
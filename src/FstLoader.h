@@ -8,34 +8,75 @@ FstLoader.h
 #ifndef __FSTLOADER_H_
 #define __FSTLOADER_H_
 
+#include <memory>
+#include <unordered_map>
 #include <vector>
 #include "utilities.h"
 
+class BundleReader;
+class BundleWriter;
+class CompiledReference;
+
+// Hash-based front of a SymbolTable: each distinct token is looked up/added once and
+// every later lookup is served from the map.  Loaders intern their tokens through it
+// and the resulting label ids feed both the levenshtein pass and the FST construction.
+class SymbolInterner {
+ public:
+  explicit SymbolInterner(fst::SymbolTable &symbols);
+  // label id of the token, adding it to the symbol table on first sight
+  int Intern(const std::string &token);
+  // label id of the token or -1 (fst::kNoSymbol) when unknown, from the ids interned
+  // so far: the symbol table itself isn't read
+  int Find(const std::string &token) const;
+
+ private:
+  fst::SymbolTable &symbols_;
+  std::unordered_map<std::string, int> ids_;
+};
+
 class FstLoader {
  protected:
   typedef std::vector<std::string> TokenType;
   TokenType mToken;
+  std::shared_ptr<const CompiledReference> mCompiled;
 
  public:
   FstLoader();
   virtual ~FstLoader();
-  virtual void addToSymbolTable(fst::SymbolTable &symbol) const = 0;
-  static void AddSymbolIfNeeded(fst::SymbolTable &symbol, std::string str_value);
-  virtual fst::StdVectorFst convertToFst(const fst::SymbolTable &symbol, std::vector<int> map) const = 0;
-  virtual std::vector<int> convertToIntVector(fst::SymbolTable &symbol) const = 0;
+  // interns every symbol the loader needs and returns the label id of each token
+  virtual std::vector<int> convertToIntVector(SymbolInterner &vocab) const = 0;
+  // token_ids are the ones returned by convertToIntVector() for the same vocabulary.
+  // token_states, when given, receives the state holding the (first) arc of each token.
+  // The vocabulary is only read through Find(): Fstalign() builds the fsts while the
+  // synonym rules add their words to the symbol table.
+  virtual fst::StdVectorFst convertToFst(const SymbolInterner &vocab, const std::vector<int> &token_ids,
+                                         const std::vector<int> &map,
+                                         std::vector<int> *token_states = nullptr) const = 0;
+
+  // the metadata needed to restore this loader from a compiled reference bundle
+  virtual void WriteCompiled(BundleWriter &writer) const;
+  // the prepared reference, when this loader was restored from/compiled into a bundle
+  const CompiledReference *getCompiledReference() const { return mCompiled.get(); }
+  void setCompiledReference(std::shared_ptr<const CompiledReference> compiled) { mCompiled = std::move(compiled); }
 
   static std::unique_ptr<FstLoader> MakeReferenceLoader(const std::string& ref_filename,
                                                         const std::string& wer_sidecar_filename,
                                                         const std::string& json_norm_filename,
                                                         bool use_punctuation,
                                                         bool use_case,
-                                                        bool symbols_file_included);
+                                                        bool symbols_file_included,
+                                                        const std::string& ref_format = "");
 
   static std::unique_ptr<FstLoader> MakeHypothesisLoader(const std::string& hyp_filename,
                                                          const std::string& hyp_json_norm_filename,
                                                          bool use_punctuation,
                                                          bool use_case,
-                                                         bool symbols_file_included);
+                                                         bool symbols_file_included,
+                                                         const std::string& hyp_format = "");
+
+  // the format of an input: the explicit one when given, or the one of its extension.
+  // One of nlp, ctm, fst, txt or compiled
+  static std::string InputFormat(const std::string& filename, const std::string& format);
 
 
 };
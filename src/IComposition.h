@@ -36,6 +36,10 @@ class IComposition : public fst::VectorFst<fst::StdArc> {
   virtual StateId Start() = 0;
   virtual fst::Fst<fst::StdArc>::Weight Final(StateId stateId) = 0;
   virtual bool TryGetArcsAtState(StateId fromStateId, vector<fst::StdArc> *out_vector) = 0;
+  // approximate bytes of the composed states created so far, 0 when not tracked
+  virtual int64_t ApproxMemoryBytes() const { return 0; }
+  // the states of the reference and hypothesis fsts a composed state pairs, when known
+  virtual bool TryGetStatePair(StateId composedStateId, StateId *refA, StateId *refB) const { return false; }
 };
 
 #endif /*__ICOMPOSITION_H_ */
@@ -0,0 +1,252 @@
+/*
+ * JsonWriter.cpp
+ */
+
+#include "JsonWriter.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+JsonWriter::JsonWriter(std::ostream &out, bool pretty) : out_(out), pretty_(pretty) {}
+
+void JsonWriter::Indent(size_t depth) {
+  if (!pretty_) {
+    return;
+  }
+  out_ << '\n';
+  for (size_t i = 0; i < depth; i++) {
+    out_ << '\t';
+  }
+}
+
+void JsonWriter::OpenPending() {
+  // every enclosing scope is open once one of its values gets written
+  for (size_t depth = 0; depth < scopes_.size(); depth++) {
+    auto &scope = scopes_[depth];
+    if (scope.opened) {
+      continue;
+    }
+    // object members start on their own line, as with jsoncpp
+    if (scope.after_key) {
+      Indent(depth);
+    }
+    out_ << (scope.is_object ? '{' : '[');
+    scope.opened = true;
+  }
+}
+
+void JsonWriter::BeforeValue() {
+  if (after_key_) {
+    after_key_ = false;
+    return;
+  }
+  if (scopes_.empty()) {
+    return;
+  }
+
+  OpenPending();
+  auto &scope = scopes_.back();
+  if (scope.count++ > 0) {
+    out_ << ',';
+  }
+  Indent(scopes_.size());
+}
+
+void JsonWriter::BeginObject() {
+  bool after_key = after_key_;
+  BeforeValue();
+  scopes_.push_back({true, false, after_key, 0});
+}
+
+void JsonWriter::BeginArray() {
+  bool after_key = after_key_;
+  BeforeValue();
+  scopes_.push_back({false, false, after_key, 0});
+}
+
+void JsonWriter::EndObject() {
+  auto scope = scopes_.back();
+  scopes_.pop_back();
+  if (!scope.opened) {
+    out_ << "{}";
+    return;
+  }
+  Indent(scopes_.size());
+  out_ << '}';
+}
+
+void JsonWriter::EndArray() {
+  auto scope = scopes_.back();
+  scopes_.pop_back();
+  if (!scope.opened) {
+    out_ << "[]";
+    return;
+  }
+  Indent(scopes_.size());
+  out_ << ']';
+}
+
+void JsonWriter::Key(const std::string &key) {
+  OpenPending();
+  auto &scope = scopes_.back();
+  if (scope.count++ > 0) {
+    out_ << ',';
+  }
+  Indent(scopes_.size());
+  WriteString(key);
+  out_ << (pretty_ ? " : " : ":");
+  after_key_ = true;
+}
+
+void JsonWriter::Value(int value) {
+  BeforeValue();
+  out_ << value;
+}
+
+void JsonWriter::Value(int64_t value) {
+  BeforeValue();
+  out_ << value;
+}
+
+void JsonWriter::Value(uint64_t value) {
+  BeforeValue();
+  out_ << value;
+}
+
+// same conventions as jsoncpp: non finite values have no JSON literal
+static void WriteNumber(std::ostream &out, double value, int precision) {
+  if (std::isnan(value)) {
+    out << "null";
+    return;
+  }
+  if (std::isinf(value)) {
+    out << (value < 0 ? "-1e+9999" : "1e+9999");
+    return;
+  }
+
+  char buffer[40];
+  snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+  out << buffer;
+  if (strpbrk(buffer, ".eE") == nullptr) {
+    out << ".0";
+  }
+}
+
+// like jsoncpp, which stores floats as doubles
+void JsonWriter::Value(float value) { Value(static_cast<double>(value)); }
+
+void JsonWriter::Value(double value) {
+  BeforeValue();
+  WriteNumber(out_, value, 17);
+}
+
+void JsonWriter::Value(bool value) {
+  BeforeValue();
+  out_ << (value ? "true" : "false");
+}
+
+void JsonWriter::Value(const std::string &value) {
+  BeforeValue();
+  WriteString(value);
+}
+
+void JsonWriter::Value(const char *value) { Value(std::string(value)); }
+
+void JsonWriter::Null() {
+  BeforeValue();
+  out_ << "null";
+}
+
+// the code point of the UTF-8 sequence starting at s, leaving s on its last byte, as
+// jsoncpp decodes it: truncated, overlong and surrogate sequences give U+FFFD
+static unsigned int Utf8ToCodepoint(const char *&s, const char *end) {
+  const unsigned int kReplacementCharacter = 0xFFFD;
+  unsigned int first = static_cast<unsigned char>(*s);
+  if (first < 0x80) {
+    return first;
+  }
+  if (first < 0xE0) {
+    if (end - s < 2) {
+      return kReplacementCharacter;
+    }
+    unsigned int codepoint = ((first & 0x1F) << 6) | (static_cast<unsigned int>(s[1]) & 0x3F);
+    s += 1;
+    return codepoint < 0x80 ? kReplacementCharacter : codepoint;
+  }
+  if (first < 0xF0) {
+    if (end - s < 3) {
+      return kReplacementCharacter;
+    }
+    unsigned int codepoint = ((first & 0x0F) << 12) | ((static_cast<unsigned int>(s[1]) & 0x3F) << 6) |
+                             (static_cast<unsigned int>(s[2]) & 0x3F);
+    s += 2;
+    if (codepoint >= 0xD800 && codepoint <= 0xDFFF) {
+      return kReplacementCharacter;
+    }
+    return codepoint < 0x800 ? kReplacementCharacter : codepoint;
+  }
+  if (first < 0xF8) {
+    if (end - s < 4) {
+      return kReplacementCharacter;
+    }
+    unsigned int codepoint = ((first & 0x07) << 18) | ((static_cast<unsigned int>(s[1]) & 0x3F) << 12) |
+                             ((static_cast<unsigned int>(s[2]) & 0x3F) << 6) | (static_cast<unsigned int>(s[3]) & 0x3F);
+    s += 3;
+    return codepoint < 0x10000 ? kReplacementCharacter : codepoint;
+  }
+  return kReplacementCharacter;
+}
+
+static void WriteEscapedCodepoint(std::ostream &out, unsigned int codepoint) {
+  char escaped[8];
+  snprintf(escaped, sizeof(escaped), "\\u%04x", codepoint);
+  out << escaped;
+}
+
+void JsonWriter::WriteString(const std::string &value) {
+  out_ << '"';
+  const char *end = value.data() + value.size();
+  for (const char *c = value.data(); c != end; c++) {
+    switch (*c) {
+      case '"':
+        out_ << "\\\"";
+        break;
+      case '\\':
+        out_ << "\\\\";
+        break;
+      case '\b':
+        out_ << "\\b";
+        break;
+      case '\f':
+        out_ << "\\f";
+        break;
+      case '\n':
+        out_ << "\\n";
+        break;
+      case '\r':
+        out_ << "\\r";
+        break;
+      case '\t':
+        out_ << "\\t";
+        break;
+      default: {
+        // like jsoncpp, everything but printable ASCII is escaped, beyond the BMP as a
+        // surrogate pair
+        unsigned int codepoint = Utf8ToCodepoint(c, end);
+        if (codepoint < 0x20) {
+          WriteEscapedCodepoint(out_, codepoint);
+        } else if (codepoint < 0x80) {
+          out_ << static_cast<char>(codepoint);
+        } else if (codepoint < 0x10000) {
+          WriteEscapedCodepoint(out_, codepoint);
+        } else {
+          codepoint -= 0x10000;
+          WriteEscapedCodepoint(out_, 0xD800 + ((codepoint >> 10) & 0x3FF));
+          WriteEscapedCodepoint(out_, 0xDC00 + (codepoint & 0x3FF));
+        }
+      }
+    }
+  }
+  out_ << '"';
+}
@@ -0,0 +1,67 @@
+/*
+ * JsonWriter.h
+ *
+ * Streaming JSON emitter: values are written to the output as they come, without
+ * building a Json::Value tree first.  The pretty layout is the one of jsoncpp's
+ * styled writer, the compact one has no whitespace at all (e.g. for JSONL).
+ *
+ */
+
+#ifndef __JSON_WRITER_H__
+#define __JSON_WRITER_H__
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class JsonWriter {
+ public:
+  JsonWriter(std::ostream &out, bool pretty = true);
+
+  void BeginObject();
+  void EndObject();
+  void BeginArray();
+  void EndArray();
+  // names the next value, inside an object
+  void Key(const std::string &key);
+
+  void Value(int value);
+  void Value(int64_t value);
+  void Value(uint64_t value);
+  // 17 significant digits, floats being written as the double they convert to
+  void Value(float value);
+  void Value(double value);
+  void Value(bool value);
+  void Value(const std::string &value);
+  void Value(const char *value);
+  void Null();
+
+  // shorthand for Key(key) then Value(value)
+  template <typename T>
+  void Member(const std::string &key, const T &value) {
+    Key(key);
+    Value(value);
+  }
+
+ private:
+  struct Scope {
+    bool is_object;
+    bool opened;  // the bracket is only written with the first member, so empty scopes print {} or []
+    bool after_key;
+    int count;
+  };
+
+  // opens pending scopes and writes what precedes a value: separator, newline, indentation
+  void BeforeValue();
+  void OpenPending();
+  void Indent(size_t depth);
+  void WriteString(const std::string &value);
+
+  std::ostream &out_;
+  bool pretty_;
+  bool after_key_ = false;
+  std::vector<Scope> scopes_;
+};
+
+#endif  // __JSON_WRITER_H__
@@ -0,0 +1,136 @@
+/*
+ * MappedFile.cpp
+ */
+
+#include "MappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include "CompressedStream.h"
+
+MappedFile::MappedFile(const std::string &filename) {
+  Compression compression = CompressionOf(filename);
+  if (compression != Compression::kNone) {
+    LoadCompressed(filename, compression);
+  } else {
+    bool is_stdin = filename == "-";
+    int fd = is_stdin ? STDIN_FILENO : open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("Cannot open input file " + filename);
+    }
+
+    try {
+      Load(fd, filename);
+    } catch (...) {
+      if (!is_stdin) {
+        close(fd);
+      }
+      throw;
+    }
+    if (!is_stdin) {
+      close(fd);
+    }
+  }
+
+  // skip the UTF-8 BOM, if any
+  if (size_ >= 3 && memcmp(data_, "\xEF\xBB\xBF", 3) == 0) {
+    data_ += 3;
+    size_ -= 3;
+  }
+}
+
+void MappedFile::LoadCompressed(const std::string &filename, Compression compression) {
+  auto input = OpenCompressedInput(filename, compression);
+  char chunk[1 << 16];
+  while (input->read(chunk, sizeof(chunk)) || input->gcount() > 0) {
+    buffer_.append(chunk, input->gcount());
+  }
+  data_ = buffer_.data();
+  size_ = buffer_.size();
+}
+
+void MappedFile::Load(int fd, const std::string &filename) {
+  struct stat sb;
+  if (fstat(fd, &sb) < 0) {
+    throw std::runtime_error("Cannot stat input file " + filename);
+  }
+
+  // pipes and terminals can't be mapped
+  if (!S_ISREG(sb.st_mode)) {
+    char chunk[1 << 16];
+    for (;;) {
+      ssize_t size = read(fd, chunk, sizeof(chunk));
+      if (size == 0) {
+        break;
+      }
+      if (size < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw std::runtime_error("Cannot read input file " + filename);
+      }
+      buffer_.append(chunk, size);
+    }
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+    return;
+  }
+
+  size_ = sb.st_size;
+  if (size_ > 0) {
+    void *mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+      throw std::runtime_error("Cannot map input file " + filename);
+    }
+    // we only read the file once, front to back
+    madvise(mapping, size_, MADV_SEQUENTIAL);
+    mapping_ = mapping;
+    data_ = static_cast<const char *>(mapping);
+  }
+}
+
+MappedFile::~MappedFile() {
+  if (mapping_ != nullptr) {
+    munmap(mapping_, (data_ - static_cast<const char *>(mapping_)) + size_);
+  }
+}
+
+LineCursor::LineCursor(const char *begin, const char *end) : pos_(begin), end_(end) {}
+
+bool LineCursor::NextLine(const char *&line_begin, const char *&line_end) {
+  if (pos_ >= end_) {
+    return false;
+  }
+
+  line_begin = pos_;
+  auto newline = static_cast<const char *>(memchr(pos_, '\n', end_ - pos_));
+  if (newline == nullptr) {
+    line_end = end_;
+    pos_ = end_;
+  } else {
+    line_end = newline;
+    pos_ = newline + 1;
+  }
+
+  if (line_end > line_begin && *(line_end - 1) == '\r') {
+    line_end--;
+  }
+
+  line_number_++;
+  return true;
+}
+
+void TrimRange(const char *&begin, const char *&end) {
+  while (begin < end && (*begin == ' ' || *begin == '\t')) {
+    begin++;
+  }
+  while (end > begin && (*(end - 1) == ' ' || *(end - 1) == '\t')) {
+    end--;
+  }
+}
@@ -0,0 +1,56 @@
+/*
+ * MappedFile.h
+ *
+ * Read-only memory mapping of an input file, used by the readers
+ * to parse their inputs in place.  Inputs that can't be mapped, stdin ("-"),
+ * pipes and compressed files (.gz, .zst), are read into memory instead.
+ */
+
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+#include <cstddef>
+#include <string>
+
+#include "CompressedStream.h"
+
+class MappedFile {
+ public:
+  MappedFile(const std::string &filename);
+  ~MappedFile();
+
+  MappedFile(MappedFile const &) = delete;
+  void operator=(MappedFile const &) = delete;
+
+  const char *begin() const { return data_; }
+  const char *end() const { return data_ + size_; }
+  size_t size() const { return size_; }
+
+ private:
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+  void *mapping_ = nullptr;
+  std::string buffer_;
+
+  void Load(int fd, const std::string &filename);
+  void LoadCompressed(const std::string &filename, Compression compression);
+};
+
+// Cursor over the lines of a buffer.  Line terminators (\n or \r\n) are not part
+// of the returned range.
+class LineCursor {
+ public:
+  LineCursor(const char *begin, const char *end);
+  bool NextLine(const char *&line_begin, const char *&line_end);
+  size_t LineNumber() const { return line_number_; }
+
+ private:
+  const char *pos_;
+  const char *end_;
+  size_t line_number_ = 0;
+};
+
+// trims spaces and tabs from both ends of [begin, end)
+void TrimRange(const char *&begin, const char *&end);
+
+#endif  // __MAPPED_FILE_H__
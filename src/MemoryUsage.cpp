@@ -0,0 +1,111 @@
+/*
+ * MemoryUsage.cpp
+ */
+
+#include "MemoryUsage.h"
+
+#include "fstalign.h"
+
+namespace {
+
+int64_t ApproxBytes(const std::vector<std::string> &strings) {
+  int64_t bytes = strings.capacity() * sizeof(std::string);
+  for (auto &s : strings) {
+    bytes += ApproxHeapBytes(s);
+  }
+  return bytes;
+}
+
+template <typename T>
+int64_t ApproxPairsBytes(const std::vector<std::pair<std::string, T>> &pairs) {
+  int64_t bytes = pairs.capacity() * sizeof(std::pair<std::string, T>);
+  for (auto &pair : pairs) {
+    bytes += ApproxHeapBytes(pair.first);
+  }
+  return bytes;
+}
+
+int64_t ApproxBytes(const std::vector<std::pair<std::string, std::string>> &pairs) {
+  int64_t bytes = ApproxPairsBytes(pairs);
+  for (auto &pair : pairs) {
+    bytes += ApproxHeapBytes(pair.second);
+  }
+  return bytes;
+}
+
+int64_t ApproxBytes(const bigrams &counts) {
+  // a bucket pointer and a node per entry
+  int64_t bytes = counts.bucket_count() * sizeof(void *);
+  for (auto &entry : counts) {
+    bytes += sizeof(void *) + sizeof(entry) + sizeof(size_t) + kAllocationOverhead + ApproxHeapBytes(entry.first);
+  }
+  return bytes;
+}
+
+int64_t ApproxBytes(const RawNlpRecord &row) {
+  int64_t bytes = row.wer_tags.capacity() * sizeof(WerTagEntry);
+  for (auto &tag : row.wer_tags) {
+    bytes += ApproxHeapBytes(tag.tag_id) + ApproxHeapBytes(tag.entity_type);
+  }
+  for (auto *s : {&row.token, &row.speakerId, &row.punctuation, &row.prepunctuation, &row.ts, &row.endTs,
+                  &row.casing, &row.labels, &row.best_label, &row.best_label_id, &row.confidence}) {
+    bytes += ApproxHeapBytes(*s);
+  }
+  return bytes;
+}
+
+}  // namespace
+
+int64_t ApproxHeapBytes(const std::string &s) {
+  // libstdc++ keeps up to 15 characters in the string itself
+  return s.capacity() > 15 ? s.capacity() + 1 + kAllocationOverhead : 0;
+}
+
+int64_t ApproxBytes(const std::vector<int> &ids) {
+  return ids.capacity() > 0 ? ids.capacity() * sizeof(int) + kAllocationOverhead : 0;
+}
+
+int64_t ApproxBytes(const fst::SymbolTable &symbols) {
+  // each symbol is a character array, its pointer in the key order and a slot of the hash of its string
+  int64_t bytes = 0;
+  for (fst::SymbolTableIterator it(symbols); !it.Done(); it.Next()) {
+    bytes += it.Symbol().size() + 1 + kAllocationOverhead + 3 * sizeof(int64_t);
+  }
+  return bytes;
+}
+
+int64_t ApproxBytes(const fst::StdVectorFst &fst) {
+  // each state is allocated on its own, pointed at by the state vector, with its vector of arcs
+  int64_t bytes = 0;
+  for (fst::StdVectorFst::StateId s = 0; s < fst.NumStates(); s++) {
+    bytes += sizeof(void *) + sizeof(fst::VectorState<fst::StdArc>) + kAllocationOverhead;
+    auto num_arcs = fst.NumArcs(s);
+    if (num_arcs > 0) {
+      bytes += num_arcs * sizeof(fst::StdArc) + kAllocationOverhead;
+    }
+  }
+  return bytes;
+}
+
+int64_t ApproxBytes(const wer_alignment &alignment) {
+  int64_t bytes = ApproxHeapBytes(alignment.classLabel);
+  bytes += ApproxBytes(alignment.ref_words) + ApproxBytes(alignment.hyp_words);
+  bytes += ApproxBytes(alignment.del_words) + ApproxBytes(alignment.ins_words) + ApproxBytes(alignment.sub_words);
+  bytes += ApproxPairsBytes(alignment.unigram_stats) + ApproxPairsBytes(alignment.bigrams_stats);
+  bytes += ApproxBytes(alignment.ref_bigrams) + ApproxBytes(alignment.hyp_bigrams);
+  bytes += ApproxBytes(alignment.bigram_tokens) + ApproxBytes(alignment.tokens);
+  bytes += alignment.label_alignments.capacity() * sizeof(wer_alignment);
+  for (auto &label_alignment : alignment.label_alignments) {
+    bytes += ApproxBytes(label_alignment);
+  }
+  return bytes;
+}
+
+int64_t ApproxBytes(const std::vector<Stitching> &stitches) {
+  int64_t bytes = stitches.capacity() * sizeof(Stitching);
+  for (auto &stitch : stitches) {
+    bytes += ApproxHeapBytes(stitch.reftk) + ApproxHeapBytes(stitch.hyptk) + ApproxHeapBytes(stitch.classLabel) +
+             ApproxHeapBytes(stitch.hyp_orig) + ApproxHeapBytes(stitch.comment) + ApproxBytes(stitch.nlpRow);
+  }
+  return bytes;
+}
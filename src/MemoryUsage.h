@@ -0,0 +1,40 @@
+/*
+ * MemoryUsage.h
+ *
+ * Approximate bytes held by the data structures of an alignment, for the memory
+ * peaks of the perf section and --memory-limit.  They count the payloads and the
+ * allocations of the containers as libstdc++ lays them out, not the allocator's
+ * own bookkeeping, so they are estimates to compare the subsystems with each
+ * other rather than the exact resident size of the process.
+ */
+
+#ifndef __MEMORY_USAGE_H__
+#define __MEMORY_USAGE_H__
+
+#include <cstdint>
+
+#include "utilities.h"
+
+struct Stitching;
+
+// what a heap allocation costs besides its payload
+const int64_t kAllocationOverhead = 16;
+
+// a node of a std::map or std::set holding a value of value_size bytes
+inline int64_t ApproxTreeNodeBytes(size_t value_size) { return 32 + value_size + kAllocationOverhead; }
+
+// an object allocated by std::make_shared, with its control block
+inline int64_t ApproxSharedBytes(size_t object_size) { return 16 + object_size + kAllocationOverhead; }
+
+// the characters of a string too long for its inline buffer
+int64_t ApproxHeapBytes(const std::string &s);
+
+// e.g. token ids or the levenshtein maps
+int64_t ApproxBytes(const std::vector<int> &ids);
+int64_t ApproxBytes(const fst::SymbolTable &symbols);
+int64_t ApproxBytes(const fst::StdVectorFst &fst);
+// the words, tokens and n-gram stats of the alignment and of its class labels
+int64_t ApproxBytes(const wer_alignment &alignment);
+int64_t ApproxBytes(const std::vector<Stitching> &stitches);
+
+#endif  // __MEMORY_USAGE_H__
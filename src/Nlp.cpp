@@ -6,27 +6,35 @@
  */
 #include "Nlp.h"
 
+#include <algorithm>
 #include <cstddef>
+#include <cstring>
 #include <fstream>
+#include <stdexcept>
 
-#include <csv/csv.h>
+#include "CompiledReference.h"
 #include "utilities.h"
 
 /***********************************
    NLP FstLoader class start
  ************************************/
-NlpFstLoader::NlpFstLoader(std::vector<RawNlpRecord> &records, Json::Value normalization, Json::Value wer_sidecar)
-    : NlpFstLoader(records, normalization, wer_sidecar, true) {}
+NlpFstLoader::NlpFstLoader(std::vector<RawNlpRecord> records, Json::Value normalization, Json::Value wer_sidecar)
+    : NlpFstLoader(std::move(records), std::move(normalization), std::move(wer_sidecar), true) {}
 
-NlpFstLoader::NlpFstLoader(std::vector<RawNlpRecord> &records, Json::Value normalization, Json::Value wer_sidecar,
+NlpFstLoader::NlpFstLoader(std::vector<RawNlpRecord> records, Json::Value normalization, Json::Value wer_sidecar,
                            bool processLabels, bool use_punctuation, bool use_case)
     : FstLoader() {
-  mJsonNorm = normalization;
-  mWerSidecar = wer_sidecar;
+  mJsonNorm = std::move(normalization);
+  mWerSidecar = std::move(wer_sidecar);
   mUseCase = use_case;
 
+  mNlpRows.reserve(records.size());
+  mToken.reserve(records.size());
+  mSpeakers.reserve(records.size());
+
   std::string last_label;
   bool firstTk = true;
+  CaseFolder folder;
 
   // fuse multiple rows that have the same id/label into one entry only
   for (auto &row : records) {
@@ -34,17 +42,16 @@ NlpFstLoader::NlpFstLoader(std::vector<RawNlpRecord> &records, Json::Value norma
     auto curr_label = row.best_label;
     auto curr_label_id = row.best_label_id;
     auto punctuation = row.punctuation;
-    auto curr_row_tags = row.wer_tags;
 
     // Update wer tags in records to real string labels
-    for (auto &tag : curr_row_tags) {
+    for (auto &tag : row.wer_tags) {
       if (mWerSidecar != Json::nullValue) {
         tag.entity_type = mWerSidecar[tag.tag_id]["entity_type"].asString();
       }
     }
-    row.wer_tags = curr_row_tags;
     std::string speaker = row.speakerId;
-    mNlpRows.push_back(row);
+    // the fields we still need were copied above
+    mNlpRows.push_back(std::move(row));
 
     if (processLabels && curr_label != "") {
       if (firstTk || curr_label != last_label) {
@@ -80,7 +87,7 @@ NlpFstLoader::NlpFstLoader(std::vector<RawNlpRecord> &records, Json::Value norma
       }
     } else {
       if (!mUseCase) {
-        curr_tk = UnicodeLowercase(curr_tk);
+        curr_tk = folder.Lowercase(curr_tk);
       }
       mToken.push_back(curr_tk);
       mSpeakers.push_back(speaker);
@@ -97,31 +104,46 @@ NlpFstLoader::NlpFstLoader(std::vector<RawNlpRecord> &records, Json::Value norma
     firstTk = false;
     last_label = curr_label;
   }
+
+  // the candidates are matched against lowercased tokens, they're folded once here
+  if (!mUseCase && mJsonNorm.isObject()) {
+    for (auto &norm : mJsonNorm) {
+      if (!norm.isObject() || !norm.isMember("candidates")) {
+        continue;
+      }
+      for (auto &candidate : norm["candidates"]) {
+        for (auto &tk : candidate["verbalization"]) {
+          tk = folder.Lowercase(tk.asString());
+        }
+      }
+    }
+  }
 }
 
-void NlpFstLoader::addToSymbolTable(fst::SymbolTable &symbol) const {
+std::vector<int> NlpFstLoader::convertToIntVector(SymbolInterner &vocab) const {
   auto logger = logger::GetOrCreateLogger("NlpFstLoader");
-  logger->info("addToSymbolTable() Building the FST from raw tokens");
+  std::vector<int> vect;
+  logger->info("convertToIntVector() Building a std::vector<int> from NLP rows");
+  int sz = mToken.size();
+  vect.reserve(sz);
 
-  for (auto tk : mToken) {
+  FstAlignOption options;
+  for (auto &tk : mToken) {
     if (isEntityLabel(tk)) {
       // this token is a class, let's put the extra vocab
       // we also at it as is so that we have a way to find our way back to here
-      AddSymbolIfNeeded(symbol, tk);
+      vect.emplace_back(vocab.Intern(tk));
       std::string label_id = getLabelIdFromToken(tk);
 
       if (mJsonNorm != Json::nullValue) {
-        auto candidates = mJsonNorm[label_id]["candidates"];
+        auto &candidates = mJsonNorm[label_id]["candidates"];
         logger->trace("for tk [{}] we have label_id [{}] and {} candidates", tk, label_id, candidates.size());
         for (Json::Value::ArrayIndex i = 0; i != candidates.size(); i++) {
           //
-          auto candidate = candidates[i]["verbalization"];
-          for (auto tk_itr : candidate) {
-            std::string token = tk_itr.asString();
-            if (!mUseCase) {
-              token = UnicodeLowercase(token);
-            }
-            AddSymbolIfNeeded(symbol, token);
+          auto &candidate = candidates[i]["verbalization"];
+          for (auto &tk_itr : candidate) {
+            // folded by the constructor
+            vocab.Intern(tk_itr.asString());
           }
         }
       }
@@ -130,42 +152,29 @@ void NlpFstLoader::addToSymbolTable(fst::SymbolTable &symbol) const {
       // or the awful : <{note}>....
       auto colon_pos = tk.find(":");
       if (colon_pos == string::npos) {
-        AddSymbolIfNeeded(symbol, tk);
+        vect.emplace_back(vocab.Intern(tk));
       } else {
         auto effective_tk = tk.substr(0, colon_pos) + ">";
         logger->info("trimming noisecode from [{}] to [{}]", tk, effective_tk);
-        AddSymbolIfNeeded(symbol, effective_tk);
+        vocab.Intern(effective_tk);
+        // the untrimmed token itself isn't part of the vocabulary
+        int token_sym = vocab.Find(tk);
+        if (token_sym == -1) {
+          token_sym = vocab.Find(options.symUnk);
+        }
+        vect.emplace_back(token_sym);
       }
     } else {
       // mToken content is already lowercased
-      AddSymbolIfNeeded(symbol, tk);
+      vect.emplace_back(vocab.Intern(tk));
     }
   }
-}
-
-std::vector<int> NlpFstLoader::convertToIntVector(fst::SymbolTable &symbol) const {
-  auto logger = logger::GetOrCreateLogger("NlpFstLoader");
-  std::vector<int> vect;
-  logger->info("convertToIntVector() Building a std::vector<int> from NLP rows");
-  addToSymbolTable(symbol);
-  int sz = mToken.size();
-  vect.reserve(sz);
-
-  FstAlignOption options;
-  for (TokenType::const_iterator i = mToken.begin(); i != mToken.end(); ++i) {
-    std::string token = *i;
-    int token_sym = symbol.Find(token);
-    if (token_sym == -1) {
-      token_sym = symbol.Find(options.symUnk);
-    }
-    vect.emplace_back(token_sym);
-  }
 
   return vect;
-  // return std::move(vect);
 }
 
-fst::StdVectorFst NlpFstLoader::convertToFst(const fst::SymbolTable &symbol, std::vector<int> map) const {
+fst::StdVectorFst NlpFstLoader::convertToFst(const SymbolInterner &vocab, const std::vector<int> &token_ids,
+                                             const std::vector<int> &map, std::vector<int> *token_states) const {
   auto logger = logger::GetOrCreateLogger("NlpFstLoader");
   fst::StdVectorFst transducer;
 
@@ -174,7 +183,7 @@ fst::StdVectorFst NlpFstLoader::convertToFst(const fst::SymbolTable &symbol, std
   FstAlignOption options;
 
   bool markLabels = true;
-  int eps_sym = symbol.Find(options.symEps);
+  int eps_sym = vocab.Find(options.symEps);
   // a 'real' eps transition?
   //   int eps_sym = fst::kNoLabel;
 
@@ -195,12 +204,12 @@ fst::StdVectorFst NlpFstLoader::convertToFst(const fst::SymbolTable &symbol, std
   for (TokenType::const_iterator i = mToken.begin(); i != mToken.end(); ++i) {
     transducer.AddState();
 
-    std::string token = *i;
-    int token_sym = symbol.Find(token);
-    if (token_sym == -1) {
-      token_sym = symbol.Find(options.symUnk);
-    }
+    const std::string &token = *i;
+    int token_sym = token_ids[wc];
 
+    if (token_states) {
+      token_states->push_back(prevState);
+    }
     // logger->info("wc {}, token {}, map[wc] = {}, map_sz = {}", wc, token, map[wc], map_sz);
     if (map_sz > wc && map[wc] > 0) {
       transducer.AddArc(prevState, fst::StdArc(token_sym, token_sym, 1.0f, nextState));
@@ -245,22 +254,19 @@ so we add 2 states
       }
 
       auto label_id = getLabelIdFromToken(token);
-      auto candidates = mJsonNorm[label_id]["candidates"];
+      auto &candidates = mJsonNorm[label_id]["candidates"];
       for (Json::Value::ArrayIndex i = 0; i != candidates.size(); i++) {
         //
         prevState = classPrevState;
-        auto candidate = candidates[i]["verbalization"];
-        for (auto tk_itr : candidate) {
-          std::string ltoken = std::string(tk_itr.asString());
-          if (!mUseCase) {
-            ltoken = UnicodeLowercase(ltoken);
-          }
+        auto &candidate = candidates[i]["verbalization"];
+        for (auto &tk_itr : candidate) {
+          std::string ltoken = tk_itr.asString();
           transducer.AddState();
           nextState++;
 
-          int token_sym = symbol.Find(ltoken);
+          int token_sym = vocab.Find(ltoken);
           if (token_sym == -1) {
-            token_sym = symbol.Find(options.symUnk);
+            token_sym = vocab.Find(options.symUnk);
           }
 
           transducer.AddArc(prevState, fst::StdArc(token_sym, token_sym, 0.0f, nextState));
@@ -315,6 +321,93 @@ int NlpFstLoader::GetProperSymbolId(const fst::SymbolTable &symbol, string token
   return token_sym;
 }
 
+static void WriteNlpRecord(BundleWriter &writer, const RawNlpRecord &record) {
+  writer.WriteString(record.token);
+  writer.WriteString(record.speakerId);
+  writer.WriteString(record.punctuation);
+  writer.WriteString(record.prepunctuation);
+  writer.WriteString(record.ts);
+  writer.WriteString(record.endTs);
+  writer.WriteString(record.casing);
+  writer.WriteString(record.labels);
+  writer.WriteString(record.best_label);
+  writer.WriteString(record.best_label_id);
+  writer.WriteUInt32(record.wer_tags.size());
+  for (auto &tag : record.wer_tags) {
+    writer.WriteString(tag.tag_id);
+    writer.WriteString(tag.entity_type);
+  }
+  writer.WriteString(record.confidence);
+}
+
+static void ReadNlpRecord(BundleReader &reader, RawNlpRecord &record) {
+  record.token = reader.ReadString();
+  record.speakerId = reader.ReadString();
+  record.punctuation = reader.ReadString();
+  record.prepunctuation = reader.ReadString();
+  record.ts = reader.ReadString();
+  record.endTs = reader.ReadString();
+  record.casing = reader.ReadString();
+  record.labels = reader.ReadString();
+  record.best_label = reader.ReadString();
+  record.best_label_id = reader.ReadString();
+  record.wer_tags.resize(reader.ReadUInt32());
+  for (auto &tag : record.wer_tags) {
+    tag.tag_id = reader.ReadString();
+    tag.entity_type = reader.ReadString();
+  }
+  record.confidence = reader.ReadString();
+}
+
+static std::string JsonToString(const Json::Value &value) {
+  Json::StreamWriterBuilder builder;
+  builder["indentation"] = "";
+  return Json::writeString(builder, value);
+}
+
+static Json::Value JsonFromString(const std::string &content) {
+  Json::Value value;
+  if (content == "null") {
+    return value;
+  }
+
+  Json::CharReaderBuilder builder;
+  JSONCPP_STRING errs;
+  std::istringstream ss(content);
+  if (!Json::parseFromStream(builder, ss, &value, &errs)) {
+    throw std::runtime_error("invalid json in the compiled reference: " + errs);
+  }
+  return value;
+}
+
+void NlpFstLoader::WriteCompiled(BundleWriter &writer) const {
+  writer.WriteString("nlp");
+  writer.WriteBool(mUseCase);
+  writer.WriteStrings(mToken);
+  writer.WriteStrings(mSpeakers);
+  writer.WriteString(JsonToString(mJsonNorm));
+  writer.WriteString(JsonToString(mWerSidecar));
+  writer.WriteUInt32(mNlpRows.size());
+  for (auto &row : mNlpRows) {
+    WriteNlpRecord(writer, row);
+  }
+}
+
+std::unique_ptr<NlpFstLoader> NlpFstLoader::ReadCompiled(BundleReader &reader) {
+  bool use_case = reader.ReadBool();
+  auto loader = std::make_unique<NlpFstLoader>(vector<RawNlpRecord>(), Json::Value(), Json::Value(), true, false,
+                                               use_case);
+  loader->mToken = reader.ReadStrings();
+  loader->mSpeakers = reader.ReadStrings();
+  loader->mJsonNorm = JsonFromString(reader.ReadString());
+  loader->mWerSidecar = JsonFromString(reader.ReadString());
+  loader->mNlpRows.resize(reader.ReadUInt32());
+  for (auto &row : loader->mNlpRows) {
+    ReadNlpRecord(reader, row);
+  }
+  return loader;
+}
+
 NlpFstLoader::~NlpFstLoader() {
   // TODO Auto-generated destructor stub
 }
@@ -334,37 +427,13 @@ NlpReader::~NlpReader() {
 }
 
 std::vector<RawNlpRecord> NlpReader::read_from_disk(const std::string &filename) {
+  NlpRecordStream stream(filename);
   std::vector<RawNlpRecord> vect;
-  io::CSVReader<13, io::trim_chars<' ', '\t'>, io::no_quote_escape<'|'>> input_nlp(filename);
-  // token|speaker|ts|endTs|punctuation|prepunctuation|case|tags|wer_tags|ali_comment|oldTs|oldEndTs
-  input_nlp.read_header(io::ignore_missing_column | io::ignore_extra_column, "token", "speaker", "ts", "endTs",
-                        "punctuation", "prepunctuation", "case", "tags", "wer_tags", "ali_comment", "oldTs", "oldEndTs",
-                        "confidence");
-
-  std::string token, speaker, ts, endTs, punctuation, prepunctuation, casing, tags, wer_tags, ali_comment, oldTs,
-      oldEndTs, confidence;
-  while (input_nlp.read_row(token, speaker, ts, endTs, punctuation, prepunctuation, casing, tags, wer_tags, ali_comment,
-                            oldTs, oldEndTs, confidence)) {
-    RawNlpRecord record;
-    record.speakerId = speaker;
-    record.casing = casing;
-    record.punctuation = punctuation;
-    if (input_nlp.has_column("prepunctuation")) {
-      record.prepunctuation = prepunctuation;
-    }
-    record.ts = ts;
-    record.endTs = endTs;
-    record.best_label = GetBestLabel(tags);
-    record.best_label_id = GetLabelId(record.best_label);
-    record.labels = tags;
-    record.token = token;
-    if (input_nlp.has_column("wer_tags")) {
-      record.wer_tags = GetWerTags(wer_tags);
-    }
-    if (input_nlp.has_column("confidence")) {
-      record.confidence = confidence;
-    }
-    vect.push_back(record);
+  vect.reserve(stream.EstimatedRows());
+
+  RawNlpRecord record;
+  while (stream.Next(record)) {
+    vect.push_back(std::move(record));
   }
 
   return vect;
@@ -431,3 +500,113 @@ std::vector<WerTagEntry> NlpReader::GetWerTags(std::string &wer_tags_str) {
 
 /*********************************** NLP Reader Class End
  * ***********************************/
+
+/***********************************
+NLP Record Stream class start
+ * ***********************************/
+NlpRecordStream::NlpRecordStream(const std::string &filename)
+    : filename_(filename), file_(filename), cursor_(file_.begin(), file_.end()) {
+  // token|speaker|ts|endTs|punctuation|prepunctuation|case|tags|wer_tags|ali_comment|oldTs|oldEndTs|confidence
+  static const char *column_names[NUM_NLP_COLUMNS] = {
+      "token", "speaker",  "ts",          "endTs", "punctuation", "prepunctuation", "case",
+      "tags",  "wer_tags", "ali_comment", "oldTs", "oldEndTs",    "confidence"};
+  std::fill(column_position_, column_position_ + NUM_NLP_COLUMNS, -1);
+
+  const char *line_begin, *line_end;
+  if (!cursor_.NextLine(line_begin, line_end)) {
+    throw std::runtime_error("Missing header in NLP file " + filename);
+  }
+
+  // extra columns are ignored, missing columns are left empty
+  SplitFields(line_begin, line_end);
+  num_columns_ = fields_.size();
+  for (int pos = 0; pos < num_columns_; pos++) {
+    std::string name(fields_[pos].first, fields_[pos].second);
+    for (int c = 0; c < NUM_NLP_COLUMNS; c++) {
+      if (name == column_names[c]) {
+        column_position_[c] = pos;
+        break;
+      }
+    }
+  }
+}
+
+void NlpRecordStream::SplitFields(const char *line_begin, const char *line_end) {
+  fields_.clear();
+  const char *field_begin = line_begin;
+  while (true) {
+    auto sep = static_cast<const char *>(memchr(field_begin, '|', line_end - field_begin));
+    const char *field_end = sep == nullptr ? line_end : sep;
+    const char *b = field_begin;
+    const char *e = field_end;
+    TrimRange(b, e);
+    fields_.emplace_back(b, e);
+    if (sep == nullptr) {
+      break;
+    }
+    field_begin = sep + 1;
+  }
+}
+
+void NlpRecordStream::AssignColumn(NlpColumn column, std::string &value) const {
+  int pos = column_position_[column];
+  if (pos < 0) {
+    value.clear();
+  } else {
+    value.assign(fields_[pos].first, fields_[pos].second);
+  }
+}
+
+size_t NlpRecordStream::EstimatedRows() const {
+  // extrapolated from the lines of the first bytes, the whole file isn't scanned twice
+  const size_t kSampleBytes = 64 * 1024;
+  size_t sample = std::min(file_.size(), kSampleBytes);
+  size_t lines = std::count(file_.begin(), file_.begin() + sample, '\n') + 1;
+  if (sample == file_.size()) {
+    return lines;
+  }
+  return static_cast<size_t>(static_cast<double>(lines) * file_.size() / sample);
+}
+
+bool NlpRecordStream::Next(RawNlpRecord &record) {
+  const char *line_begin, *line_end;
+  while (cursor_.NextLine(line_begin, line_end)) {
+    if (line_begin == line_end) {
+      // skipping empty lines
+      continue;
+    }
+
+    SplitFields(line_begin, line_end);
+    if (fields_.size() != num_columns_) {
+      throw std::runtime_error("line " + std::to_string(cursor_.LineNumber()) + " of " + filename_ + " has " +
+                               std::to_string(fields_.size()) + " columns, " + std::to_string(num_columns_) +
+                               " expected");
+    }
+
+    AssignColumn(COL_TOKEN, record.token);
+    AssignColumn(COL_SPEAKER, record.speakerId);
+    AssignColumn(COL_TS, record.ts);
+    AssignColumn(COL_END_TS, record.endTs);
+    AssignColumn(COL_PUNCTUATION, record.punctuation);
+    AssignColumn(COL_PREPUNCTUATION, record.prepunctuation);
+    AssignColumn(COL_CASE, record.casing);
+    AssignColumn(COL_TAGS, record.labels);
+    AssignColumn(COL_CONFIDENCE, record.confidence);
+
+    record.best_label = reader_.GetBestLabel(record.labels);
+    record.best_label_id = reader_.GetLabelId(record.best_label);
+
+    record.wer_tags.clear();
+    if (column_position_[COL_WER_TAGS] >= 0) {
+      std::string wer_tags(fields_[column_position_[COL_WER_TAGS]].first,
+                           fields_[column_position_[COL_WER_TAGS]].second);
+      record.wer_tags = reader_.GetWerTags(wer_tags);
+    }
+    return true;
+  }
+
+  return false;
+}
+
+/*********************************** NLP Record Stream Class End
+ * ***********************************/
@@ -12,6 +12,7 @@
 #include <json/json.h>
 
 #include "FstLoader.h"
+#include "MappedFile.h"
 
 using namespace std;
 using namespace fst;
@@ -46,14 +47,59 @@ class NlpReader {
   string GetLabelId(std::string &label);
 };
 
+// Streams the rows of an NLP file, parsing them in place from a memory mapping
+// instead of going through per-column temporaries.
+class NlpRecordStream {
+ public:
+  NlpRecordStream(const std::string &filename);
+  // fills record with the next row, returns false once the file is exhausted
+  bool Next(RawNlpRecord &record);
+  // number of rows of the file, estimated from its first lines, useful to reserve()
+  size_t EstimatedRows() const;
+
+ private:
+  enum NlpColumn {
+    COL_TOKEN,
+    COL_SPEAKER,
+    COL_TS,
+    COL_END_TS,
+    COL_PUNCTUATION,
+    COL_PREPUNCTUATION,
+    COL_CASE,
+    COL_TAGS,
+    COL_WER_TAGS,
+    COL_ALI_COMMENT,
+    COL_OLD_TS,
+    COL_OLD_END_TS,
+    COL_CONFIDENCE,
+    NUM_NLP_COLUMNS
+  };
+
+  void SplitFields(const char *line_begin, const char *line_end);
+  void AssignColumn(NlpColumn column, std::string &value) const;
+
+  std::string filename_;
+  MappedFile file_;
+  LineCursor cursor_;
+  // for each known column, its position in the file, or -1 if absent
+  int column_position_[NUM_NLP_COLUMNS];
+  size_t num_columns_ = 0;
+  vector<pair<const char *, const char *>> fields_;
+  NlpReader reader_;
+};
+
 class NlpFstLoader : public FstLoader {
  public:
-  NlpFstLoader(std::vector<RawNlpRecord> &records, Json::Value normalization, Json::Value wer_sidecar, bool processLabels, bool use_punctuation = false, bool use_case = false);
-  NlpFstLoader(std::vector<RawNlpRecord> &records, Json::Value normalization, Json::Value wer_sidecar);
+  // records and json documents are sinks, std::move() them in when they aren't needed anymore
+  NlpFstLoader(std::vector<RawNlpRecord> records, Json::Value normalization, Json::Value wer_sidecar, bool processLabels, bool use_punctuation = false, bool use_case = false);
+  NlpFstLoader(std::vector<RawNlpRecord> records, Json::Value normalization, Json::Value wer_sidecar);
   virtual ~NlpFstLoader();
-  virtual void addToSymbolTable(fst::SymbolTable &symbol) const;
-  virtual fst::StdVectorFst convertToFst(const fst::SymbolTable &symbol, std::vector<int> map) const;
-  virtual std::vector<int> convertToIntVector(fst::SymbolTable &symbol) const;
+  virtual std::vector<int> convertToIntVector(SymbolInterner &vocab) const;
+  virtual fst::StdVectorFst convertToFst(const SymbolInterner &vocab, const std::vector<int> &token_ids,
+                                         const std::vector<int> &map,
+                                         std::vector<int> *token_states = nullptr) const;
+  virtual void WriteCompiled(BundleWriter &writer) const;
+  static std::unique_ptr<NlpFstLoader> ReadCompiled(BundleReader &reader);
 
   int GetProperSymbolId(const fst::SymbolTable &symbol, string token, string symUnk) const;
   vector<RawNlpRecord> mNlpRows;
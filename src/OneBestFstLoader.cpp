@@ -9,6 +9,7 @@
 #include <fstream>
 #include <stdexcept>
 
+#include "CompiledReference.h"
 #include "utilities.h"
 
 // empty constructor
@@ -20,37 +21,55 @@ void OneBestFstLoader::BuildFromString(const std::string content) {
   std::istringstream mystream(content);
   std::copy(std::istream_iterator<std::string>(mystream), std::istream_iterator<std::string>(),
             std::back_inserter(mToken));
+  FoldTokens();
 }
 
-void OneBestFstLoader::LoadTextFile(const std::string filename) {
-  std::ifstream stream(filename);
-
-  if (!stream.is_open()) throw std::runtime_error("Cannot open input file");
+void OneBestFstLoader::LoadTokens(std::vector<std::string> tokens) {
+  mToken.insert(mToken.end(), std::make_move_iterator(tokens.begin()), std::make_move_iterator(tokens.end()));
+  FoldTokens();
+}
 
-  std::copy(std::istream_iterator<std::string>(stream), std::istream_iterator<std::string>(),
+void OneBestFstLoader::LoadTextFile(const std::string filename) {
+  auto stream = OpenInput(filename);
+  std::copy(std::istream_iterator<std::string>(*stream), std::istream_iterator<std::string>(),
             std::back_inserter(mToken));
+  FoldTokens();
+}
+
+// mToken keeps the original spelling for the outputs, the aligned tokens are lowercased once here
+void OneBestFstLoader::FoldTokens() {
+  mFoldedToken.clear();
+  if (mUseCase) {
+    return;
+  }
 
-  stream.close();
+  CaseFolder folder;
+  mFoldedToken.reserve(mToken.size());
+  for (auto &token : mToken) {
+    mFoldedToken.push_back(folder.Lowercase(token));
+  }
 }
 
-void OneBestFstLoader::addToSymbolTable(fst::SymbolTable &symbol) const {
-  for (TokenType::const_iterator i = mToken.begin(); i != mToken.end(); ++i) {
-    std::string token = *i;
-    if (!mUseCase) {
-      token = UnicodeLowercase(token);
-    }
-    // fst::kNoSymbol
-    if (symbol.Find(token) == -1) {
-      symbol.AddSymbol(token);
-    }
+std::vector<int> OneBestFstLoader::convertToIntVector(SymbolInterner &vocab) const {
+  auto logger = logger::GetOrCreateLogger("OneBestFstLoader");
+  std::vector<int> vect;
+  int sz = mToken.size();
+  logger->info("creating std::vector<int> for OneBestFstLoader for {} tokens", sz);
+  vect.reserve(sz);
+
+  for (auto &token : mUseCase ? mToken : mFoldedToken) {
+    vect.emplace_back(vocab.Intern(token));
   }
+
+  return vect;
 }
 
-fst::StdVectorFst OneBestFstLoader::convertToFst(const fst::SymbolTable &symbol, std::vector<int> map) const {
+fst::StdVectorFst OneBestFstLoader::convertToFst(const SymbolInterner &vocab, const std::vector<int> &token_ids,
+                                                 const std::vector<int> &map, std::vector<int> *token_states) const {
   auto logger = logger::GetOrCreateLogger("OneBestFstLoader");
 
   FstAlignOption options;
-  int eps_sym = symbol.Find(options.symEps);
+  int eps_sym = vocab.Find(options.symEps);
 
   fst::StdVectorFst transducer;
 
@@ -61,17 +80,14 @@ fst::StdVectorFst OneBestFstLoader::convertToFst(const fst::SymbolTable &symbol,
   int nextState = 1;
   int map_sz = map.size();
   int wc = 0;
-  for (TokenType::const_iterator i = mToken.begin(); i != mToken.end(); ++i) {
-    std::string token = *i;
-    if (!mUseCase) {
-      token = UnicodeLowercase(token);
-    }
+  for (int tk_idx : token_ids) {
     transducer.AddState();
 
-    int tk_idx = symbol.Find(token);
+    if (token_states) {
+      token_states->push_back(prevState);
+    }
     if (tk_idx < 0) {
-      logger->trace("we found an invalid token [{}] at token position {} which gave a label id of {}", token, (wc + 1),
-                    tk_idx);
+      logger->trace("we found an invalid token at token position {} which gave a label id of {}", (wc + 1), tk_idx);
     }
     if (map_sz > wc && map[wc] > 0) {
       transducer.AddArc(prevState, fst::StdArc(tk_idx, tk_idx, 1.0f, nextState));
@@ -90,28 +106,18 @@ fst::StdVectorFst OneBestFstLoader::convertToFst(const fst::SymbolTable &symbol,
   return transducer;
 }
 
-std::vector<int> OneBestFstLoader::convertToIntVector(fst::SymbolTable &symbol) const {
-  auto logger = logger::GetOrCreateLogger("OneBestFstLoader");
-  std::vector<int> vect;
-  addToSymbolTable(symbol);
-  int sz = mToken.size();
-  logger->info("creating std::vector<int> for OneBestFstLoader for {} tokens", sz);
-  vect.reserve(sz);
-
-  FstAlignOption options;
-  for (TokenType::const_iterator i = mToken.begin(); i != mToken.end(); ++i) {
-    std::string token = *i;
-    if (!mUseCase) {
-      token = UnicodeLowercase(token);
-    }
-    int token_sym = symbol.Find(token);
-    if (token_sym == -1) {
-      token_sym = symbol.Find(options.symUnk);
-    }
-    vect.emplace_back(token_sym);
-  }
+void OneBestFstLoader::WriteCompiled(BundleWriter &writer) const {
+  writer.WriteString("text");
+  writer.WriteBool(mUseCase);
+  writer.WriteStrings(mToken);
+  writer.WriteStrings(mFoldedToken);
+}
 
-  return vect;
+std::unique_ptr<OneBestFstLoader> OneBestFstLoader::ReadCompiled(BundleReader &reader) {
+  auto loader = std::make_unique<OneBestFstLoader>(reader.ReadBool());
+  loader->mToken = reader.ReadStrings();
+  loader->mFoldedToken = reader.ReadStrings();
+  return loader;
 }
 
 OneBestFstLoader::~OneBestFstLoader() {
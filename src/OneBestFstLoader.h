@@ -15,14 +15,23 @@ class OneBestFstLoader : public FstLoader {
   virtual ~OneBestFstLoader();
   void LoadTextFile(const std::string filename);
   void BuildFromString(const std::string content);
+  // tokens are a sink, std::move() them in when they aren't needed anymore
+  void LoadTokens(std::vector<std::string> tokens);
 
-  virtual void addToSymbolTable(fst::SymbolTable &symbol) const;
-  virtual fst::StdVectorFst convertToFst(const fst::SymbolTable &symbol, std::vector<int> map) const;
+  virtual std::vector<int> convertToIntVector(SymbolInterner &vocab) const;
+  virtual fst::StdVectorFst convertToFst(const SymbolInterner &vocab, const std::vector<int> &token_ids,
+                                         const std::vector<int> &map,
+                                         std::vector<int> *token_states = nullptr) const;
+  virtual void WriteCompiled(BundleWriter &writer) const;
+  static std::unique_ptr<OneBestFstLoader> ReadCompiled(BundleReader &reader);
   virtual const std::string &getToken(int index) const { return mToken.at(index); }
-  virtual std::vector<int> convertToIntVector(fst::SymbolTable &symbol) const;
+  const TokenType &getTokens() const { return mToken; }
   int TokensSize() { return mToken.size(); }
  private:
+  void FoldTokens();
+
   bool mUseCase;
+  TokenType mFoldedToken;
 };
 
 #endif /* ONEBESTFSTLOADER_H_ */
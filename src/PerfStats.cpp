@@ -0,0 +1,154 @@
+/*
+ * PerfStats.cpp
+ */
+
+#include "PerfStats.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+template <typename T>
+T &Entry(std::vector<std::pair<std::string, T>> &entries, const std::string &name) {
+  auto found = std::find_if(entries.begin(), entries.end(),
+                            [&name](const std::pair<std::string, T> &entry) { return entry.first == name; });
+  if (found != entries.end()) {
+    return found->second;
+  }
+  entries.emplace_back(name, T());
+  return entries.back().second;
+}
+
+template <typename T>
+void WriteEntries(JsonWriter &writer, const std::string &key, const std::vector<std::pair<std::string, T>> &entries) {
+  if (entries.empty()) {
+    return;
+  }
+  writer.Key(key);
+  writer.BeginObject();
+  for (auto &entry : entries) {
+    writer.Member(entry.first, entry.second);
+  }
+  writer.EndObject();
+}
+
+std::string ReadableBytes(int64_t bytes) {
+  char buffer[32];
+  if (bytes < 1024 * 1024) {
+    snprintf(buffer, sizeof(buffer), "%.1f KB", bytes / 1024.0);
+  } else {
+    snprintf(buffer, sizeof(buffer), "%.1f MB", bytes / (1024.0 * 1024.0));
+  }
+  return buffer;
+}
+
+}  // namespace
+
+PerfStats::PerfStats(const PerfStats &other) { *this = other; }
+
+PerfStats &PerfStats::operator=(const PerfStats &other) {
+  if (this == &other) {
+    return *this;
+  }
+  std::lock(memory_mutex_, other.memory_mutex_);
+  std::lock_guard<std::mutex> lock(memory_mutex_, std::adopt_lock);
+  std::lock_guard<std::mutex> other_lock(other.memory_mutex_, std::adopt_lock);
+  counters_ = other.counters_;
+  phases_ms_ = other.phases_ms_;
+  preparation_ms_ = other.preparation_ms_;
+  memory_held_ = other.memory_held_;
+  memory_peaks_ = other.memory_peaks_;
+  memory_held_total_ = other.memory_held_total_;
+  memory_peak_total_ = other.memory_peak_total_;
+  memory_limit_ = other.memory_limit_;
+  return *this;
+}
+
+void PerfStats::AddTime(const std::string &phase, double ms) { Entry(phases_ms_, phase) += ms; }
+
+void PerfStats::AddPreparationTime(const std::string &step, double ms) { Entry(preparation_ms_, step) += ms; }
+
+void PerfStats::Count(const std::string &counter, int64_t value) { Entry(counters_, counter) += value; }
+
+void PerfStats::Max(const std::string &counter, int64_t value) {
+  auto &current = Entry(counters_, counter);
+  current = std::max(current, value);
+}
+
+void PerfStats::SetMemoryLimit(int64_t bytes) {
+  std::lock_guard<std::mutex> lock(memory_mutex_);
+  memory_limit_ = bytes;
+}
+
+void PerfStats::HoldMemory(const std::string &subsystem, int64_t bytes) {
+  std::lock_guard<std::mutex> lock(memory_mutex_);
+  auto &held = Entry(memory_held_, subsystem);
+  auto &peak = Entry(memory_peaks_, subsystem);
+  int64_t growth = bytes - held;
+  held = bytes;
+  peak = std::max(peak, bytes);
+  memory_held_total_ += growth;
+  memory_peak_total_ = std::max(memory_peak_total_, memory_held_total_);
+
+  // only a growing subsystem throws, releasing memory is always fine
+  if (memory_limit_ > 0 && growth > 0 && memory_held_total_ > memory_limit_) {
+    std::string held_by;
+    for (auto &entry : memory_held_) {
+      if (entry.second > 0) {
+        held_by += (held_by.empty() ? "" : ", ") + entry.first + " " + ReadableBytes(entry.second);
+      }
+    }
+    throw MemoryLimitExceeded("memory limit of " + ReadableBytes(memory_limit_) + " exceeded when " + subsystem +
+                              " grew to " + ReadableBytes(bytes) + ", approx. " + ReadableBytes(memory_held_total_) +
+                              " held (" + held_by + ")");
+  }
+}
+
+bool PerfStats::empty() const {
+  std::lock_guard<std::mutex> lock(memory_mutex_);
+  return counters_.empty() && phases_ms_.empty() && preparation_ms_.empty() && memory_peaks_.empty();
+}
+
+void PerfStats::Write(JsonWriter &writer) const {
+  writer.BeginObject();
+  WriteEntries(writer, "counters", counters_);
+  WriteEntries(writer, "phasesMs", phases_ms_);
+  WriteEntries(writer, "preparationMs", preparation_ms_);
+  std::lock_guard<std::mutex> lock(memory_mutex_);
+  if (!memory_peaks_.empty()) {
+    writer.Key("memoryPeakBytes");
+    writer.BeginObject();
+    for (auto &entry : memory_peaks_) {
+      writer.Member(entry.first, entry.second);
+    }
+    // the subsystems peak at different times, the total is the peak of their sum
+    writer.Member("total", memory_peak_total_);
+    writer.EndObject();
+  }
+  writer.EndObject();
+}
+
+ScopedPhaseTimer::ScopedPhaseTimer(PerfStats *stats, const std::string &phase)
+    : stats_(stats), phase_(phase), start_(std::chrono::steady_clock::now()) {}
+
+ScopedPhaseTimer::~ScopedPhaseTimer() {
+  if (stats_) {
+    stats_->AddTime(phase_, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count());
+  }
+}
+
+ScopedMemoryHold::ScopedMemoryHold(PerfStats *stats, const std::string &subsystem)
+    : stats_(stats), subsystem_(subsystem) {}
+
+ScopedMemoryHold::~ScopedMemoryHold() {
+  if (stats_) {
+    stats_->HoldMemory(subsystem_, 0);
+  }
+}
+
+void ScopedMemoryHold::Update(int64_t bytes) {
+  if (stats_) {
+    stats_->HoldMemory(subsystem_, bytes);
+  }
+}
@@ -0,0 +1,93 @@
+/*
+ * PerfStats.h
+ *
+ * Wall time of the phases of a job, counters of the work they did and the peak
+ * memory of its subsystems, reported in the perf section of the --json-log.
+ * Filled by the thread running the job, except for HoldMemory() which the
+ * concurrent steps preparing the fsts call as they build their structures.
+ */
+
+#ifndef __PERF_STATS_H__
+#define __PERF_STATS_H__
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "JsonWriter.h"
+
+// thrown when the memory held by the subsystems of a job goes over its limit
+class MemoryLimitExceeded : public std::runtime_error {
+ public:
+  using std::runtime_error::runtime_error;
+};
+
+class PerfStats {
+ public:
+  PerfStats() = default;
+  // copies the stats, e.g. with the WerReport of an AlignmentResult, the mutex stays behind
+  PerfStats(const PerfStats &other);
+  PerfStats &operator=(const PerfStats &other);
+
+  // the times of a phase timed more than once add up
+  void AddTime(const std::string &phase, double ms);
+  // the steps preparing the fsts, concurrent ones overlapping
+  void AddPreparationTime(const std::string &step, double ms);
+  void Count(const std::string &counter, int64_t value = 1);
+  // keeps the largest value seen, e.g. for high-water marks
+  void Max(const std::string &counter, int64_t value);
+
+  // 0, the default, for no limit
+  void SetMemoryLimit(int64_t bytes);
+  // the approximate bytes a subsystem, e.g. the walker heaps, holds from now on.  Keeps
+  // the peak of each subsystem and of their total, and throws MemoryLimitExceeded when
+  // growing the subsystem takes the total over the limit.  Safe to call from several threads
+  void HoldMemory(const std::string &subsystem, int64_t bytes);
+
+  bool empty() const;
+  // counters, phasesMs, preparationMs and memoryPeakBytes, each in the order they were first recorded
+  void Write(JsonWriter &writer) const;
+
+ private:
+  std::vector<std::pair<std::string, int64_t>> counters_;
+  std::vector<std::pair<std::string, double>> phases_ms_;
+  std::vector<std::pair<std::string, double>> preparation_ms_;
+
+  // guards the memory accounting, the other members are only used by the thread running the job
+  mutable std::mutex memory_mutex_;
+  std::vector<std::pair<std::string, int64_t>> memory_held_;
+  std::vector<std::pair<std::string, int64_t>> memory_peaks_;
+  int64_t memory_held_total_ = 0;
+  int64_t memory_peak_total_ = 0;
+  int64_t memory_limit_ = 0;
+};
+
+// adds the time it lived to a phase of the stats, when given
+class ScopedPhaseTimer {
+ public:
+  ScopedPhaseTimer(PerfStats *stats, const std::string &phase);
+  ~ScopedPhaseTimer();
+
+ private:
+  PerfStats *stats_;
+  std::string phase_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// holds the memory of a subsystem in the stats, when given, until it goes out of scope
+class ScopedMemoryHold {
+ public:
+  ScopedMemoryHold(PerfStats *stats, const std::string &subsystem);
+  ~ScopedMemoryHold();
+  void Update(int64_t bytes);
+
+ private:
+  PerfStats *stats_;
+  std::string subsystem_;
+};
+
+#endif  // __PERF_STATS_H__
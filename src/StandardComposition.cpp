@@ -13,7 +13,6 @@ StandardCompositionFst::StandardCompositionFst(const fst::StdFst &fstA, const fs
   symbols_ = &symbols;
 
   logger_ = logger::GetOrCreateLogger("StandardCompositionFst");
-  logger_->set_level(spdlog::level::info);
 
   FstAlignOption options;
   sub_label_id_ = symbols.Find(options.symSub);
@@ -8,9 +8,24 @@
  */
 #include "SynonymEngine.h"
 
+#include <unordered_set>
+
+#include "CompiledReference.h"
+#include "MappedFile.h"
+#include "version.h"
+
 #define strtk_no_tr1_or_boost
 #include <strtk/strtk.hpp>
 
+const char *const SynonymEngine::kCompiledExtension = ".fstalign-syn";
+
+// Compiled rule set layout, all integers little-endian:
+//   magic "FSTALSYN", format version, fstalign version string,
+//   the words of the rules (sorted), then the rules in key order,
+//   each a key and its alternatives as indices in the words
+static const char kCompiledMagic[8] = {'F', 'S', 'T', 'A', 'L', 'S', 'Y', 'N'};
+static const uint32_t kCompiledFormatVersion = 1;
+
 SynonymEngine::SynonymEngine(SynonymOptions syn_opts) {
   map<SynKey, SynVals> synonyms;
   opts_ = syn_opts;
@@ -18,20 +33,121 @@ SynonymEngine::SynonymEngine(SynonymOptions syn_opts) {
 }
 
 void SynonymEngine::LoadFile(string filename) {
-  ifstream input(filename);
-
-  if (!input.is_open()) throw std::runtime_error("Cannot open input file");
+  MappedFile file(filename);
+  if (file.size() >= sizeof(kCompiledMagic) && memcmp(file.begin(), kCompiledMagic, sizeof(kCompiledMagic)) == 0) {
+    ReadCompiled(file.begin() + sizeof(kCompiledMagic), file.end(), filename);
+    return;
+  }
 
   vector<string> lines;
-  string s;
-  while (std::getline(input, s)) {
-    lines.push_back(s);
+  LineCursor cursor(file.begin(), file.end());
+  const char *line_begin, *line_end;
+  while (cursor.NextLine(line_begin, line_end)) {
+    lines.emplace_back(line_begin, line_end);
   }
-  input.close();
 
   ParseStrings(lines);
 }
 
+void SynonymEngine::WriteCompiled(const string &filename) const {
+  auto rules = SortedRules();
+
+  // the words are interned, the rules only refer to them
+  map<string, int> word_ids;
+  for (auto &entry : rules) {
+    for (auto &word : *entry.first) {
+      word_ids[word];
+    }
+    for (auto &alternative : *entry.second) {
+      for (auto &word : alternative) {
+        word_ids[word];
+      }
+    }
+  }
+  vector<string> words;
+  words.reserve(word_ids.size());
+  for (auto &entry : word_ids) {
+    entry.second = words.size();
+    words.push_back(entry.first);
+  }
+  auto to_ids = [&word_ids](const vector<string> &tokens) {
+    vector<int> ids;
+    ids.reserve(tokens.size());
+    for (auto &token : tokens) {
+      ids.push_back(word_ids[token]);
+    }
+    return ids;
+  };
+
+  auto output = OpenOutput(filename);
+  output->write(kCompiledMagic, sizeof(kCompiledMagic));
+  BundleWriter writer(*output);
+  writer.WriteUInt32(kCompiledFormatVersion);
+  writer.WriteString(to_string(FSTALIGNER_VERSION_MAJOR) + "." + to_string(FSTALIGNER_VERSION_MINOR) + "." +
+                     to_string(FSTALIGNER_VERSION_PATCH));
+  writer.WriteStrings(words);
+  writer.WriteUInt32(rules.size());
+  for (auto &entry : rules) {
+    writer.WriteInts(to_ids(*entry.first));
+    writer.WriteUInt32(entry.second->size());
+    for (auto &alternative : *entry.second) {
+      writer.WriteInts(to_ids(alternative));
+    }
+  }
+
+  output->flush();
+  if (!*output) {
+    throw std::runtime_error("failed to write the compiled synonyms " + filename);
+  }
+  logger_->info("compiled {} synonym rules over {} words into {}", rules.size(), words.size(), filename);
+}
+
+void SynonymEngine::ReadCompiled(const char *begin, const char *end, const string &filename) {
+  BundleReader reader(begin, end, filename);
+  uint32_t version = reader.ReadUInt32();
+  string compiled_by = reader.ReadString();
+  if (version != kCompiledFormatVersion) {
+    throw std::runtime_error(filename + " was compiled by fstalign " + compiled_by + " in format version " +
+                             to_string(version) + ", this version reads format " +
+                             to_string(kCompiledFormatVersion) + ", recompile the synonyms");
+  }
+
+  vector<string> words = reader.ReadStrings();
+  auto to_words = [&](const vector<int> &ids) {
+    vector<string> tokens;
+    tokens.reserve(ids.size());
+    for (int id : ids) {
+      if (id < 0 || id >= static_cast<int>(words.size())) {
+        throw std::runtime_error("invalid word index in the compiled synonyms " + filename);
+      }
+      tokens.push_back(words[id]);
+    }
+    return tokens;
+  };
+
+  uint32_t num_rules = reader.ReadUInt32();
+  uint32_t num_skipped = 0;
+  synonyms.reserve(synonyms.size() + num_rules);
+  for (uint32_t i = 0; i < num_rules; i++) {
+    SynKey key = to_words(reader.ReadInts());
+    SynVals values(reader.ReadUInt32());
+    for (auto &alternative : values) {
+      alternative = to_words(reader.ReadInts());
+    }
+    if (FindRule(key) != nullptr) {
+      // like a redefinition in a text file, the first definition wins
+      num_skipped++;
+      continue;
+    }
+    synonyms.emplace(std::move(key), std::move(values));
+  }
+  if (num_skipped > 0) {
+    logger_->warn("{} rules of {} were already defined, skipping their redefinition", num_skipped, filename);
+  }
+  logger_->info("loaded {} compiled synonym rules from {} (fstalign {})", num_rules - num_skipped, filename,
+                compiled_by);
+}
+
 SynKey SynonymEngine::GetKeyFromString(string lhs) {
   //   SynKey k;
   vector<string> k;
@@ -88,7 +204,7 @@ void SynonymEngine::ParseStrings(vector<string> lines) {
     trim(lhs);
     auto key = GetKeyFromString(lhs);
 
-    if (synonyms.find(key) == synonyms.end()) {
+    if (FindRule(key) == nullptr) {
       // new entry
       auto values = GetValuesFromStrings(rhs);
       synonyms[key] = values;
@@ -101,55 +217,26 @@ void SynonymEngine::ParseStrings(vector<string> lines) {
   }
 }
 
-vector<int> SeekForward(SynKey &lhs, int lhsPos, StdVectorFst &fst, int startingStateId, SymbolTable &symbol) {
-  vector<int> lastStates;
-
-  int stateId = startingStateId;
-  if (lhsPos >= lhs.size()) {
-    // we reached the end of the LHS stack, this node is our
-    // destination
-    lastStates.push_back(startingStateId);
-    return lastStates;
-  }
-
-  int currKeyPartLabelId = symbol.Find(lhs[lhsPos]);
-  int kNoSymbol = -1;
-  if (currKeyPartLabelId == kNoSymbol) {
-    return lastStates;
-  }
-
-  for (ArcIterator<StdFst> aiter(fst, stateId); !aiter.Done(); aiter.Next()) {
-    const fst::StdArc &arc = aiter.Value();
-    if (arc.nextstate == stateId) {
-      // if we're pointing to ourselves, let's ignore that
-      continue;
-    }
-
-    int label_id = arc.ilabel;
-    if (label_id == currKeyPartLabelId) {
-      auto endStates = SeekForward(lhs, lhsPos + 1, fst, arc.nextstate, symbol);
-      copy(endStates.begin(), endStates.end(), back_inserter(lastStates));
-    }
-  }
-
-  return lastStates;
-}
-
-void SynonymEngine::GenerateSynFromSymbolTable(SymbolTable &symbol) {
+vector<SynKey> SynonymEngine::GenerateSynFromSymbolTable(SymbolTable &symbol) {
   logger_->debug("Adding synonyms dynamically from symbol table.");
   int kNoSymbol = -1;
 
   int cutoff_count = 0;
   int compound_hyphen_count = 0;
+  vector<SynKey> new_rules;
 
+  SynKey key(1);
+  vector<string> new_words;
   SymbolTableIterator symIter(symbol);
   while (!symIter.Done()) {
     auto sym = symIter.Symbol();
     symIter.Next();
-    int hyphen_idx = sym.find('-');
-    if (hyphen_idx < 0) {
+    auto hyphen_idx = sym.find('-');
+    if (hyphen_idx == string::npos) {
       continue;
     }
+    // tokens never contain spaces or ';' in practice, they would need the rule parsing
+    bool plain_token = sym.find_first_of(" ;\t\n\r\f\v") == string::npos;
     if (!opts_.disable_cutoffs && hyphen_idx == sym.length() - 1) {
       // Cutoff rules take precedence
       auto new_word = sym.substr(0, sym.size() - 1);
@@ -157,74 +244,268 @@ void SynonymEngine::GenerateSynFromSymbolTable(SymbolTable &symbol) {
       if (id == kNoSymbol) {
         id = symbol.AddSymbol(new_word);
       }
-      auto key = GetKeyFromString(sym);
-      auto values = GetValuesFromStrings(new_word);
-      if (synonyms.find(key) == synonyms.end()) {
+      if (!plain_token) {
+        key = GetKeyFromString(sym);
+      } else {
+        key.resize(1);
+        key[0] = sym;
+      }
+      if (FindRule(key) == nullptr) {
         // Only add the cutoff synonym if no synonym is already defined
-        synonyms[key] = values;
+        SynVals values;
+        if (!plain_token) {
+          values = GetValuesFromStrings(new_word);
+        } else if (!new_word.empty()) {
+          values.push_back({new_word});
+        }
+        new_rules.push_back(key);
+        synonyms.emplace(std::move(key), std::move(values));
       }
       cutoff_count++;
     } else if (!opts_.disable_hyphen_ignore && hyphen_idx != sym.length() - 1) {
       // Generate other hyphenation rules
-      vector<string> new_words;
-      strtk::split("-", trim_copy(sym), strtk::range_to_type_back_inserter(new_words),
+      new_words.clear();
+      strtk::split("-", plain_token ? sym : trim_copy(sym), strtk::range_to_type_back_inserter(new_words),
                    strtk::split_options::compress_delimiters);
 
-      vector<string> hyphenated = GetKeyFromString(sym);
-
       // Add new subwords if they didn't exist in the table
-      for (auto w : new_words) {
+      for (auto &w : new_words) {
         int id = symbol.Find(w);
         if (id == kNoSymbol) {
           id = symbol.AddSymbol(w);
         }
       }
 
-      if (synonyms.find(hyphenated) == synonyms.end()) {
+      if (!plain_token) {
+        key = GetKeyFromString(sym);
+      } else {
+        key.resize(1);
+        key[0] = sym;
+      }
+      if (FindRule(key) == nullptr) {
         // Add hyphenated --> unhyphenated synonym
-        synonyms[hyphenated] = {new_words};
+        synonyms.emplace(key, SynVals{new_words});
+        new_rules.push_back(key);
       }
-      if (synonyms.find(new_words) == synonyms.end()) {
+      if (FindRule(new_words) == nullptr) {
         // Add unhyphenated --> hyphenated synonym
-        synonyms[new_words] = {hyphenated};
+        synonyms.emplace(new_words, SynVals{key});
+        new_rules.push_back(new_words);
       }
       compound_hyphen_count++;
     }
   }
   logger_->debug("Found {} cutoff words and added their synonyms", cutoff_count);
   logger_->debug("Found {} compound hyphen words and added their synonyms", compound_hyphen_count);
-  return;
+  return new_rules;
 }
 
-void SynonymEngine::ApplyToFst(StdVectorFst &fst, SymbolTable &symbol) {
-  int kNoSymbol = -1;
+bool SynonymEngine::GeneratesSynonymsFor(const string &token) const {
+  auto hyphen_idx = token.find('-');
+  if (hyphen_idx == string::npos) {
+    return false;
+  }
+
+  if (hyphen_idx == token.length() - 1) {
+    return !opts_.disable_cutoffs;
+  }
+
+  return !opts_.disable_hyphen_ignore;
+}
 
-  // let's get the list of all words that 'start' a synonym
-  // expression
-  // set<string> firstWordInRules;
-  map<int, vector<SynKey>> firstWordInRules;
-  for (auto entry : synonyms) {
-    auto tk = entry.first[0];
-    // there's no point inserting synonym rules if
-    // the original fst doesn't have it
-    int id = symbol.Find(tk);
-    if (id != kNoSymbol) {
-      if (firstWordInRules.find(id) == firstWordInRules.end()) {
-        firstWordInRules[id] = vector<SynKey>();
+const SynVals *SynonymEngine::FindRule(const SynKey &key) const {
+  auto entry = synonyms.find(key);
+  if (entry != synonyms.end()) {
+    return &entry->second;
+  }
+  if (shared_synonyms_) {
+    auto shared_entry = shared_synonyms_->find(key);
+    if (shared_entry != shared_synonyms_->end()) {
+      return &shared_entry->second;
+    }
+  }
+  return nullptr;
+}
+
+vector<pair<const SynKey *, const SynVals *>> SynonymEngine::SortedRules() const {
+  // local and shared rules never have the same key
+  vector<pair<const SynKey *, const SynVals *>> rules;
+  rules.reserve(synonyms.size() + (shared_synonyms_ ? shared_synonyms_->size() : 0));
+  for (auto &entry : synonyms) {
+    rules.emplace_back(&entry.first, &entry.second);
+  }
+  if (shared_synonyms_) {
+    for (auto &entry : *shared_synonyms_) {
+      rules.emplace_back(&entry.first, &entry.second);
+    }
+  }
+  sort(rules.begin(), rules.end(), [](const pair<const SynKey *, const SynVals *> &a,
+                                      const pair<const SynKey *, const SynVals *> &b) { return *a.first < *b.first; });
+  return rules;
+}
+
+void SynonymEngine::ShareRules() {
+  if (synonyms.empty()) {
+    return;
+  }
+  auto merged = shared_synonyms_ ? std::make_shared<SynRules>(*shared_synonyms_) : std::make_shared<SynRules>();
+  for (auto &entry : synonyms) {
+    merged->emplace(entry.first, std::move(entry.second));
+  }
+  synonyms.clear();
+  shared_synonyms_ = merged;
+}
+
+size_t SynonymEngine::ApplyToFst(StdVectorFst &fst, SymbolTable &symbol) {
+  vector<SynKey> rules;
+  rules.reserve(synonyms.size() + (shared_synonyms_ ? shared_synonyms_->size() : 0));
+  for (auto &entry : synonyms) {
+    rules.push_back(entry.first);
+  }
+  if (shared_synonyms_) {
+    for (auto &entry : *shared_synonyms_) {
+      rules.push_back(entry.first);
+    }
+  }
+
+  return ApplyToFst(fst, symbol, rules);
+}
+
+namespace {
+
+// Trie of the rules' LHS, over the labels of the symbol table, so that all the rules
+// matching from a state are found in a single walk of the FST
+const int kTrieRoot = 0;
+const int kNoRule = -1;
+
+class RuleTrie {
+ public:
+  RuleTrie() : rules_(1, kNoRule) {}
+
+  void Insert(const vector<int> &labels, int rule) {
+    int node = kTrieRoot;
+    for (int label : labels) {
+      auto inserted = children_.emplace(EdgeKey(node, label), rules_.size());
+      if (inserted.second) {
+        rules_.push_back(kNoRule);
       }
+      node = inserted.first->second;
+    }
+    rules_[node] = rule;
+  }
+
+  // -1 if no rule continues with this label
+  int Child(int node, int label) const {
+    auto child = children_.find(EdgeKey(node, label));
+    return child == children_.end() ? -1 : child->second;
+  }
+
+  // the rule ending at this node, kNoRule if none
+  int Rule(int node) const { return rules_[node]; }
+
+ private:
+  static uint64_t EdgeKey(int node, int label) {
+    return (static_cast<uint64_t>(node) << 32) | static_cast<uint32_t>(label);
+  }
+
+  unordered_map<uint64_t, int> children_;
+  vector<int> rules_;
+};
+
+// Follows the arcs of `fst` from `state` along the trie, appending to end_states[rule]
+// the states where each matching LHS ends.  Self-loops are ignored.
+void MatchRules(const StdVectorFst &fst, const RuleTrie &trie, int node, int state, vector<vector<int>> &end_states,
+                vector<int> &matched_rules) {
+  for (ArcIterator<StdVectorFst> aiter(fst, state); !aiter.Done(); aiter.Next()) {
+    const StdArc &arc = aiter.Value();
+    if (arc.nextstate == state) {
+      continue;
+    }
+    int child = trie.Child(node, arc.ilabel);
+    if (child < 0) {
+      continue;
+    }
+    int rule = trie.Rule(child);
+    if (rule != kNoRule) {
+      if (end_states[rule].empty()) {
+        matched_rules.push_back(rule);
+      }
+      end_states[rule].push_back(arc.nextstate);
+    }
+    MatchRules(fst, trie, child, arc.nextstate, end_states, matched_rules);
+  }
+}
 
-      firstWordInRules[id].push_back(entry.first);
+uint64_t StateLabelKey(int state, int label) {
+  return (static_cast<uint64_t>(state) << 32) | static_cast<uint32_t>(label);
+}
+
+}  // namespace
+
+size_t SynonymEngine::ApplyToFst(StdVectorFst &fst, SymbolTable &symbol, const vector<SynKey> &rules) {
+  int kNoSymbol = -1;
+
+  // the rules are applied in their sorted order, which decides the synonym labels
+  vector<const SynKey *> sorted_rules;
+  sorted_rules.reserve(rules.size());
+  for (auto &rule : rules) {
+    sorted_rules.push_back(&rule);
+  }
+  sort(sorted_rules.begin(), sorted_rules.end(), [](const SynKey *a, const SynKey *b) { return *a < *b; });
+
+  // there's no point inserting synonym rules if the original fst doesn't
+  // have all their words
+  RuleTrie trie;
+  vector<const SynKey *> trie_rules;
+  vector<const SynVals *> trie_values;
+  unordered_map<int, vector<int>> firstWordInRules;
+  vector<int> labels;
+  for (auto rule : sorted_rules) {
+    labels.clear();
+    for (auto &word : *rule) {
+      int id = symbol.Find(word);
+      if (id == kNoSymbol) {
+        break;
+      }
+      labels.push_back(id);
     }
+    if (labels.empty() || labels.size() != rule->size()) {
+      continue;
+    }
+    trie.Insert(labels, trie_rules.size());
+    firstWordInRules[labels[0]].push_back(trie_rules.size());
+    trie_rules.push_back(rule);
+    trie_values.push_back(FindRule(*rule));
   }
 
   logger_->info("we have {} registered first word rules label id", firstWordInRules.size());
 
+  // per rule, the end states of its matches from the current state
+  vector<vector<int>> end_states(trie_rules.size());
+  // per rule, the labels of its alternatives, resolved on its first match
+  vector<vector<vector<int>>> alternative_labels(trie_rules.size());
+  // per rule, the synonym labels of its alternatives, shared by all their matches
+  vector<vector<vector<int>>> alternative_syn_labels(trie_rules.size());
+  // the states where each synonym label opens and closes a path
+  unordered_set<uint64_t> opened_at;
+  unordered_set<uint64_t> closed_at;
+  vector<int> matched_rules;
+
   StateIterator<StdVectorFst> siter(fst);
   vector<pair<int, StdArc>> arcsToAdd;
-  int synonym_replacement_id = 100000;
   while (!siter.Done()) {
     int stateId = siter.Value();
     siter.Next();
+
+    for (int rule : matched_rules) {
+      end_states[rule].clear();
+    }
+    matched_rules.clear();
+    MatchRules(fst, trie, kTrieRoot, stateId, end_states, matched_rules);
+    if (matched_rules.empty()) {
+      continue;
+    }
+
     for (ArcIterator<StdVectorFst> aiter(fst, stateId); !aiter.Done(); aiter.Next()) {
       const StdArc &arc = aiter.Value();
       if (arc.nextstate == stateId) {
@@ -240,27 +521,56 @@ void SynonymEngine::ApplyToFst(StdVectorFst &fst, SymbolTable &symbol) {
       }
 
       // we have a match!
-      // for each of the candidates, check if the graph supports it.
-      // if it does, then add arcs from s to the last state required
-      // to consume the LHS and add it to the arcsToAdd list
-      vector<SynKey> candidates = (*firstWordEntry).second;
-      logger_->debug("for state {} and label id {} we have {} candidates", stateId, label_id, candidates.size());
-      for (auto &lhs : candidates) {
-        auto lastTargetStates = SeekForward(lhs, 0, fst, stateId, symbol);
+      // for each of the candidates supported by the graph, add arcs from s
+      // to the last states required to consume the LHS
+      logger_->debug("for state {} and label id {} we have {} candidates", stateId, label_id,
+                     firstWordEntry->second.size());
+      for (int rule : firstWordEntry->second) {
+        auto &lhs = *trie_rules[rule];
+        auto &lastTargetStates = end_states[rule];
         if (lastTargetStates.size() == 0) {
           // no match, let's continue
           continue;
         }
         logger_->debug("for label id {} we have {} next states", label_id, lastTargetStates.size());
 
-        for (auto &alternative : synonyms[lhs]) {
+        const SynVals &alternatives = *trie_values[rule];
+        auto &labels_of_alternatives = alternative_labels[rule];
+        bool resolved = labels_of_alternatives.size() == alternatives.size();
+        labels_of_alternatives.resize(alternatives.size());
+        alternative_syn_labels[rule].resize(alternatives.size());
+        for (size_t a = 0; a < alternatives.size(); a++) {
+          auto &alternative = alternatives[a];
+          auto &wids = labels_of_alternatives[a];
           int currState = stateId;
           int nextState = 0;
 
-          string syn_classlabel = "___" + to_string(synonym_replacement_id++) + "_SYN_" + to_string(lhs.size()) + "-" +
-                                  to_string(alternative.size()) + "___";
+          // The matches of an alternative share its label, so the symbol table grows with the
+          // rules rather than with the matches.  The stitching tells the matches apart by
+          // their label though, so two matches following each other get different ones.
+          int syn_classlabel_wid = kNoSymbol;
+          auto &syn_labels = alternative_syn_labels[rule][a];
+          for (int syn_label : syn_labels) {
+            bool follows_another = closed_at.count(StateLabelKey(stateId, syn_label)) > 0;
+            for (int endState : lastTargetStates) {
+              follows_another = follows_another || opened_at.count(StateLabelKey(endState, syn_label)) > 0;
+            }
+            if (!follows_another) {
+              syn_classlabel_wid = syn_label;
+              break;
+            }
+          }
+          if (syn_classlabel_wid == kNoSymbol) {
+            string syn_classlabel = "___" + to_string(next_synonym_label_id_++) + "_SYN_" + to_string(lhs.size()) +
+                                    "-" + to_string(alternative.size()) + "___";
+            syn_classlabel_wid = symbol.AddSymbol(syn_classlabel);
+            syn_labels.push_back(syn_classlabel_wid);
+          }
+          opened_at.insert(StateLabelKey(stateId, syn_classlabel_wid));
+          for (int endState : lastTargetStates) {
+            closed_at.insert(StateLabelKey(endState, syn_classlabel_wid));
+          }
 
-          int syn_classlabel_wid = symbol.AddSymbol(syn_classlabel);
           nextState = fst.AddState();
           StdArc newArc(syn_classlabel_wid, syn_classlabel_wid, 0.0f, nextState);
           pair<int, StdArc> local_pair;
@@ -269,14 +579,17 @@ void SynonymEngine::ApplyToFst(StdVectorFst &fst, SymbolTable &symbol) {
           currState = nextState;
 
           // one alternative contains all the words for one synonym rule
-          for (int j = 0; j < alternative.size(); j++) {
-            auto w = alternative[j];
-            int wid = symbol.Find(w);
-            if (wid == kNoSymbol) {
-              wid = symbol.AddSymbol(w);
-              logger_->info("registering word {} as {}", w, wid);
+          if (!resolved) {
+            for (auto &w : alternative) {
+              int wid = symbol.Find(w);
+              if (wid == kNoSymbol) {
+                wid = symbol.AddSymbol(w);
+                logger_->info("registering word {} as {}", w, wid);
+              }
+              wids.push_back(wid);
             }
-
+          }
+          for (int wid : wids) {
             nextState = fst.AddState();
             StdArc newArc(wid, wid, 0.0f, nextState);
             pair<int, StdArc> local_pair;
@@ -301,4 +614,37 @@ void SynonymEngine::ApplyToFst(StdVectorFst &fst, SymbolTable &symbol) {
     logger_->debug("adding arc between {} and {} with label_id {}", p.first, p.second.nextstate, p.second.ilabel);
     fst.AddArc(p.first, p.second);
   }
+  return arcsToAdd.size();
+}
+
+void SynonymEngine::Write(BundleWriter &writer) const {
+  writer.WriteBool(opts_.disable_cutoffs);
+  writer.WriteBool(opts_.disable_hyphen_ignore);
+  writer.WriteInt32(next_synonym_label_id_);
+  auto rules = SortedRules();
+  writer.WriteUInt32(rules.size());
+  for (auto &entry : rules) {
+    writer.WriteStrings(*entry.first);
+    writer.WriteUInt32(entry.second->size());
+    for (auto &alternative : *entry.second) {
+      writer.WriteStrings(alternative);
+    }
+  }
+}
+
+void SynonymEngine::Read(BundleReader &reader) {
+  opts_.disable_cutoffs = reader.ReadBool();
+  opts_.disable_hyphen_ignore = reader.ReadBool();
+  next_synonym_label_id_ = reader.ReadInt32();
+  synonyms.clear();
+  shared_synonyms_.reset();
+  uint32_t num_rules = reader.ReadUInt32();
+  for (uint32_t i = 0; i < num_rules; i++) {
+    SynKey key = reader.ReadStrings();
+    SynVals &values = synonyms[key];
+    values.resize(reader.ReadUInt32());
+    for (auto &alternative : values) {
+      alternative = reader.ReadStrings();
+    }
+  }
 }
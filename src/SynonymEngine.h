@@ -18,25 +18,70 @@ using namespace fst;
 typedef vector<string> SynKey;
 typedef vector<vector<string>> SynVals;
 
+struct SynKeyHash {
+  size_t operator()(const SynKey &key) const {
+    size_t seed = key.size();
+    for (auto &word : key) {
+      seed ^= std::hash<string>()(word) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+    return seed;
+  }
+};
+
+// rules are looked up for every generated synonym, hashing beats comparing keys word by word
+typedef unordered_map<SynKey, SynVals, SynKeyHash> SynRules;
+
 struct SynonymOptions {
   bool disable_cutoffs = false;
   bool disable_hyphen_ignore = false;
 };
 
+class BundleReader;
+class BundleWriter;
+
 class SynonymEngine {
  public:
   SynonymEngine(SynonymOptions syn_opts);
 
+  // rules compiled by `fstalign compile-synonyms`, LoadFile() reads them as well as text rules
+  static const char *const kCompiledExtension;
+
   void LoadFile(string filename);
+  // writes the rules in the binary format LoadFile() reads without parsing
+  void WriteCompiled(const string &filename) const;
   SynKey GetKeyFromString(string lhs);
   SynVals GetValuesFromStrings(string rhs);
   void ParseStrings(vector<string> lines);
-  void ApplyToFst(StdVectorFst &fst, SymbolTable &symbol);
-  void GenerateSynFromSymbolTable(SymbolTable &symbol);
+  // both return the number of arcs added to the fst
+  size_t ApplyToFst(StdVectorFst &fst, SymbolTable &symbol);
+  // only applies the given rules, e.g. the ones generated after a first ApplyToFst()
+  size_t ApplyToFst(StdVectorFst &fst, SymbolTable &symbol, const vector<SynKey> &rules);
+  // returns the new rules
+  vector<SynKey> GenerateSynFromSymbolTable(SymbolTable &symbol);
+  bool HasRules() const { return !synonyms.empty() || (shared_synonyms_ && !shared_synonyms_->empty()); }
+  // true if GenerateSynFromSymbolTable() would add a rule for this token
+  bool GeneratesSynonymsFor(const string &token) const;
+
+  // Moves the rules into a read-only set shared by the copies of this engine, so that
+  // copying it for a job is cheap.  Rules added afterwards stay local to each copy.
+  void ShareRules();
+
+  // rules, options and synonym label counter, for compiled references
+  void Write(BundleWriter &writer) const;
+  void Read(BundleReader &reader);
 
  protected:
+  // nullptr if the key has no rule, local rules first
+  const SynVals *FindRule(const SynKey &key) const;
+  void ReadCompiled(const char *begin, const char *end, const string &filename);
+  // local and shared rules, in key order
+  vector<pair<const SynKey *, const SynVals *>> SortedRules() const;
+
   SynonymOptions opts_;
-  map<SynKey, SynVals> synonyms;
+  SynRules synonyms;
+  std::shared_ptr<const SynRules> shared_synonyms_;
+  // synonym paths are labeled ___<id>_SYN_<lhs size>-<rhs size>___, ids are unique per engine
+  int next_synonym_label_id_ = 100000;
   std::shared_ptr<spdlog::logger> logger_;
 };
 
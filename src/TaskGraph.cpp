@@ -0,0 +1,124 @@
+/*
+ * TaskGraph.cpp
+ */
+
+#include "TaskGraph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+TaskGraph::TaskId TaskGraph::Add(const std::string &name, std::function<void()> task,
+                                 const std::vector<TaskId> &after) {
+  TaskId id = tasks_.size();
+  for (TaskId dependency : after) {
+    if (dependency >= id) {
+      throw std::logic_error("task " + name + " depends on a task added after it");
+    }
+    tasks_[dependency].dependents.push_back(id);
+  }
+
+  tasks_.emplace_back();
+  auto &added = tasks_.back();
+  added.name = name;
+  added.run = std::move(task);
+  added.num_dependencies = after.size();
+  return id;
+}
+
+void TaskGraph::RunTask(TaskId id) {
+  auto start = std::chrono::steady_clock::now();
+  tasks_[id].run();
+  tasks_[id].ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  tasks_[id].done = true;
+}
+
+void TaskGraph::Run(int threads) {
+  size_t num_workers = std::min(static_cast<size_t>(std::max(threads, 1)), tasks_.size());
+  if (num_workers <= 1) {
+    // the dependencies are always added first
+    for (TaskId id = 0; id < tasks_.size(); id++) {
+      RunTask(id);
+    }
+    return;
+  }
+
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::deque<TaskId> ready;
+  std::vector<size_t> num_waiting(tasks_.size());
+  for (TaskId id = 0; id < tasks_.size(); id++) {
+    num_waiting[id] = tasks_[id].num_dependencies;
+    if (num_waiting[id] == 0) {
+      ready.push_back(id);
+    }
+  }
+  size_t num_finished = 0;
+  std::exception_ptr first_error;
+
+  // a worker waits for a task to be ready, or for all of them to be done
+  auto worker = [&]() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      changed.wait(lock, [&]() { return !ready.empty() || first_error || num_finished == tasks_.size(); });
+      if (first_error || num_finished == tasks_.size()) {
+        return;
+      }
+      TaskId id = ready.front();
+      ready.pop_front();
+
+      lock.unlock();
+      std::exception_ptr error;
+      try {
+        RunTask(id);
+      } catch (...) {
+        error = std::current_exception();
+      }
+      lock.lock();
+
+      num_finished++;
+      if (error) {
+        if (!first_error) {
+          first_error = error;
+        }
+      } else {
+        for (TaskId dependent : tasks_[id].dependents) {
+          if (--num_waiting[dependent] == 0) {
+            ready.push_back(dependent);
+          }
+        }
+      }
+      changed.notify_all();
+    }
+  };
+
+  // the calling thread is one of the workers
+  std::vector<std::thread> helpers;
+  helpers.reserve(num_workers - 1);
+  for (size_t w = 1; w < num_workers; w++) {
+    helpers.emplace_back(worker);
+  }
+  worker();
+  for (auto &helper : helpers) {
+    helper.join();
+  }
+
+  if (first_error) {
+    std::rethrow_exception(first_error);
+  }
+}
+
+std::vector<std::pair<std::string, double>> TaskGraph::Timings() const {
+  std::vector<std::pair<std::string, double>> timings;
+  for (auto &task : tasks_) {
+    if (task.done) {
+      timings.emplace_back(task.name, task.ms);
+    }
+  }
+  return timings;
+}
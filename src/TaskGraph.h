@@ -0,0 +1,47 @@
+/*
+ * TaskGraph.h
+ *
+ * Runs steps depending on each other, the independent ones concurrently, and
+ * times each of them.
+ */
+
+#ifndef __TASK_GRAPH_H__
+#define __TASK_GRAPH_H__
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+class TaskGraph {
+ public:
+  typedef size_t TaskId;
+
+  // the task starts once all the tasks of `after`, added before it, are done
+  TaskId Add(const std::string &name, std::function<void()> task, const std::vector<TaskId> &after = {});
+
+  // Runs every task on up to `threads` threads, 1 running them in the order they were
+  // added.  Once a task throws, no other task starts and the first exception is
+  // rethrown after the running ones are done.
+  void Run(int threads);
+
+  // name and wall time in milliseconds of each task that ran, in the order they were added
+  std::vector<std::pair<std::string, double>> Timings() const;
+
+ private:
+  struct Task {
+    std::string name;
+    std::function<void()> run;
+    size_t num_dependencies;
+    std::vector<TaskId> dependents;
+    bool done = false;
+    double ms = 0;
+  };
+
+  void RunTask(TaskId id);
+
+  std::vector<Task> tasks_;
+};
+
+#endif  // __TASK_GRAPH_H__
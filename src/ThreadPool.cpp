@@ -0,0 +1,118 @@
+/*
+ * ThreadPool.cpp
+ */
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <numeric>
+#include <thread>
+
+ThreadPool::ThreadPool(int threads) : num_threads_(threads) {
+  if (num_threads_ <= 0) {
+    num_threads_ = std::max(1u, std::thread::hardware_concurrency());
+  }
+}
+
+void ThreadPool::RunWorkers(size_t num_workers, const std::function<void(size_t)> &worker) {
+  if (num_workers <= 1) {
+    worker(0);
+    return;
+  }
+
+  std::vector<std::thread> workers;
+  workers.reserve(num_workers);
+  for (size_t w = 0; w < num_workers; w++) {
+    workers.emplace_back(worker, w);
+  }
+  for (auto &t : workers) {
+    t.join();
+  }
+}
+
+void ThreadPool::Run(size_t count, const std::function<void(size_t)> &job) {
+  std::atomic<size_t> next(0);
+  std::exception_ptr first_error;
+  std::mutex error_mutex;
+
+  // jobs are handed out one at a time, so a slow one doesn't hold back a whole chunk
+  RunWorkers(std::min(count, static_cast<size_t>(num_threads_)), [&](size_t) {
+    for (size_t i = next++; i < count; i = next++) {
+      try {
+        job(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!first_error) {
+          first_error = std::current_exception();
+        }
+      }
+    }
+  });
+
+  if (first_error) {
+    std::rethrow_exception(first_error);
+  }
+}
+
+void ThreadPool::RunLargestFirst(const std::vector<size_t> &costs, const std::function<void(size_t)> &job) {
+  size_t num_workers = std::min(costs.size(), static_cast<size_t>(num_threads_));
+  if (num_workers == 0) {
+    return;
+  }
+
+  std::vector<size_t> order(costs.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&costs](size_t a, size_t b) { return costs[a] > costs[b]; });
+
+  // no job is added once started, a worker finding all the queues empty is done
+  std::vector<std::deque<size_t>> queues(num_workers);
+  std::vector<std::mutex> queue_mutexes(num_workers);
+  for (size_t k = 0; k < order.size(); k++) {
+    queues[k % num_workers].push_back(order[k]);
+  }
+
+  std::exception_ptr first_error;
+  std::mutex error_mutex;
+
+  auto next_job = [&](size_t w, size_t &i) {
+    {
+      std::lock_guard<std::mutex> lock(queue_mutexes[w]);
+      if (!queues[w].empty()) {
+        i = queues[w].front();
+        queues[w].pop_front();
+        return true;
+      }
+    }
+    for (size_t v = (w + 1) % num_workers; v != w; v = (v + 1) % num_workers) {
+      std::lock_guard<std::mutex> lock(queue_mutexes[v]);
+      if (!queues[v].empty()) {
+        i = queues[v].back();
+        queues[v].pop_back();
+        return true;
+      }
+    }
+    return false;
+  };
+
+  RunWorkers(num_workers, [&](size_t w) {
+    size_t i;
+    while (next_job(w, i)) {
+      try {
+        job(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!first_error) {
+          first_error = std::current_exception();
+        }
+      }
+    }
+  });
+
+  if (first_error) {
+    std::rethrow_exception(first_error);
+  }
+}
@@ -0,0 +1,38 @@
+/*
+ * ThreadPool.h
+ *
+ * Runs independent jobs over a fixed number of worker threads.
+ */
+
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+class ThreadPool {
+ public:
+  // a value <= 0 uses one thread per hardware core
+  explicit ThreadPool(int threads);
+
+  int NumThreads() const { return num_threads_; }
+
+  // Calls job(i) for each i in [0, count) and returns once all of them are done.
+  // The first exception escaping a job is rethrown after the workers joined.
+  void Run(size_t count, const std::function<void(size_t)> &job);
+
+  // Same as Run(), for jobs of uneven cost, e.g. the size of their inputs.  The jobs are
+  // dealt from the most to the least costly to one queue per worker, each worker takes
+  // its next job from the costly end of its queue and, once it's empty, steals from the
+  // cheap end of the other queues.  Long jobs start early and the tail is made of short ones.
+  void RunLargestFirst(const std::vector<size_t> &costs, const std::function<void(size_t)> &job);
+
+ private:
+  // runs worker(w) for each w in [0, num_workers) and rethrows the first job exception
+  void RunWorkers(size_t num_workers, const std::function<void(size_t)> &worker);
+
+  int num_threads_;
+};
+
+#endif  // __THREAD_POOL_H__
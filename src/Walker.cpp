@@ -6,11 +6,15 @@ Walker.cpp
 */
 #include "Walker.h"
 
+#include "MemoryUsage.h"
 #include "utilities.h"
 
 using namespace std;
 using namespace fst;
 
+// the memory of the walk is sampled every so many loops
+const int kMemorySampleLoops = 1024;
+
 Walker::Walker() : heapA(&_heapA), heapB(&_heapB) {
   logger = logger::GetOrCreateLogger("walker");
 }
@@ -18,6 +22,7 @@ Walker::Walker() : heapA(&_heapA), heapB(&_heapB) {
 vector<wer_alignment> Walker::walkComposed(IComposition &fst, SymbolTable &symbol, FstAlignOption &options,
                                                        int numBests) {
   logger->info("starting a walk in the park");
+  counters = Counters();
 
   vector<wer_alignment> topAlignments;
   // initialize internal stores.  if we don't initialize the state iterator
@@ -42,11 +47,26 @@ vector<wer_alignment> Walker::walkComposed(IComposition &fst, SymbolTable &symbo
 
   heapA->insert(firstEntry);
 
+  ScopedMemoryHold walkerMemory(memory_stats, "walker");
+  ScopedMemoryHold composedMemory(memory_stats, "composedStates");
+  auto sampleMemory = [&]() {
+    walkerMemory.Update(ApproxMemoryBytes(visited_states.size()));
+    composedMemory.Update(fst.ApproxMemoryBytes());
+  };
+
+  if (trace) {
+    *trace << "event,loop,state,refA,refB,numWords,numErrors,cost,heapA,heapB,enqueued,pruned\n";
+  }
+
   int loopSinceLastPruning = 0;
   int loopCount = 0;
   int last1kStage = 0;
   while (heapA->size() > 0 && topEntries.size() < numBests) {
     loopCount++;
+    counters.statesPopped++;
+    if (loopCount % kMemorySampleLoops == 0) {
+      sampleMemory();
+    }
     auto currentState_ptr = heapA->removeFirst();
     auto currentState = *currentState_ptr;
     int s = currentState.currentState;
@@ -58,6 +78,7 @@ vector<wer_alignment> Walker::walkComposed(IComposition &fst, SymbolTable &symbo
     }
 
     int arcsLeaving = 0;
+    int64_t enqueuedBefore = counters.enqueues;
     vector<StdArc> arcs_leaving_state;
     if (!fst.TryGetArcsAtState(s, &arcs_leaving_state)) {
       logger->error("no arcs leaving state {}", s);
@@ -85,8 +106,13 @@ vector<wer_alignment> Walker::walkComposed(IComposition &fst, SymbolTable &symbo
 
       if (pp != nullptr) {
         heapB->insert(pp);
+        counters.enqueues++;
       }
     }
+    counters.heapHighWater = std::max(counters.heapHighWater, (int64_t)(heapA->size() + heapB->size()));
+    if (trace) {
+      TraceRow(fst, "expand", loopCount, currentState, counters.enqueues - enqueuedBefore, 0);
+    }
 
     bool isFinal = fst.Final(s) != StdFst::Weight::Zero() ? true : false;
     if (isFinal) {
@@ -103,8 +129,15 @@ vector<wer_alignment> Walker::walkComposed(IComposition &fst, SymbolTable &symbo
     if (heapB->size() > 0) {
       if (loopSinceLastPruning >= numberOfLoopsBeforePruning) {
         SLE a = heapB->GetBestWerCandidate().get();
-        heapB->prune(this->pruningHeapSizeTarget); 
+        auto sizeBeforePruning = heapB->size();
+        heapB->prune(this->pruningHeapSizeTarget);
+        counters.prunes++;
+        counters.prunedEntries += sizeBeforePruning - heapB->size();
         SLE b = heapB->GetBestWerCandidate().get();
+        if (trace) {
+          // located at the best path kept
+          TraceRow(fst, "prune", loopCount, *b, 0, sizeBeforePruning - heapB->size());
+        }
 
         if (logger->should_log(spdlog::level::debug)) {
           logger->debug(
@@ -127,6 +160,8 @@ vector<wer_alignment> Walker::walkComposed(IComposition &fst, SymbolTable &symbo
     heapB = heapTmp;
   }
 
+  sampleMemory();
+
   logger->info("we have {} candidates after {} loops", topEntries.size(), loopCount);
   if (topEntries.size() > 0) {
     int i = 0;
@@ -142,6 +177,35 @@ vector<wer_alignment> Walker::walkComposed(IComposition &fst, SymbolTable &symbo
   return topAlignments;
 }
 
+void Walker::RecordPerf(PerfStats &perf) const {
+  perf.Count("walkerStatesPopped", counters.statesPopped);
+  perf.Count("walkerEnqueues", counters.enqueues);
+  perf.Count("walkerPrunes", counters.prunes);
+  perf.Count("walkerPrunedEntries", counters.prunedEntries);
+  perf.Max("walkerHeapHighWater", counters.heapHighWater);
+  perf.Max("walkerLogbookSize", logbook.size());
+}
+
+void Walker::TraceRow(IComposition &fst, const char *event, int loop, const ShortlistEntry &entry, int64_t enqueued,
+                      int64_t pruned) {
+  StateId refA = -1;
+  StateId refB = -1;
+  fst.TryGetStatePair(entry.currentState, &refA, &refB);
+  *trace << event << ',' << loop << ',' << entry.currentState << ',' << refA << ',' << refB << ',' << entry.numWords
+         << ',' << entry.numErrors << ',' << entry.costSoFar << ',' << heapA->size() << ',' << heapB->size() << ','
+         << enqueued << ',' << pruned << '\n';
+}
+
+int64_t Walker::ApproxMemoryBytes(size_t numVisitedStates) const {
+  // the entries still referenced are the ones in the heaps and the paths leading to them, at
+  // most the ones enqueued and not pruned
+  int64_t liveEntries = 1 + counters.enqueues - counters.prunedEntries;
+  return liveEntries * ApproxSharedBytes(sizeof(ShortlistEntry)) +
+         (heapA->size() + heapB->size()) * ApproxTreeNodeBytes(sizeof(spSLE)) +
+         logbook.size() * ApproxTreeNodeBytes(sizeof(pair<const int, float>)) +
+         numVisitedStates * ApproxTreeNodeBytes(sizeof(int));
+}
+
 std::shared_ptr<ShortlistEntry> Walker::enqueueIfNeeded(std::shared_ptr<ShortlistEntry> currentState,
                                                         const MyArc& arc, bool isAnchor) {
   shared_ptr<ShortlistEntry> enqueued = nullptr;
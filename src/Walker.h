@@ -12,6 +12,7 @@ Walker.h
 #include "FstLoader.h"
 #include "IComposition.h"
 #include "PathHeap.h"
+#include "PerfStats.h"
 
 class Walker {
  public:
@@ -22,7 +23,28 @@ class Walker {
   int numberOfLoopsBeforePruning = 50;
   int pruningHeapSizeTarget = 20;
 
+  // adds the work of the last walk to the stats counters
+  void RecordPerf(PerfStats &perf) const;
+
+  // while walking, the approximate memory of the heaps, the logbook and the composed
+  // states is held in these stats, when given
+  PerfStats *memory_stats = nullptr;
+
+  // when given, the state expansions and heap prunings of the walks are written to it, one
+  // CSV row each, for fstalign_trace_summary
+  std::ostream *trace = nullptr;
+
  private:
+  // what the last walk did
+  struct Counters {
+    int64_t statesPopped = 0;
+    int64_t enqueues = 0;
+    int64_t prunes = 0;
+    int64_t prunedEntries = 0;
+    int64_t heapHighWater = 0;
+  };
+  Counters counters;
+
   map<int, float> logbook;
   PathHeap _heapA;
   PathHeap _heapB;
@@ -30,6 +52,10 @@ class Walker {
   PathHeap *heapB;
   std::shared_ptr<spdlog::logger> logger;
 
+  int64_t ApproxMemoryBytes(size_t numVisitedStates) const;
+  void TraceRow(IComposition &fst, const char *event, int loop, const ShortlistEntry &entry, int64_t enqueued,
+                int64_t pruned);
+
   std::shared_ptr<ShortlistEntry> enqueueIfNeeded(std::shared_ptr<ShortlistEntry> currentStatePtr,
                                                   const MyArc& arc_ptr, bool isAnchor);
   wer_alignment GetDetailsFromTopCandidates(ShortlistEntry &currentState, SymbolTable &symbol,
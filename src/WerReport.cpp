@@ -0,0 +1,223 @@
+/*
+ * WerReport.cpp
+ */
+
+#include "WerReport.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+void RecordWerResult(Json::Value &json, const WerResult &wr) {
+  json["insertions"] = wr.insertions;
+  json["deletions"] = wr.deletions;
+  json["substitutions"] = wr.substitutions;
+  json["numWordsInReference"] = wr.numWordsInReference;
+  json["numErrors"] = wr.NumErrors();
+  json["wer"] = wr.WER();
+}
+
+// members are written in the sorted order jsoncpp used for the same sections
+
+static void WriteWerResult(JsonWriter &writer, const WerResult &wr, bool with_meta = true) {
+  writer.BeginObject();
+  writer.Member("deletions", wr.deletions);
+  writer.Member("insertions", wr.insertions);
+  if (with_meta) {
+    writer.Key("meta");
+    writer.BeginObject();
+    writer.EndObject();
+  }
+  writer.Member("numErrors", wr.NumErrors());
+  writer.Member("numWordsInReference", wr.numWordsInReference);
+  writer.Member("substitutions", wr.substitutions);
+  writer.Member("wer", wr.WER());
+  writer.EndObject();
+}
+
+static void WriteWerResults(JsonWriter &writer, const std::map<string, WerResult> &results) {
+  writer.BeginObject();
+  for (auto &a : results) {
+    writer.Key(a.first);
+    WriteWerResult(writer, a.second);
+  }
+  writer.EndObject();
+}
+
+static void WriteCaseWerResult(JsonWriter &writer, const CaseWerResult &cr) {
+  writer.BeginObject();
+  writer.Member("false_negative", cr.false_negative);
+  writer.Member("false_positive", cr.false_positive);
+  writer.Member("precision", cr.precision);
+  writer.Member("recall", cr.recall);
+  writer.Member("true_positive", cr.true_positive);
+  writer.EndObject();
+}
+
+static void WriteGramCounter(JsonWriter &writer, const gram_error_counter &u) {
+  writer.Member("correct", u.correct);
+  writer.Member("deletions", u.del);
+  writer.Member("insertions", u.ins);
+  writer.Member("precision", u.precision);
+  writer.Member("recall", u.recall);
+  writer.Member("substitutions_fn", u.subst_fn);
+  writer.Member("substitutions_fp", u.subst_fp);
+}
+
+// the stats are ordered from the least precise n-gram, they're written sorted by n-gram
+static vector<const pair<string, gram_error_counter> *> SortedGramStats(
+    const vector<pair<string, gram_error_counter>> &stats) {
+  vector<const pair<string, gram_error_counter> *> sorted;
+  sorted.reserve(stats.size());
+  for (const auto &a : stats) {
+    sorted.push_back(&a);
+  }
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const pair<string, gram_error_counter> *a, const pair<string, gram_error_counter> *b) {
+                     return a->first < b->first;
+                   });
+  return sorted;
+}
+
+static void WriteGramStats(JsonWriter &writer, const vector<pair<string, gram_error_counter>> &stats) {
+  writer.BeginObject();
+  for (const auto *a : SortedGramStats(stats)) {
+    writer.Key(a->first);
+    writer.BeginObject();
+    WriteGramCounter(writer, a->second);
+    writer.EndObject();
+  }
+  writer.EndObject();
+}
+
+void WerReport::Write(JsonWriter &writer, bool with_ngrams) const {
+  bool has_ngrams = with_ngrams && (!unigrams.empty() || !bigrams.empty());
+  if (!has_best_wer && sentence_wer.empty() && speaker_wer.empty() && tag_wer.empty() && !has_speaker_switch_wer &&
+      !has_case_wer && !has_ngrams && perf.empty()) {
+    writer.Null();
+    return;
+  }
+
+  writer.BeginObject();
+  if (!perf.empty()) {
+    writer.Key("perf");
+    perf.Write(writer);
+  }
+  writer.Key("wer");
+  writer.BeginObject();
+
+  if (has_best_wer) {
+    writer.Key("bestWER");
+    writer.BeginObject();
+    writer.Member("deletions", best_wer.deletions);
+    writer.Member("insertions", best_wer.insertions);
+    writer.Key("meta");
+    writer.BeginObject();
+    writer.EndObject();
+    writer.Member("numErrors", best_wer.NumErrors());
+    writer.Member("numWordsInReference", best_wer.numWordsInReference);
+    writer.Member("precision", best_precision);
+    writer.Member("recall", best_recall);
+    writer.Member("substitutions", best_wer.substitutions);
+    writer.Member("wer", best_wer_value);
+    writer.EndObject();
+  }
+  if (with_ngrams && !bigrams.empty()) {
+    writer.Key("bigrams");
+    WriteGramStats(writer, bigrams);
+  }
+  if (has_case_wer) {
+    writer.Key("caseWER");
+    writer.BeginObject();
+    writer.Key("all");
+    WriteCaseWerResult(writer, case_all);
+    writer.Key("matching");
+    WriteCaseWerResult(writer, case_matching);
+    writer.EndObject();
+  }
+  if (has_best_wer) {
+    writer.Key("classWER");
+    WriteWerResults(writer, class_wer);
+  }
+  if (!sentence_wer.empty()) {
+    writer.Key("sentenceWer");
+    writer.BeginArray();
+    for (auto &wr : sentence_wer) {
+      WriteWerResult(writer, wr, false);
+    }
+    writer.EndArray();
+  }
+  if (has_speaker_switch_wer) {
+    writer.Key("speakerSwitchWER");
+    writer.BeginObject();
+    writer.Member("deletions", speaker_switch_wer.deletions);
+    writer.Member("insertions", speaker_switch_wer.insertions);
+    writer.Key("meta");
+    writer.BeginObject();
+    writer.Member("windowSize", speaker_switch_window_size);
+    writer.EndObject();
+    writer.Member("numErrors", speaker_switch_wer.NumErrors());
+    writer.Member("numWordsInReference", speaker_switch_wer.numWordsInReference);
+    writer.Member("substitutions", speaker_switch_wer.substitutions);
+    writer.Member("wer", speaker_switch_wer.WER());
+    writer.EndObject();
+  }
+  if (!speaker_wer.empty()) {
+    writer.Key("speakerWER");
+    WriteWerResults(writer, speaker_wer);
+  }
+  if (with_ngrams && !unigrams.empty()) {
+    writer.Key("unigrams");
+    WriteGramStats(writer, unigrams);
+  }
+  if (!tag_wer.empty()) {
+    writer.Key("wer_tag");
+    WriteWerResults(writer, tag_wer);
+  }
+
+  writer.EndObject();
+  writer.EndObject();
+}
+
+void WerReport::WriteNgramStats(std::ostream &out) const {
+  for (auto section : {make_pair("unigram", &unigrams), make_pair("bigram", &bigrams)}) {
+    for (const auto *a : SortedGramStats(*section.second)) {
+      JsonWriter writer(out, false);
+      writer.BeginObject();
+      writer.Member("type", section.first);
+      writer.Member("gram", a->first);
+      WriteGramCounter(writer, a->second);
+      writer.EndObject();
+      out << '\n';
+    }
+  }
+}
+
+void WerReport::WriteJsonLog(const string &filename, const string &ngrams_filename) const {
+  auto json_file = OpenOutput(filename);
+  JsonWriter writer(*json_file);
+  Write(writer, ngrams_filename.empty());
+  *json_file << std::endl;
+
+  if (!ngrams_filename.empty()) {
+    auto ngrams_file = OpenOutput(ngrams_filename);
+    WriteNgramStats(*ngrams_file);
+    ngrams_file->flush();
+  }
+}
+
+Json::Value WerReport::BestWerToJson() const {
+  Json::Value best;
+  if (!has_best_wer) {
+    return best;
+  }
+  best["wer"] = best_wer_value;
+  best["numErrors"] = best_wer.NumErrors();
+  best["numWordsInReference"] = best_wer.numWordsInReference;
+  best["insertions"] = best_wer.insertions;
+  best["deletions"] = best_wer.deletions;
+  best["substitutions"] = best_wer.substitutions;
+  best["precision"] = best_precision;
+  best["recall"] = best_recall;
+  best["meta"] = Json::objectValue;
+  return best;
+}
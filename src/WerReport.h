@@ -0,0 +1,94 @@
+/*
+ * WerReport.h
+ *
+ * Results of one alignment job.  The Record* functions of wer.h fill the typed
+ * figures, which are streamed once, into the --json-log schema, at the end.
+ *
+ */
+
+#ifndef __WER_REPORT_H__
+#define __WER_REPORT_H__
+
+#include <json/json.h>
+
+#include <map>
+
+#include "JsonWriter.h"
+#include "PerfStats.h"
+#include "utilities.h"
+
+struct WerResult {
+  int insertions;
+  int deletions;
+  int substitutions;
+  int numWordsInReference;
+  int numWordsInHypothesis;
+  int NumErrors() const { return insertions + substitutions + deletions; }
+  /* can return infinity if numWordsInReference == 0 and numWordsInHypothesis > 0 */
+  float WER() const {
+    if (numWordsInReference > 0) {
+      return (float)(insertions + deletions + substitutions) / (float)numWordsInReference;
+    }
+
+    if (numWordsInHypothesis > 0) {
+      return numeric_limits<float>::infinity();
+    }
+
+    return -nanf("");
+  }
+};
+
+struct CaseWerResult {
+  float precision;
+  float recall;
+  int true_positive;
+  int false_positive;
+  int false_negative;
+};
+
+class WerReport {
+ public:
+  // bestWER and classWER, set by RecordWer()
+  bool has_best_wer = false;
+  WerResult best_wer = {0, 0, 0, 0, 0};
+  // the WER of the alignment itself (wer_alignment::WER()): 0 when both inputs are empty,
+  // infinity when only the reference is, where WerResult::WER() would give NaN and infinity
+  float best_wer_value = 0;
+  precision_t best_precision = 0;
+  recall_t best_recall = 0;
+  std::map<string, WerResult> class_wer;
+
+  std::vector<WerResult> sentence_wer;
+  std::map<string, WerResult> speaker_wer;
+  std::map<string, WerResult> tag_wer;
+
+  bool has_speaker_switch_wer = false;
+  WerResult speaker_switch_wer = {0, 0, 0, 0, 0};
+  int speaker_switch_window_size = 0;
+
+  bool has_case_wer = false;
+  CaseWerResult case_matching = {0, 0, 0, 0, 0};
+  CaseWerResult case_all = {0, 0, 0, 0, 0};
+
+  vector<pair<string, gram_error_counter>> unigrams;
+  vector<pair<string, gram_error_counter>> bigrams;
+
+  // where the time of the job went, and how much work the alignment did
+  PerfStats perf;
+
+  // Streams the report as one JSON value, null when nothing was recorded.  The n-gram
+  // stats can be left out, e.g. when they go to their own file.
+  void Write(JsonWriter &writer, bool with_ngrams = true) const;
+  // one compact JSON object per unigram or bigram
+  void WriteNgramStats(std::ostream &out) const;
+  // writes the --json-log file, and the n-gram stats to ngrams_filename instead when given
+  void WriteJsonLog(const string &filename, const string &ngrams_filename = "") const;
+
+  // the bestWER section alone, for batch summaries
+  Json::Value BestWerToJson() const;
+};
+
+// writes the insertions, deletions, substitutions, reference words, errors and WER
+void RecordWerResult(Json::Value &json, const WerResult &wr);
+
+#endif  // __WER_REPORT_H__
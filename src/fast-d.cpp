@@ -284,6 +284,70 @@ int GetEditDistanceOnly(std::vector<int> &seqA, std::vector<int> &seqB) {
   return distance[lengthA];
 }
 
+std::vector<EditOperation> GetEditOperations(const std::vector<int> &seqA, const std::vector<int> &seqB,
+                                             int insCost, int delCost, int subCost) {
+  int lengthA = seqA.size();
+  int lengthB = seqB.size();
+  int width = lengthB + 1;
+
+  // backtracking info, one operation per cell
+  std::vector<unsigned char> moves((size_t)(lengthA + 1) * width);
+  std::vector<int> distance(width);
+  std::vector<int> distancePrev(width);
+
+  for (int j = 0; j <= lengthB; ++j) {
+    distance[j] = j * insCost;
+    moves[j] = EDIT_INS;
+  }
+
+  for (int i = 1; i <= lengthA; ++i) {
+    std::swap(distance, distancePrev);
+    distance[0] = i * delCost;
+    moves[(size_t)i * width] = EDIT_DEL;
+
+    for (int j = 1; j <= lengthB; ++j) {
+      bool is_match = seqA[i - 1] == seqB[j - 1];
+      int best = distancePrev[j - 1] + (is_match ? 0 : subCost);
+      unsigned char move = is_match ? EDIT_MATCH : EDIT_SUB;
+
+      int del = distancePrev[j] + delCost;
+      if (del < best) {
+        best = del;
+        move = EDIT_DEL;
+      }
+
+      int ins = distance[j - 1] + insCost;
+      if (ins < best) {
+        best = ins;
+        move = EDIT_INS;
+      }
+
+      distance[j] = best;
+      moves[(size_t)i * width + j] = move;
+    }
+  }
+
+  std::vector<EditOperation> ops;
+  ops.reserve(std::max(lengthA, lengthB));
+  int i = lengthA;
+  int j = lengthB;
+  while (i > 0 || j > 0) {
+    EditOperation op = (EditOperation)moves[(size_t)i * width + j];
+    ops.push_back(op);
+    if (op == EDIT_INS) {
+      j--;
+    } else if (op == EDIT_DEL) {
+      i--;
+    } else {
+      i--;
+      j--;
+    }
+  }
+
+  std::reverse(ops.begin(), ops.end());
+  return ops;
+}
+
 bool MapContainsErrorStreaks(std::vector<int> map, int streak_cutoff) {
   int seq_cnt = 0;
   int bad_match_seq_cnt = 0;
@@ -26,6 +26,15 @@ int GetEditDistance(std::vector<int> &seqA, std::vector<int> &mapA, std::vector<
 // This is a memory optimized version and is quite fast.
 int GetEditDistanceOnly(std::vector<int> &seqA, std::vector<int> &seqB);
 
+enum EditOperation { EDIT_MATCH, EDIT_SUB, EDIT_INS, EDIT_DEL };
+
+// returns the sequence of edit operations that transforms seqA into seqB with the minimum cost.
+// EDIT_INS means a token of seqB that isn't in seqA, EDIT_DEL a token of seqA that isn't in seqB.
+// On ties, substitutions are preferred over deletions, and deletions over insertions.
+// Only one byte per cell of the seqA.size()*seqB.size() matrix is kept for the backtracking.
+std::vector<EditOperation> GetEditOperations(const std::vector<int> &seqA, const std::vector<int> &seqB,
+                                             int insCost = 2, int delCost = 2, int subCost = 3);
+
 // Returns whether map contains long error streaks.
 bool MapContainsErrorStreaks(std::vector<int> map, int streak_cutoff);
 
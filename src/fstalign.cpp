@@ -8,15 +8,26 @@ fstalign.cpp
 #include "fstalign.h"
 
 #include <stdio.h>
+#include <sys/stat.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
 
 #include <spdlog/fmt/fmt.h>
 
 #include "AdaptedComposition.h"
+#include "CompiledReference.h"
+#include "FstFileLoader.h"
+#include "MemoryUsage.h"
 #include "OneBestFstLoader.h"
+#include "PerfStats.h"
 #include "StandardComposition.h"
+#include "TaskGraph.h"
+#include "ThreadPool.h"
 #include "Walker.h"
 #include "fast-d.h"
-#include "json_logging.h"
 #include "utilities.h"
 #include "wer.h"
 
@@ -25,156 +36,346 @@ using namespace fst;
 
 #define debug_levenstein false
 
-// Compare class for comparing output labels of arcs.
-template <class Arc>
-class ReverseOLabelCompare {
- public:
-  constexpr ReverseOLabelCompare() {}
+bool sort_alignment(const wer_alignment& a, const wer_alignment &b) { return a.WER() < b.WER(); }
 
-  constexpr bool operator()(const Arc &lhs, const Arc &rhs) const {
-    return std::forward_as_tuple(lhs.olabel, lhs.ilabel) > std::forward_as_tuple(rhs.olabel, rhs.ilabel);
+// below this many ref and hyp tokens, the preparation steps run in order on the calling thread
+const size_t kMinParallelPreparationTokens = 2000;
+
+// Plain text and CTM loaders produce linear FSTs.  Without synonyms, normalizations or
+// class labels, the composition and the walk reduce to a plain edit distance alignment.
+bool CanUseLevenshteinFastPath(FstLoader &refLoader, FstLoader &hypLoader, SynonymEngine &engine,
+                               const AlignerOptions &alignerOptions) {
+  auto is_linear = [](FstLoader &loader) {
+    return dynamic_cast<OneBestFstLoader *>(&loader) != nullptr || dynamic_cast<CtmFstLoader *>(&loader) != nullptr;
+  };
+
+  // a trace is of the walk
+  if (!alignerOptions.levenshtein_fast_path || !alignerOptions.symbols_filename.empty() ||
+      !alignerOptions.walker_trace_filename.empty()) {
+    return false;
   }
 
-  constexpr uint64 Properties(uint64 props) const {
-    return (props & kArcSortProperties) | kOLabelSorted | (props & kAcceptor ? kILabelSorted : 0);
+  // the backtrace reproduces the walk with the default search settings only
+  if (alignerOptions.numBests != kDefaultNumBests ||
+      alignerOptions.heapPruningTarget != AlignerOptions().heapPruningTarget ||
+      alignerOptions.composition_approach != "adapted") {
+    return false;
   }
-};
 
-using StdReverseOlabelCompare = ReverseOLabelCompare<StdArc>;
+  return is_linear(refLoader) && is_linear(hypLoader) && !engine.HasRules();
+}
 
-bool sort_alignment(const wer_alignment& a, const wer_alignment &b) { return a.WER() < b.WER(); }
+// the tokens must not trigger generated synonyms nor be labels with a special
+// meaning for the walker
+bool VocabularyAllowsLevenshteinFastPath(SynonymEngine &engine, const SymbolTable &vocab, const vector<int> &vA,
+                                         const vector<int> &vB) {
+  FstAlignOption options;
+  std::unordered_set<string> special_symbols = {options.symEps, options.symDel, options.symIns, options.symSub,
+                                                options.symOov};
+  std::unordered_set<int> seen;
+  for (auto ids : {&vA, &vB}) {
+    for (int id : *ids) {
+      if (!seen.insert(id).second) {
+        continue;
+      }
+      auto token = vocab.Find(id);
+      if (isEntityLabel(token) || engine.GeneratesSynonymsFor(token) ||
+          special_symbols.find(token) != special_symbols.end()) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+// builds the alignment the same way Walker::GetDetailsFromTopCandidates() does, but
+// straight from the edit operations
+wer_alignment GetAlignmentFromEditOperations(const vector<EditOperation> &ops, const vector<int> &vA,
+                                             const vector<int> &vB, const SymbolTable &vocab) {
+  wer_alignment alignment;
+  int posA = 0;
+  int posB = 0;
+  for (auto op : ops) {
+    if (op == EDIT_INS) {
+      string olabel = vocab.Find(vB[posB++]);
+      alignment.insertions++;
+      alignment.numWordsInHypothesis++;
+      alignment.hyp_words.push_back(olabel);
+      alignment.ref_words.push_back(INS);
+      alignment.ins_words.push_back(olabel);
+      alignment.tokens.push_back(make_pair(INS, olabel));
+    } else if (op == EDIT_DEL) {
+      string ilabel = vocab.Find(vA[posA++]);
+      alignment.deletions++;
+      alignment.numWordsInReference++;
+      alignment.ref_words.push_back(ilabel);
+      alignment.hyp_words.push_back(DEL);
+      alignment.del_words.push_back(ilabel);
+      alignment.tokens.push_back(make_pair(ilabel, DEL));
+    } else {
+      string ilabel = vocab.Find(vA[posA++]);
+      string olabel = vocab.Find(vB[posB++]);
+      alignment.numWordsInReference++;
+      alignment.numWordsInHypothesis++;
+      alignment.ref_words.push_back(ilabel);
+      alignment.hyp_words.push_back(olabel);
+      if (op == EDIT_SUB) {
+        alignment.substitutions++;
+        alignment.sub_words.push_back(make_pair(ilabel, olabel));
+      }
+      alignment.tokens.push_back(make_pair(ilabel, olabel));
+    }
+  }
 
-wer_alignment Fstalign(FstLoader& refLoader, FstLoader& hypLoader, SynonymEngine &engine, const AlignerOptions& alignerOptions) {
+  return alignment;
+}
+
+// the time and work of the steps are added to perf when given
+wer_alignment Fstalign(FstLoader& refLoader, FstLoader& hypLoader, SynonymEngine &engine, const AlignerOptions& alignerOptions,
+                       PerfStats *perf = nullptr) {
   //  int numBests, string symbols_filename, string composition_approach, bool levenstein_first_pass) {
   auto logger = logger::GetOrCreateLogger("fstalign");
+
+  PerfStats unused_perf;
+  auto &stats = perf ? *perf : unused_perf;
+  stats.SetMemoryLimit(alignerOptions.memory_limit_bytes);
+  // the steps outside of the task graph
+  auto timed = [&stats](const string &name, const std::function<void()> &step) {
+    auto start = std::chrono::steady_clock::now();
+    step();
+    stats.AddPreparationTime(name, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+  };
+
+  // a compiled reference comes with its symbols, fst and synonyms already prepared
+  const CompiledReference *compiled = refLoader.getCompiledReference();
+
   FstAlignOption options;
   SymbolTable symbol;
-  if (!alignerOptions.symbols_filename.empty()) {
+  std::vector<int> vA;
+  std::vector<int> vB;
+  if (compiled) {
+    if (!alignerOptions.symbols_filename.empty()) {
+      logger->warn("the symbols of the compiled reference are used, ignoring {}", alignerOptions.symbols_filename);
+    }
+    // The compiled fst only serves hypotheses made of reference words.  Other words would
+    // have come before the synonym symbols in a direct run and can bring rules of their
+    // own, which changes the labels and so the ties of the walk.
+    symbol = *compiled->symbols;
+    SymbolInterner hyp_vocab(symbol);
+    timed("hypTokens", [&]() {
+      logger->info("converting hyp to int vector");
+      vB = hypLoader.convertToIntVector(hyp_vocab);
+    });
+    if (!compiled->CoversHypothesis(symbol, vB)) {
+      logger->info("the hyp has words the compiled ref doesn't know, preparing the ref from its tokens");
+      stats.Count("compiledReferenceFallback");
+      symbol = compiled->ReferenceSymbols();
+      vB.clear();
+      compiled = nullptr;
+    }
+  } else if (!alignerOptions.symbols_filename.empty()) {
     std::ifstream strm(alignerOptions.symbols_filename, std::ios_base::in);
     symbol = *(SymbolTable::ReadText(strm, "symbols"));
   } else {
     symbol = SymbolTable("symbols");
   }
   options.RegisterSymbols(symbol);
+  bool hyp_interned = compiled != nullptr;
+
+  // every token is interned once, the ids serve the levenshtein pass and the fst construction
+  SymbolInterner vocab(symbol);
+  timed("refTokens", [&]() {
+    logger->info("converting ref to int vector");
+    vA = compiled ? compiled->token_ids : refLoader.convertToIntVector(vocab);
+  });
+  if (!hyp_interned) {
+    timed("hypTokens", [&]() {
+      logger->info("converting hyp to int vector");
+      vB = hypLoader.convertToIntVector(vocab);
+    });
+  }
+  logger->debug("vA size is {}, vB size is {}", vA.size(), vB.size());
+  stats.Count("refTokens", vA.size());
+  stats.Count("hypTokens", vB.size());
+  // each step charges what it builds as soon as it has built it, so --memory-limit
+  // stops a runaway preparation and names the step that took it over
+  ScopedMemoryHold symbols_memory(&stats, "symbols");
+  symbols_memory.Update(ApproxBytes(symbol));
+  ScopedMemoryHold tokens_memory(&stats, "tokens");
+  tokens_memory.Update(ApproxBytes(vA) + ApproxBytes(vB));
+
+  if (CanUseLevenshteinFastPath(refLoader, hypLoader, engine, alignerOptions)) {
+    if (VocabularyAllowsLevenshteinFastPath(engine, symbol, vA, vB)) {
+      logger->info("linear inputs without synonyms, using the levenshtein fast path for {} ref and {} hyp tokens",
+                   vA.size(), vB.size());
+      // same costs as the composition: ins/del cost 1, substitutions 1.5
+      ScopedPhaseTimer timer(perf, "levenshteinFastPath");
+      stats.Count("levenshteinFastPath");
+      auto ops = GetEditOperations(vA, vB, 2, 2, 3);
+      return GetAlignmentFromEditOperations(ops, vA, vB, symbol);
+    }
+    logger->info("the vocabulary requires the full fst alignment, skipping the levenshtein fast path");
+  }
 
   std::vector<int> mapA;
   std::vector<int> mapB;
-
+  fst::StdVectorFst refFst;
+  fst::StdVectorFst hypFst;
+  vector<SynKey> new_rules;
+  size_t synonym_arcs = 0;
+  ScopedMemoryHold levenshtein_memory(&stats, "levenshteinMaps");
+  ScopedMemoryHold ref_fst_memory(&stats, "refFst");
+  ScopedMemoryHold hyp_fst_memory(&stats, "hypFst");
+
+  // The levenshtein pass and the synonym rules generation only need the tokens.  The
+  // fsts need the levenshtein maps, but only read the interned ids through the const
+  // vocabulary (see FstLoader::convertToFst()), so the rules can add their words to the
+  // symbol table while the fsts are built.
+  TaskGraph preparation;
+  vector<TaskGraph::TaskId> after_levenshtein;
   if (alignerOptions.levenstein_first_pass) {
-    fst::SymbolTable levensteinn_sym;
-    logger->info("starting conversion to int vector");
-    logger->info("converting ref to int vector");
-    std::vector<int> vA = refLoader.convertToIntVector(levensteinn_sym);
-
-    logger->info("converting hyp to int vector");
-    std::vector<int> vB = hypLoader.convertToIntVector(levensteinn_sym);
-    logger->debug("vA size is {}, vB size is {}", vA.size(), vB.size());
-
-    int dist = 0;
-    if (vA.size() > 10 && vB.size() > 10) {
-      dist = GetEditDistance(vA, mapA, vB, mapB);
-      logger->debug("vA size is {}, vB size is {}, edit distance is {}, mapA size is {}, mapB size is {}", vA.size(),
-                    vB.size(), dist, mapA.size(), mapB.size());
-
-      int dist_prime = dist;
-
-      // We'll relax the matches a bit.  if one word is marked to be forcefully aligned
-      // but the words before and after are possible errors, we'll let this word be
-      // possibly an error as well.
-
-      for (int x = 1; x < mapA.size() - 1; x++) {
-        if (mapA[x - 1] < 0 && mapA[x + 1] < 0) {
-          dist_prime++;
-          mapA[x] = -1;
+    after_levenshtein.push_back(preparation.Add("levenshtein", [&]() {
+      int dist = 0;
+      if (vA.size() > 10 && vB.size() > 10) {
+        dist = GetEditDistance(vA, mapA, vB, mapB);
+        logger->debug("vA size is {}, vB size is {}, edit distance is {}, mapA size is {}, mapB size is {}", vA.size(),
+                      vB.size(), dist, mapA.size(), mapB.size());
+
+        int dist_prime = dist;
+
+        // We'll relax the matches a bit.  if one word is marked to be forcefully aligned
+        // but the words before and after are possible errors, we'll let this word be
+        // possibly an error as well.
+
+        for (int x = 1; x < mapA.size() - 1; x++) {
+          if (mapA[x - 1] < 0 && mapA[x + 1] < 0) {
+            dist_prime++;
+            mapA[x] = -1;
+          }
+        }
+        for (int x = 1; x < mapB.size() - 2; x++) {
+          if (mapB[x - 1] < 0 && mapB[x + 1] < 0) {
+            mapB[x] = -1;
+          }
         }
+
+        logger->info("Estimated edit distance : {} / {} ({} edits originally)", dist_prime, vA.size(), dist);
+      } else {
+        logger->info(
+            "Either ref or hyp is really small, skipping over the levenstein distance,  ref size: {}, hyp size: {}",
+            vA.size(), vB.size());
       }
-      for (int x = 1; x < mapB.size() - 2; x++) {
-        if (mapB[x - 1] < 0 && mapB[x + 1] < 0) {
-          mapB[x] = -1;
+#if debug_levensten
+      int seq_cnt = 0;
+      int seq_no = 0;
+      int good_match = 0;
+      int seq_start = -1;
+      logger->info("mapA");
+      for (int x = 0; x < mapA.size() - 1; x++) {
+        if (mapA[x] > 0) {
+          good_match++;
+          seq_cnt++;
+          if (seq_start < 0) {
+            seq_start = x;
+          }
+        } else if (seq_cnt > 0) {
+          seq_no++;
+          logger->info("streak no {} has {} items, from {} to {}", seq_no, seq_cnt, seq_start, x - 1);
+          seq_cnt = 0;
+          seq_start = -1;
         }
       }
+      if (seq_cnt > 0) {
+        seq_no++;
+        logger->info("streak no {} has {} items, from {} to {}", seq_no, seq_cnt, seq_start, vA.size() - 1);
+      }
+      logger->info("total good items: {}", good_match);
 
-      logger->info("Estimated edit distance : {} / {} ({} edits originally)", dist_prime, vA.size(), dist);
-    } else {
-      logger->info(
-          "Either ref or hyp is really small, skipping over the levenstein distance,  ref size: {}, hyp size: {}",
-          vA.size(), vB.size());
-    }
-  }
-
-#if debug_levensten
-  int seq_cnt = 0;
-  int seq_no = 0;
-  int good_match = 0;
-  int seq_start = -1;
-  logger->info("mapA");
-  for (int x = 0; x < mapA.size() - 1; x++) {
-    if (mapA[x] > 0) {
-      good_match++;
-      seq_cnt++;
-      if (seq_start < 0) {
-        seq_start = x;
-      }
-    } else if (seq_cnt > 0) {
-      seq_no++;
-      logger->info("streak no {} has {} items, from {} to {}", seq_no, seq_cnt, seq_start, x - 1);
       seq_cnt = 0;
+      seq_no = 0;
+      good_match = 0;
       seq_start = -1;
-    }
-  }
-  if (seq_cnt > 0) {
-    seq_no++;
-    logger->info("streak no {} has {} items, from {} to {}", seq_no, seq_cnt, seq_start, vA.size() - 1);
-  }
-  logger->info("total good items: {}", good_match);
-
-  seq_cnt = 0;
-  seq_no = 0;
-  good_match = 0;
-  seq_start = -1;
-  logger->info("mapB");
-  for (int x = 0; x < mapB.size() - 1; x++) {
-    if (mapB[x] > 0) {
-      good_match++;
-      seq_cnt++;
-      if (seq_start < 0) {
-        seq_start = x;
+      logger->info("mapB");
+      for (int x = 0; x < mapB.size() - 1; x++) {
+        if (mapB[x] > 0) {
+          good_match++;
+          seq_cnt++;
+          if (seq_start < 0) {
+            seq_start = x;
+          }
+        } else if (seq_cnt > 0) {
+          seq_no++;
+          logger->info("streak no {} has {} items, from {} to {}", seq_no, seq_cnt, seq_start, x - 1);
+          seq_cnt = 0;
+          seq_start = -1;
+        }
       }
-    } else if (seq_cnt > 0) {
-      seq_no++;
-      logger->info("streak no {} has {} items, from {} to {}", seq_no, seq_cnt, seq_start, x - 1);
-      seq_cnt = 0;
-      seq_start = -1;
-    }
-  }
-  if (seq_cnt > 0) {
-    seq_no++;
-    logger->info("streak no {} has {} items, from {} to {}", seq_no, seq_cnt, seq_start, vA.size() - 1);
-  }
-  logger->info("total good items: {}", good_match);
+      if (seq_cnt > 0) {
+        seq_no++;
+        logger->info("streak no {} has {} items, from {} to {}", seq_no, seq_cnt, seq_start, vA.size() - 1);
+      }
+      logger->info("total good items: {}", good_match);
 #endif
 
-  refLoader.addToSymbolTable(symbol);
-  hypLoader.addToSymbolTable(symbol);
+      if (MapContainsErrorStreaks(mapB, alignerOptions.levenstein_maximum_error_streak)) {
+        // Only use map if it is safe for composition, only checking hypothesis map for now
+        logger->info("Not using levenshtein pre-computation - error streak longer than {}",
+                     alignerOptions.levenstein_maximum_error_streak);
+        mapA.clear();
+        mapB.clear();
+      }
+      levenshtein_memory.Update(ApproxBytes(mapA) + ApproxBytes(mapB));
+    }));
+  }
 
-  fst::StdVectorFst refFst;
-  fst::StdVectorFst hypFst;
-  if (MapContainsErrorStreaks(mapB, alignerOptions.levenstein_maximum_error_streak)) {
-    // Only use map if it is safe for composition, only checking hypothesis map for now
-    logger->info("Not using levenshtein pre-computation - error streak longer than {}",
-                 alignerOptions.levenstein_maximum_error_streak);
-    refFst = refLoader.convertToFst(symbol, {});
-    hypFst = hypLoader.convertToFst(symbol, {});
-  } else {
-    refFst = refLoader.convertToFst(symbol, mapA);
-    hypFst = hypLoader.convertToFst(symbol, mapB);
+  // the rules of a compiled reference were generated and applied when compiling it
+  vector<TaskGraph::TaskId> before_ref_synonyms;
+  if (!compiled) {
+    before_ref_synonyms.push_back(preparation.Add("synonymRules", [&]() {
+      logger->info("generating ref synonyms from symbol table");
+      new_rules = engine.GenerateSynFromSymbolTable(symbol);
+      // the only step adding symbols, the fst steps only read the interned ids
+      symbols_memory.Update(ApproxBytes(symbol));
+    }));
   }
 
-  logger->info("generating ref synonyms from symbol table");
-  engine.GenerateSynFromSymbolTable(symbol);
-  logger->info("applying ref synonyms on ref fst");
-  engine.ApplyToFst(refFst, symbol);
-  ArcSort(&refFst, StdILabelCompare());
+  before_ref_synonyms.push_back(preparation.Add("refFst", [&]() {
+    if (compiled) {
+      // a copy on write of the shared compiled fst
+      refFst = *compiled->fst;
+      compiled->ApplyLevenshteinMap(refFst, mapA);
+    } else {
+      refFst = refLoader.convertToFst(vocab, vA, mapA);
+    }
+    ref_fst_memory.Update(ApproxBytes(refFst));
+  }, after_levenshtein));
+
+  preparation.Add("hypFst", [&]() {
+    hypFst = hypLoader.convertToFst(vocab, vB, mapB);
+    hyp_fst_memory.Update(ApproxBytes(hypFst));
+  }, after_levenshtein);
+
+  preparation.Add("refSynonyms", [&]() {
+    if (!compiled) {
+      logger->info("applying ref synonyms on ref fst");
+      synonym_arcs = engine.ApplyToFst(refFst, symbol);
+    }
+    ArcSort(&refFst, StdILabelCompare());
+    ref_fst_memory.Update(ApproxBytes(refFst));
+  }, before_ref_synonyms);
+
+  // starting the threads costs more than the steps of short inputs
+  bool parallel = vA.size() + vB.size() >= kMinParallelPreparationTokens;
+  preparation.Run(parallel ? alignerOptions.preparation_threads : 1);
+  for (auto &timing : preparation.Timings()) {
+    stats.AddPreparationTime(timing.first, timing.second);
+  }
+  stats.Count("synonymRulesGenerated", new_rules.size());
+  stats.Count("synonymArcs", synonym_arcs);
+  stats.Count("symbols", symbol.NumSymbols());
+  stats.Count("refFstStates", refFst.NumStates());
+  stats.Count("hypFstStates", hypFst.NumStates());
 
   logger->info("printing ref fst");
   if (refFst.NumStates() > 100) {
@@ -193,19 +394,35 @@ wer_alignment Fstalign(FstLoader& refLoader, FstLoader& hypLoader, SynonymEngine
   vector<wer_alignment> best_alignments;
   Walker walker;
   walker.pruningHeapSizeTarget = alignerOptions.heapPruningTarget;
+  walker.memory_stats = &stats;
+  std::unique_ptr<std::ostream> trace;
+  if (!alignerOptions.walker_trace_filename.empty()) {
+    logger->info("writing the walker trace to {}", alignerOptions.walker_trace_filename);
+    trace = OpenOutput(alignerOptions.walker_trace_filename);
+    walker.trace = trace.get();
+  }
   if (alignerOptions.composition_approach == "standard") {
     StandardCompositionFst composed_fst(refFst, hypFst, symbol);
+    ScopedPhaseTimer timer(perf, "walk");
     best_alignments = walker.walkComposed(composed_fst, symbol, options, alignerOptions.numBests);
   } else if (alignerOptions.composition_approach == "adapted") {
-    RmEpsilon(&refFst, true);
-    ReverseOLabelCompare<StdArc> comparer;
-    ArcSort(&refFst, comparer);
+    timed("refEpsilonRemoval", [&]() {
+      RmEpsilon(&refFst, true);
+      ReverseOLabelCompare<StdArc> comparer;
+      ArcSort(&refFst, comparer);
+      ref_fst_memory.Update(ApproxBytes(refFst));
+    });
     AdaptedCompositionFst composed_fst(refFst, hypFst, symbol);
     // composed_fst.DebugComposedGraph();
-    best_alignments = walker.walkComposed(composed_fst, symbol, options, alignerOptions.numBests);
+    {
+      ScopedPhaseTimer timer(perf, "walk");
+      best_alignments = walker.walkComposed(composed_fst, symbol, options, alignerOptions.numBests);
+    }
+    composed_fst.RecordPerf(stats);
   } else {
     throw std::runtime_error("invalid composition approach specified");
   }
+  walker.RecordPerf(stats);
 
   logger->info("done walking the graph");
   if (best_alignments.size() > 0) {
@@ -216,10 +433,9 @@ wer_alignment Fstalign(FstLoader& refLoader, FstLoader& hypLoader, SynonymEngine
   throw std::runtime_error("no alignment produced");
 }
 
-vector<Stitching> make_stitches(wer_alignment &alignment, vector<RawCtmRecord> hyp_ctm_rows = {},
-                                            vector<RawNlpRecord> hyp_nlp_rows = {},
-                                            vector<string> one_best_tokens = {},
-                                            bool use_case = false) {
+vector<Stitching> make_stitches(wer_alignment &alignment, const vector<RawCtmRecord> &hyp_ctm_rows = {},
+                                const vector<RawNlpRecord> &hyp_nlp_rows = {},
+                                const vector<string> &one_best_tokens = {}, bool use_case = false) {
   auto logger = logger::GetOrCreateLogger("fstalign");
 
   // Go through top alignment and create stitches
@@ -227,6 +443,8 @@ vector<Stitching> make_stitches(wer_alignment &alignment, vector<RawCtmRecord> h
   AlignmentTraversor visitor(alignment);
   triple tk_pair;
 
+  CaseFolder folder;
+
   int alignedTokensIndex = 0;
   int alignedTokensMaxRow = alignment.tokens.size();
 
@@ -280,7 +498,7 @@ vector<Stitching> make_stitches(wer_alignment &alignment, vector<RawCtmRecord> h
     }
 
     if (!hyp_ctm_rows.empty()) {
-      auto ctmPart = hyp_ctm_rows[hypRowIndex];
+      const auto &ctmPart = hyp_ctm_rows[hypRowIndex];
       part.start_ts = ctmPart.start_time_secs;
       part.duration = ctmPart.duration_secs;
       part.end_ts = ctmPart.start_time_secs + ctmPart.duration_secs;
@@ -290,7 +508,7 @@ vector<Stitching> make_stitches(wer_alignment &alignment, vector<RawCtmRecord> h
       // sanity check
       std::string ctmCopy = std::string(ctmPart.word);
       if (!use_case) {
-        ctmCopy = UnicodeLowercase(ctmPart.word);
+        ctmCopy = folder.Lowercase(ctmPart.word);
       }
 
       if (hyp_tk != ctmCopy) {
@@ -302,7 +520,7 @@ vector<Stitching> make_stitches(wer_alignment &alignment, vector<RawCtmRecord> h
     }
 
     if (!hyp_nlp_rows.empty()) {
-      auto hypNlpPart = hyp_nlp_rows[hypRowIndex];
+      const auto &hypNlpPart = hyp_nlp_rows[hypRowIndex];
       part.hyp_orig = hypNlpPart.token;
       if (!hypNlpPart.ts.empty() && !hypNlpPart.endTs.empty()) {
         float ts = stof(hypNlpPart.ts);
@@ -327,13 +545,13 @@ vector<Stitching> make_stitches(wer_alignment &alignment, vector<RawCtmRecord> h
     }
 
     if (!one_best_tokens.empty()) {
-      auto token = one_best_tokens[hypRowIndex];
+      const auto &token = one_best_tokens[hypRowIndex];
       part.hyp_orig = token;
 
       // sanity check
       std::string token_copy = std::string(token);
       if (!use_case) {
-        token_copy = UnicodeLowercase(token);
+        token_copy = folder.Lowercase(token);
       }
       if (hyp_tk != token_copy) {
         logger->warn(
@@ -357,9 +575,8 @@ vector<Stitching> make_stitches(wer_alignment &alignment, vector<RawCtmRecord> h
 void align_stitches_to_nlp(NlpFstLoader& refLoader, vector<Stitching> &stitches) {
   /* now, lets process NLP info */
   auto logger = logger::GetOrCreateLogger("fstalign");
-  logger->set_level(spdlog::level::info);
 
-  auto nlpRows = refLoader.mNlpRows;
+  const auto &nlpRows = refLoader.mNlpRows;
   int alignedTokensIndex = 0;
   int nlpRowIndex = 0;
   int nlpMaxRow = nlpRows.size();
@@ -377,7 +594,7 @@ void align_stitches_to_nlp(NlpFstLoader& refLoader, vector<Stitching> &stitches)
         logger->warn("Ran out of nlp rows. {} rows, {} stitches", nlpMaxRow, numStitches);
         break;
     }
-    auto nlpPart = nlpRows[nlpRowIndex];
+    const auto &nlpPart = nlpRows[nlpRowIndex];
     string nlp_classLabel = GetClassLabel(nlpPart.best_label);
 
     // sanity check
@@ -527,7 +744,7 @@ void align_stitches_to_nlp(NlpFstLoader& refLoader, vector<Stitching> &stitches)
     stitch.nlpRow = nlpPart;
     stitch.comment += ",split_worst";
 
-    auto lastNlpPartInClass = nlpRows[nlpRowIndex + classLabelRowsInNlp - 1];
+    const auto &lastNlpPartInClass = nlpRows[nlpRowIndex + classLabelRowsInNlp - 1];
     // setting the index properly for the next turn...
     nlpRowIndex += classLabelRowsInNlp;
 
@@ -563,7 +780,7 @@ void align_stitches_to_nlp(NlpFstLoader& refLoader, vector<Stitching> &stitches)
   }
 }
 
-void write_stitches_to_nlp(vector<Stitching>& stitches, ofstream &output_nlp_file, Json::Value norm_json, bool add_inserts = false) {
+void write_stitches_to_nlp(vector<Stitching>& stitches, ostream &output_nlp_file, const Json::Value &norm_json, bool add_inserts = false) {
   auto logger = logger::GetOrCreateLogger("fstalign");
   logger->info("Writing nlp output");
   // write header; 'comment' is there to store information about how well the alignment went
@@ -632,91 +849,331 @@ void write_stitches_to_nlp(vector<Stitching>& stitches, ofstream &output_nlp_fil
 }
 
 void HandleWer(FstLoader& refLoader, FstLoader& hypLoader, SynonymEngine &engine, const string& output_sbs, const string& output_nlp,
-               AlignerOptions alignerOptions, bool add_inserts_nlp, bool use_case) {
+               const AlignerOptions &alignerOptions, WerReport &report, bool add_inserts_nlp, bool use_case,
+               vector<Stitching> *aligned_stitches) {
   //  int speaker_switch_context_size, int numBests, int pr_threshold, string symbols_filename,
   //  string composition_approach, bool record_case_stats) {
   auto logger = logger::GetOrCreateLogger("fstalign");
-  logger->set_level(spdlog::level::info);
 
-  wer_alignment topAlignment = Fstalign(refLoader, hypLoader, engine, alignerOptions);
+  wer_alignment topAlignment = Fstalign(refLoader, hypLoader, engine, alignerOptions, &report.perf);
   CalculatePrecisionRecall(topAlignment, alignerOptions.pr_threshold);
 
-  RecordWer(topAlignment);
+  RecordWer(topAlignment, report);
+  ScopedMemoryHold alignment_memory(&report.perf, "alignment");
+  alignment_memory.Update(ApproxBytes(topAlignment));
   vector<Stitching> stitches;
+  ScopedMemoryHold stitches_memory(&report.perf, "stitches");
   CtmFstLoader *ctm_hyp_loader = dynamic_cast<CtmFstLoader *>(&hypLoader);
   NlpFstLoader *nlp_hyp_loader = dynamic_cast<NlpFstLoader *>(&hypLoader);
   OneBestFstLoader *best_loader = dynamic_cast<OneBestFstLoader *>(&hypLoader);
-  if (ctm_hyp_loader) {
-    stitches = make_stitches(topAlignment, ctm_hyp_loader->mCtmRows, {}, {}, use_case);
-  } else if (nlp_hyp_loader) {
-    stitches = make_stitches(topAlignment, {}, nlp_hyp_loader->mNlpRows, {}, use_case);
-  } else if (best_loader) {
-    vector<string> tokens;
-    tokens.reserve(best_loader->TokensSize());
-    for (int i = 0; i < best_loader->TokensSize(); i++) {
-      string token = best_loader->getToken(i);
-      tokens.push_back(token);
-    }
-    stitches = make_stitches(topAlignment, {}, {}, tokens, use_case);
-  } else {
-    stitches = make_stitches(topAlignment, {}, {}, {}, use_case);
+  {
+    ScopedPhaseTimer timer(&report.perf, "stitching");
+    if (ctm_hyp_loader) {
+      stitches = make_stitches(topAlignment, ctm_hyp_loader->mCtmRows, {}, {}, use_case);
+    } else if (nlp_hyp_loader) {
+      stitches = make_stitches(topAlignment, {}, nlp_hyp_loader->mNlpRows, {}, use_case);
+    } else if (best_loader) {
+      stitches = make_stitches(topAlignment, {}, {}, best_loader->getTokens(), use_case);
+    } else {
+      stitches = make_stitches(topAlignment, {}, {}, {}, use_case);
+    }
   }
+  stitches_memory.Update(ApproxBytes(stitches));
 
   NlpFstLoader *nlp_ref_loader = dynamic_cast<NlpFstLoader *>(&refLoader);
   if (nlp_ref_loader) {
     // We have an NLP reference, more metadata (e.g. speaker info) is available
     // Align stitches to the NLP, so stitches can access metadata
     try {
+      ScopedPhaseTimer timer(&report.perf, "stitching");
       align_stitches_to_nlp(*nlp_ref_loader, stitches);
     } catch (const std::bad_alloc &) {
       logger->error("Speaker switch diagnostics failed from memory error, likely due to overlapping class labels.");
     }
+    stitches_memory.Update(ApproxBytes(stitches));
 
-    if (alignerOptions.record_case_stats) {
-      RecordCaseWer(stitches);
-    }
+    {
+      ScopedPhaseTimer timer(&report.perf, "werStats");
+      if (alignerOptions.record_case_stats) {
+        RecordCaseWer(stitches, report);
+      }
 
-    // Calculate and record speaker switch WER if context size is provided
-    if (alignerOptions.speaker_switch_context_size > 0) {
-      logger->info("Calculating WER around speaker switches, using a window size of {0}",
-                   alignerOptions.speaker_switch_context_size);
-      // Count and record errors around speaker switches
-      RecordSpeakerSwitchWer(stitches, alignerOptions.speaker_switch_context_size);
-    }
+      // Calculate and record speaker switch WER if context size is provided
+      if (alignerOptions.speaker_switch_context_size > 0) {
+        logger->info("Calculating WER around speaker switches, using a window size of {0}",
+                     alignerOptions.speaker_switch_context_size);
+        // Count and record errors around speaker switches
+        RecordSpeakerSwitchWer(stitches, alignerOptions.speaker_switch_context_size, report);
+      }
 
-    // Calculate and record supplementary WER
-    RecordSpeakerWer(stitches);
-    RecordTagWer(stitches);
-    RecordSentenceWer(stitches);
+      // Calculate and record supplementary WER
+      RecordSpeakerWer(stitches, report);
+      RecordTagWer(stitches, report);
+      RecordSentenceWer(stitches, report);
+    }
 
     if (!output_nlp.empty()) {
-      ofstream nlp_ostream(output_nlp);
-      write_stitches_to_nlp(stitches, nlp_ostream, nlp_ref_loader->mJsonNorm, add_inserts_nlp);
+      ScopedPhaseTimer timer(&report.perf, "writeNlp");
+      auto nlp_ostream = OpenOutput(output_nlp);
+      write_stitches_to_nlp(stitches, *nlp_ostream, nlp_ref_loader->mJsonNorm, add_inserts_nlp);
     }
   }
 
-  JsonLogUnigramBigramStats(topAlignment);
+  {
+    ScopedPhaseTimer timer(&report.perf, "ngramStats");
+    JsonLogUnigramBigramStats(topAlignment, report);
+  }
+  alignment_memory.Update(ApproxBytes(topAlignment));
   if (!output_sbs.empty()) {
     logger->info("output_sbs = {}", output_sbs);
+    ScopedPhaseTimer timer(&report.perf, "writeSbs");
     WriteSbs(topAlignment, stitches, output_sbs);
   }
 
   if (!output_nlp.empty() && !nlp_ref_loader) {
     logger->warn("Attempted to output an Aligned NLP file without NLP reference, skipping output.");
   }
+
+  if (aligned_stitches) {
+    *aligned_stitches = std::move(stitches);
+  }
 }
 
-void HandleAlign(NlpFstLoader& refLoader, CtmFstLoader& hypLoader, SynonymEngine &engine, ofstream &output_nlp_file,
-                 AlignerOptions alignerOptions) {
+void HandleAlign(NlpFstLoader& refLoader, CtmFstLoader& hypLoader, SynonymEngine &engine, ostream &output_nlp_file,
+                 const AlignerOptions &alignerOptions, WerReport &report) {
   //  int numBests, string symbols_filename, string composition_approach) {
-  auto topAlignment = Fstalign(refLoader, hypLoader, engine, alignerOptions);
+  auto topAlignment = Fstalign(refLoader, hypLoader, engine, alignerOptions, &report.perf);
   // dump the WER details even when we're just considering alignment
-  RecordWer(topAlignment);
+  RecordWer(topAlignment, report);
 
   auto logger = logger::GetOrCreateLogger("fstalign");
-  logger->set_level(spdlog::level::info);
 
-  auto stitches = make_stitches(topAlignment, hypLoader.mCtmRows);
-  align_stitches_to_nlp(refLoader, stitches);
+  ScopedMemoryHold alignment_memory(&report.perf, "alignment");
+  alignment_memory.Update(ApproxBytes(topAlignment));
+
+  vector<Stitching> stitches;
+  ScopedMemoryHold stitches_memory(&report.perf, "stitches");
+  {
+    ScopedPhaseTimer timer(&report.perf, "stitching");
+    stitches = make_stitches(topAlignment, hypLoader.mCtmRows);
+    align_stitches_to_nlp(refLoader, stitches);
+  }
+  stitches_memory.Update(ApproxBytes(stitches));
+  ScopedPhaseTimer timer(&report.perf, "writeNlp");
   write_stitches_to_nlp(stitches, output_nlp_file, refLoader.mJsonNorm);
 }
+
+int HandleWerBatch(FstLoader &refLoader, const vector<HypothesisJob> &jobs, const SynonymEngine &engine,
+                   const AlignerOptions &alignerOptions,
+                   const std::function<std::unique_ptr<FstLoader>(const string &)> &load_hypothesis, int threads,
+                   bool use_case) {
+  auto logger = logger::GetOrCreateLogger("fstalign");
+  ThreadPool pool(threads);
+  logger->info("scoring {} hypotheses on {} threads", jobs.size(), pool.NumThreads());
+  // the jobs already keep the threads busy
+  AlignerOptions job_options = alignerOptions;
+  if (pool.NumThreads() > 1) {
+    job_options.preparation_threads = 1;
+  }
+
+  // filled by the workers, reported in the jobs order once they're all done
+  vector<Json::Value> best_wers(jobs.size());
+  vector<string> failures(jobs.size());
+
+  pool.Run(jobs.size(), [&](size_t i) {
+    const auto &job = jobs[i];
+    try {
+      WerReport report;
+      std::unique_ptr<FstLoader> hypLoader;
+      {
+        ScopedPhaseTimer timer(&report.perf, "loadHyp");
+        hypLoader = load_hypothesis(job.hyp_filename);
+      }
+      // synonyms generated from a hypothesis vocabulary stay with its job
+      SynonymEngine job_engine(engine);
+
+      HandleWer(refLoader, *hypLoader, job_engine, "", "", job_options, report, false, use_case);
+      best_wers[i] = report.BestWerToJson();
+      report.WriteJsonLog(job.json_log);
+    } catch (const std::exception &e) {
+      failures[i] = e.what();
+    }
+  });
+
+  int num_failures = 0;
+  for (size_t i = 0; i < jobs.size(); i++) {
+    if (!failures[i].empty()) {
+      num_failures++;
+      logger->error("{}: {}", jobs[i].hyp_filename, failures[i]);
+      continue;
+    }
+    const auto &best = best_wers[i];
+    logger->info("{}: WER: {}/{} = {:.4f} (INS:{} DEL:{} SUB:{}), json log in {}", jobs[i].hyp_filename,
+                 best["numErrors"].asInt(), best["numWordsInReference"].asInt(), best["wer"].asFloat(),
+                 best["insertions"].asInt(), best["deletions"].asInt(), best["substitutions"].asInt(),
+                 jobs[i].json_log);
+  }
+
+  return num_failures;
+}
+
+// bytes of an input, used as the cost of the jobs reading it
+static size_t InputSize(const string &filename) {
+  struct stat sb;
+  if (filename.empty() || stat(filename.c_str(), &sb) != 0) {
+    return 0;
+  }
+  return sb.st_size;
+}
+
+// a reference scored by several jobs of a batch, compiled by the first of them
+struct SharedReference {
+  std::once_flag compiled;
+  std::shared_ptr<FstLoader> loader;
+  // the jobs still to use it, the last one releases it
+  std::atomic<size_t> remaining_jobs{0};
+};
+
+Json::Value HandleBatch(const vector<BatchJob> &jobs, const SynonymEngine &engine, const AlignerOptions &alignerOptions,
+                        const std::function<std::unique_ptr<FstLoader>(const BatchJob &)> &load_reference,
+                        const std::function<std::unique_ptr<FstLoader>(const string &)> &load_hypothesis,
+                        int threads, bool add_inserts_nlp, bool use_case) {
+  auto logger = logger::GetOrCreateLogger("batch");
+  ThreadPool pool(threads);
+  logger->info("scoring {} ref/hyp pairs on {} threads", jobs.size(), pool.NumThreads());
+  // the jobs already keep the threads busy
+  AlignerOptions job_options = alignerOptions;
+  if (pool.NumThreads() > 1) {
+    job_options.preparation_threads = 1;
+  }
+
+  vector<size_t> costs;
+  costs.reserve(jobs.size());
+  for (auto &job : jobs) {
+    costs.push_back(InputSize(job.ref_filename) + InputSize(job.hyp_filename));
+  }
+
+  // The references of several jobs are compiled once, so their vocabulary rules are
+  // generated and applied once rather than by each job, with the same results as a run
+  // of each pair (see Fstalign()).  The compiled loaders are only read by the jobs, like
+  // the references cached by the server.
+  std::map<string, SharedReference> shared_references;
+  vector<SharedReference *> job_references(jobs.size(), nullptr);
+  {
+    std::map<string, vector<size_t>> jobs_by_reference;
+    for (size_t i = 0; i < jobs.size(); i++) {
+      jobs_by_reference[jobs[i].ref_filename + "\t" + jobs[i].json_norm_filename + "\t" +
+                        jobs[i].wer_sidecar_filename]
+          .push_back(i);
+    }
+    for (auto &reference : jobs_by_reference) {
+      if (reference.second.size() < 2) {
+        continue;
+      }
+      auto &shared = shared_references[reference.first];
+      shared.remaining_jobs = reference.second.size();
+      for (auto i : reference.second) {
+        job_references[i] = &shared;
+      }
+    }
+  }
+  if (!shared_references.empty()) {
+    logger->info("{} of the references are scored by several jobs, compiling each of them once",
+                 shared_references.size());
+  }
+
+  // the status of each job, filled by the workers
+  vector<Json::Value> statuses(jobs.size());
+  std::atomic<size_t> num_done(0);
+
+  pool.RunLargestFirst(costs, [&](size_t i) {
+    const auto &job = jobs[i];
+    auto &status = statuses[i];
+    status["ref"] = job.ref_filename;
+    status["hyp"] = job.hyp_filename;
+    try {
+      WerReport report;
+      std::shared_ptr<FstLoader> refLoader;
+      std::unique_ptr<FstLoader> hypLoader;
+      {
+        ScopedPhaseTimer timer(&report.perf, "loadRef");
+        auto *shared = job_references[i];
+        if (shared) {
+          // a failed compilation is retried by the next job, which reports its own error
+          try {
+            std::call_once(shared->compiled, [&]() {
+              std::shared_ptr<FstLoader> loader = load_reference(job);
+              // FST references aren't prepared, there's nothing to compile
+              if (!loader->getCompiledReference() && !dynamic_cast<FstFileLoader *>(loader.get())) {
+                CompiledReference::Compile(*loader, engine, alignerOptions.symbols_filename);
+              }
+              shared->loader = loader;
+            });
+          } catch (...) {
+            // the failed job is done with the reference too
+            if (--shared->remaining_jobs == 0) {
+              shared->loader.reset();
+            }
+            throw;
+          }
+          refLoader = shared->loader;
+          if (--shared->remaining_jobs == 0) {
+            shared->loader.reset();
+          }
+        } else {
+          refLoader = load_reference(job);
+        }
+      }
+      {
+        ScopedPhaseTimer timer(&report.perf, "loadHyp");
+        hypLoader = load_hypothesis(job.hyp_filename);
+      }
+
+      // the rules generated from this pair's vocabulary stay with its job
+      SynonymEngine job_engine(engine);
+      if (refLoader->getCompiledReference()) {
+        job_engine = refLoader->getCompiledReference()->engine;
+      }
+
+      HandleWer(*refLoader, *hypLoader, job_engine, job.output_sbs, job.output_nlp, job_options, report,
+                add_inserts_nlp, use_case);
+      status["bestWER"] = report.BestWerToJson();
+
+      if (!job.json_log.empty()) {
+        report.WriteJsonLog(job.json_log);
+        status["jsonLog"] = job.json_log;
+      }
+    } catch (const std::exception &e) {
+      status["error"] = e.what();
+    }
+    logger->info("done with {}/{}: {} vs {}", ++num_done, jobs.size(), job.ref_filename, job.hyp_filename);
+  });
+
+  Json::Value results;
+  WerResult corpus = {0, 0, 0, 0, 0};
+  int num_failures = 0;
+  for (size_t i = 0; i < jobs.size(); i++) {
+    auto &status = statuses[i];
+    if (status.isMember("error")) {
+      num_failures++;
+      logger->error("{} vs {}: {}", jobs[i].ref_filename, jobs[i].hyp_filename, status["error"].asString());
+    } else {
+      auto &best = status["bestWER"];
+      corpus.insertions += best["insertions"].asInt();
+      corpus.deletions += best["deletions"].asInt();
+      corpus.substitutions += best["substitutions"].asInt();
+      corpus.numWordsInReference += best["numWordsInReference"].asInt();
+    }
+    results["jobs"].append(status);
+  }
+
+  // errors and reference words are summed over the pairs, the corpus WER isn't an average
+  RecordWerResult(results["wer"]["corpusWER"], corpus);
+  results["numJobs"] = static_cast<Json::UInt64>(jobs.size());
+  results["numFailures"] = num_failures;
+
+  logger->info("corpus WER: {}/{} = {:.4f} over {} pairs ({} failed)", corpus.NumErrors(), corpus.numWordsInReference,
+               corpus.WER(), jobs.size() - num_failures, num_failures);
+  logger->info("corpus WER: INS:{} DEL:{} SUB:{}", corpus.insertions, corpus.deletions, corpus.substitutions);
+  return results;
+}
@@ -8,9 +8,13 @@ fstalign.h
 #ifndef __FSTALIGN_H__
 #define __FSTALIGN_H__
 
+#include <functional>
+#include <memory>
+
 #include "Ctm.h"
 #include "Nlp.h"
 #include "SynonymEngine.h"
+#include "WerReport.h"
 
 using namespace std;
 using namespace fst;
@@ -30,6 +34,9 @@ struct Stitching {
   string comment;
 };
 
+// number of best paths the wer command and the Aligner search unless told otherwise
+const int kDefaultNumBests = 100;
+
 struct AlignerOptions {
   int speaker_switch_context_size;
   int numBests = 20;
@@ -40,6 +47,14 @@ struct AlignerOptions {
   bool record_case_stats;
   bool levenstein_first_pass = false;
   int levenstein_maximum_error_streak = 100;
+  bool levenshtein_fast_path = true;
+  // threads running the independent reference and hypothesis preparation steps, 1 runs them in order
+  int preparation_threads = 3;
+  // the alignment throws MemoryLimitExceeded when the approximate memory of its subsystems
+  // goes over this many bytes, 0 for no limit
+  int64_t memory_limit_bytes = 0;
+  // the walker writes its state expansions and prunings to this CSV file, when given
+  string walker_trace_filename = "";
 };
 
 // original
@@ -50,9 +65,46 @@ struct AlignerOptions {
 // void HandleAlign(NlpFstLoader *refLoader, CtmFstLoader *hypLoader, SynonymEngine *engine, ofstream &output_nlp_file,
 //                  int numBests, string symbols_filename, string composition_approach);
 
+// the WER figures of the job are recorded into `report`, and its aligned tokens moved
+// to `stitches` when given
 void HandleWer(FstLoader& refLoader, FstLoader& hypLoader, SynonymEngine &engine, const string& output_sbs, const string& output_nlp,
-               AlignerOptions alignerOptions, bool add_inserts_nlp = false, bool use_case = false);
-void HandleAlign(NlpFstLoader &refLoader, CtmFstLoader &hypLoader, SynonymEngine &engine, ofstream &output_nlp_file,
-                 AlignerOptions alignerOptions);
+               const AlignerOptions &alignerOptions, WerReport &report, bool add_inserts_nlp = false, bool use_case = false,
+               vector<Stitching> *aligned_stitches = nullptr);
+void HandleAlign(NlpFstLoader &refLoader, CtmFstLoader &hypLoader, SynonymEngine &engine, ostream &output_nlp_file,
+                 const AlignerOptions &alignerOptions, WerReport &report);
+
+// one hypothesis of a `wer --hyp-list` run
+struct HypothesisJob {
+  string hyp_filename;
+  string json_log;
+};
+
+// Scores every hypothesis against the same reference on `threads` workers and writes
+// each JSON log to its job's file.  The reference must not be re-prepared per job,
+// i.e. be a compiled reference or an FST.  Returns the number of jobs that failed.
+int HandleWerBatch(FstLoader &refLoader, const vector<HypothesisJob> &jobs, const SynonymEngine &engine,
+                   const AlignerOptions &alignerOptions,
+                   const std::function<std::unique_ptr<FstLoader>(const string &)> &load_hypothesis, int threads,
+                   bool use_case = false);
+
+// one ref/hyp pair of a `batch` manifest, empty outputs are skipped
+struct BatchJob {
+  string ref_filename;
+  string hyp_filename;
+  string json_norm_filename;
+  string wer_sidecar_filename;
+  string output_sbs;
+  string output_nlp;
+  string json_log;
+};
+
+// Scores every pair of the manifest on `threads` workers, the largest inputs first, and
+// returns the corpus level results and the status of each job.  The synonym rules of
+// `engine` are shared by all the jobs, and so is a reference scored by several of them,
+// compiled once.
+Json::Value HandleBatch(const vector<BatchJob> &jobs, const SynonymEngine &engine, const AlignerOptions &alignerOptions,
+                        const std::function<std::unique_ptr<FstLoader>(const BatchJob &)> &load_reference,
+                        const std::function<std::unique_ptr<FstLoader>(const string &)> &load_hypothesis,
+                        int threads, bool add_inserts_nlp = false, bool use_case = false);
 
 #endif  // __FSTALIGN_H__
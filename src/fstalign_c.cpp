@@ -0,0 +1,139 @@
+/*
+ * fstalign_c.cpp
+ *
+ * Exceptions don't cross the C boundary: they are turned into error messages here.
+ */
+
+#include "fstalign_c.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <sstream>
+
+#include "Aligner.h"
+
+struct fstalign_aligner {
+  Aligner aligner;
+  explicit fstalign_aligner(const AlignerConfig &config) : aligner(config) {}
+};
+
+struct fstalign_result {
+  AlignmentResult result;
+  string json;
+};
+
+static void SetError(char **error, const char *message) {
+  if (error) {
+    *error = strdup(message);
+  }
+}
+
+static fstalign_result *AlignOrError(const fstalign_aligner *aligner, const vector<string> &ref,
+                                     const vector<string> &hyp, char **error) {
+  try {
+    std::unique_ptr<fstalign_result> result(new fstalign_result());
+    result->result = aligner->aligner.Align(ref, hyp);
+    return result.release();
+  } catch (const std::exception &e) {
+    SetError(error, e.what());
+  } catch (...) {
+    SetError(error, "unknown error");
+  }
+  return nullptr;
+}
+
+static vector<string> SplitText(const char *text) {
+  vector<string> tokens;
+  std::istringstream stream(text ? text : "");
+  string token;
+  while (stream >> token) {
+    tokens.push_back(token);
+  }
+  return tokens;
+}
+
+void fstalign_config_init(fstalign_config *config) {
+  memset(config, 0, sizeof(*config));
+}
+
+fstalign_aligner *fstalign_aligner_new(const fstalign_config *config, char **error) {
+  try {
+    AlignerConfig aligner_config;
+    if (config) {
+      if (config->synonyms_filename) {
+        aligner_config.synonyms_filename = config->synonyms_filename;
+      }
+      aligner_config.use_case = config->use_case != 0;
+      aligner_config.use_punctuation = config->use_punctuation != 0;
+      aligner_config.synonym_options.disable_cutoffs = config->disable_cutoffs != 0;
+      aligner_config.synonym_options.disable_hyphen_ignore = config->disable_hyphen_ignore != 0;
+      aligner_config.options.pr_threshold = config->pr_threshold;
+    }
+    return new fstalign_aligner(aligner_config);
+  } catch (const std::exception &e) {
+    SetError(error, e.what());
+  } catch (...) {
+    SetError(error, "unknown error");
+  }
+  return nullptr;
+}
+
+void fstalign_aligner_free(fstalign_aligner *aligner) { delete aligner; }
+
+fstalign_result *fstalign_align_tokens(const fstalign_aligner *aligner, const char *const *ref, size_t ref_size,
+                                       const char *const *hyp, size_t hyp_size, char **error) {
+  if (!aligner || (!ref && ref_size > 0) || (!hyp && hyp_size > 0)) {
+    SetError(error, "invalid arguments");
+    return nullptr;
+  }
+  vector<string> ref_tokens(ref, ref + ref_size);
+  vector<string> hyp_tokens(hyp, hyp + hyp_size);
+  return AlignOrError(aligner, ref_tokens, hyp_tokens, error);
+}
+
+fstalign_result *fstalign_align_text(const fstalign_aligner *aligner, const char *ref, const char *hyp,
+                                     char **error) {
+  if (!aligner) {
+    SetError(error, "invalid arguments");
+    return nullptr;
+  }
+  return AlignOrError(aligner, SplitText(ref), SplitText(hyp), error);
+}
+
+void fstalign_result_wer(const fstalign_result *result, fstalign_wer *wer) {
+  const auto &report = result->result.report;
+  const auto &best = report.best_wer;
+  wer->insertions = best.insertions;
+  wer->deletions = best.deletions;
+  wer->substitutions = best.substitutions;
+  wer->num_errors = best.NumErrors();
+  wer->num_words_in_reference = best.numWordsInReference;
+  wer->wer = report.best_wer_value;
+  wer->precision = report.best_precision;
+  wer->recall = report.best_recall;
+}
+
+size_t fstalign_result_size(const fstalign_result *result) { return result->result.tokens.size(); }
+
+void fstalign_result_token(const fstalign_result *result, size_t index, fstalign_token *token) {
+  const auto &aligned = result->result.tokens[index];
+  token->ref = aligned.ref.c_str();
+  token->hyp = aligned.hyp.c_str();
+  token->comment = aligned.comment.c_str();
+  token->class_label = aligned.class_label.c_str();
+  token->start_ts = aligned.start_ts;
+  token->end_ts = aligned.end_ts;
+  token->confidence = aligned.confidence;
+}
+
+const char *fstalign_result_json(fstalign_result *result) {
+  if (result->json.empty()) {
+    result->json = result->result.ToJson();
+  }
+  return result->json.c_str();
+}
+
+void fstalign_result_free(fstalign_result *result) { delete result; }
+
+void fstalign_free_error(char *error) { free(error); }
@@ -0,0 +1,80 @@
+/*
+ * fstalign_c.h
+ *
+ * C API of libfstalign, for calling the aligner in-process from other languages
+ * (e.g. Python through ctypes/cffi).  Objects are opaque, created and freed through
+ * these functions.  Failing calls return NULL and, when `error` isn't NULL, store a
+ * message to release with fstalign_free_error().
+ *
+ */
+
+#ifndef __FSTALIGN_C_H__
+#define __FSTALIGN_C_H__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct fstalign_aligner fstalign_aligner;
+typedef struct fstalign_result fstalign_result;
+
+typedef struct {
+  const char *synonyms_filename; /* NULL or "" for none */
+  int use_case;
+  int use_punctuation;
+  int disable_cutoffs;
+  int disable_hyphen_ignore;
+  int pr_threshold;
+} fstalign_config;
+
+typedef struct {
+  int insertions;
+  int deletions;
+  int substitutions;
+  int num_errors;
+  int num_words_in_reference;
+  float wer;
+  float precision;
+  float recall;
+} fstalign_wer;
+
+/* one pair of the best alignment, the strings are owned by the result */
+typedef struct {
+  const char *ref;     /* <ins> for an insertion */
+  const char *hyp;     /* <del> for a deletion */
+  const char *comment; /* "" when correct, "ins", "del" or "sub(<hyp>)" otherwise */
+  const char *class_label;
+  float start_ts;
+  float end_ts;
+  float confidence;
+} fstalign_token;
+
+/* fills the defaults of the wer subcommand */
+void fstalign_config_init(fstalign_config *config);
+
+fstalign_aligner *fstalign_aligner_new(const fstalign_config *config, char **error);
+void fstalign_aligner_free(fstalign_aligner *aligner);
+
+/* aligns two token sequences, an aligner can be used by several threads at once */
+fstalign_result *fstalign_align_tokens(const fstalign_aligner *aligner, const char *const *ref, size_t ref_size,
+                                       const char *const *hyp, size_t hyp_size, char **error);
+/* same, with whitespace separated transcripts */
+fstalign_result *fstalign_align_text(const fstalign_aligner *aligner, const char *ref, const char *hyp, char **error);
+
+void fstalign_result_wer(const fstalign_result *result, fstalign_wer *wer);
+/* number of aligned pairs, the index of fstalign_result_token() must be below it */
+size_t fstalign_result_size(const fstalign_result *result);
+void fstalign_result_token(const fstalign_result *result, size_t index, fstalign_token *token);
+/* the --json-log of the alignment, owned by the result */
+const char *fstalign_result_json(fstalign_result *result);
+void fstalign_result_free(fstalign_result *result);
+
+void fstalign_free_error(char *error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __FSTALIGN_C_H__
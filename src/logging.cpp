@@ -11,14 +11,22 @@ logging.cpp
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/spdlog.h>
 
+#include <mutex>
+
 namespace logger {
 
 std::string CONSOLE_LOGGER_NAME = "console";
 
 std::vector<spdlog::sink_ptr> sinks;
-
-void InitLoggers(std::string logfilename) {
-  sinks.push_back(std::make_shared<spdlog::sinks::ansicolor_stdout_sink_mt>());
+// batch jobs create their loggers concurrently
+std::mutex registry_mutex;
+
+void InitLoggers(std::string logfilename, bool to_stderr) {
+  if (to_stderr) {
+    sinks.push_back(std::make_shared<spdlog::sinks::ansicolor_stderr_sink_mt>());
+  } else {
+    sinks.push_back(std::make_shared<spdlog::sinks::ansicolor_stdout_sink_mt>());
+  }
   if (logfilename.size() > 0) {
     auto filesink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(logfilename);
     sinks.push_back(filesink);
@@ -40,6 +48,7 @@ void InitLoggers(std::string logfilename) {
 }
 
 std::shared_ptr<spdlog::logger> GetOrCreateLogger(std::string name) {
+  std::lock_guard<std::mutex> lock(registry_mutex);
   auto log = spdlog::get(name);
 
   if (log == nullptr) {
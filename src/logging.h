@@ -18,7 +18,8 @@ namespace logger {
 
 namespace spd = spdlog;
 
-void InitLoggers(std::string logfilename);
+// to_stderr keeps stdout free, e.g. for the replies of `serve` on stdin/stdout
+void InitLoggers(std::string logfilename, bool to_stderr = false);
 std::shared_ptr<spd::logger> GetOrCreateLogger(std::string name);
 std::shared_ptr<spd::logger> GetLogger(std::string name);
 void CloseLoggers();
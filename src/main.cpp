@@ -1,40 +1,60 @@
 #include <CLI/CLI.hpp>
+#include <algorithm>
 #include <fstream>
+#include <map>
 
+#include "AlignmentServer.h"
+#include "CompiledReference.h"
+#include "CompressedStream.h"
 #include "FstFileLoader.h"
 #include "OneBestFstLoader.h"
 #include "fast-d.h"
 #include "fstalign.h"
-#include "json_logging.h"
 #include "utilities.h"
 #include "version.h"
 
 using namespace std;
 using namespace fst;
 
+vector<HypothesisJob> ReadHypothesisList(const string &filename);
+vector<BatchJob> ReadBatchManifest(const string &filename);
+
 int main(int argc, char **argv) {
   setlocale(LC_ALL, "en_US.UTF-8");
   string ref_filename;
   string json_norm_filename;
   string wer_sidecar_filename;
   string hyp_filename;
+  string ref_format = "";
+  string hyp_format = "";
   string log_filename = "";
   string output_nlp = "";
   string output_sbs = "";
   string synonyms_filename;
   string hyp_json_norm_filename = "";
   string output_json_log;
+  string output_ngram_stats = "";
   string symbols_filename = "";
+  string output_compiled_ref = "";
+  string output_compiled_synonyms = "";
+  string walker_trace_filename = "";
+  string hyp_list_filename = "";
+  int num_threads = 0;
+  string batch_manifest_filename = "";
+  string socket_filename = "";
+  int max_references = 32;
   int pr_threshold = 0;
   bool version;
   string composition_approach = "adapted";
   int speaker_switch_context_size = 5;
-  int numBests = 100;
+  int numBests = kDefaultNumBests;
   int levenstein_maximum_error_streak = 100;
+  double memory_limit = 0;
   bool record_case_stats = false;
   bool use_punctuation = false;
   bool use_case = false;
   bool disable_approximate_alignment = false;
+  bool disable_levenshtein_fast_path = false;
   bool add_inserts_nlp = false;
 
   bool disable_cutoffs = false;
@@ -47,13 +67,20 @@ int main(int argc, char **argv) {
   CLI::App *get_wer = app.add_subcommand("wer", "Get the WER between a reference and an hypothesis.");
   CLI::App *get_alignment =
       app.add_subcommand("align", "Produce an alignment between an NLP file and a CTM-like input.");
+  CLI::App *batch = app.add_subcommand("batch", "Get the WER of many reference/hypothesis pairs listed in a manifest.");
+  CLI::App *serve = app.add_subcommand(
+      "serve", "Answer alignment requests from stdin or a unix socket, keeping references and synonyms loaded.");
+  CLI::App *compile_ref = app.add_subcommand(
+      "compile-ref", "Prepare a reference once, to be scored against many hypotheses with wer/align.");
+  CLI::App *compile_synonyms = app.add_subcommand(
+      "compile-synonyms", "Parse synonym rules once into a binary rule set, loaded without parsing by --syn.");
 
   // adding common options.  It's fine to reuse the ref_filename since we
   // require exactly one subcommand to be defined
   for (auto &c : {get_wer, get_alignment}) {
     c->add_option("-r,--ref", ref_filename,
                   "Reference filename (.nlp & .ctm have special handling, "
-                  "everything else is handled as a plain text)");
+                  "everything else is handled as a plain text), - for stdin");
     c->add_option("--ref-json", json_norm_filename,
                   "JSon normalization sidecar file, used in conjunction with "
                   ".nlp input.)");
@@ -68,17 +95,24 @@ int main(int argc, char **argv) {
                 "compound words (e.g. best-ever <-> best ever)");
     c->add_flag("--disable-approx-alignment", disable_approximate_alignment,
                 "Disable getting a first approximate alignment/WER before the more exhaustive search happens");
+    c->add_flag("--disable-levenshtein-fast-path", disable_levenshtein_fast_path,
+                "Always build and walk the alignment graph, even for plain text/CTM inputs without synonyms");
 
     // NOTE: we can't have -h as a synonym for --hyp as it collides with --help
     c->add_option("--hyp", hyp_filename, "Hypothesis filename (same rules as for --ref handling.)");
+    c->add_option("--ref-format", ref_format,
+                  "Format of the reference, one of nlp, ctm, fst, txt or compiled, instead of guessing it from the "
+                  "extension.  Use it with --ref - to read the reference from stdin.");
+    c->add_option("--hyp-format", hyp_format,
+                  "Format of the hypothesis, one of nlp, ctm, fst or txt, instead of guessing it from the extension.");
 
     // TODO: add support for hypothesis-side normalization
     // c->add_option("--hyp-json", hyp_json_norm_filename,
     //               "JSon normalization sidecar file, used in conjunction with "
     //               ".nlp input.)");
 
-    c->add_option("--output-nlp", output_nlp, "The output path to store the aligned nlp file");
-    c->add_option("--output-sbs", output_sbs, "The output path to store the side-by-side alignment");
+    c->add_option("--output-nlp", output_nlp, "The output path to store the aligned nlp file, - for stdout");
+    c->add_option("--output-sbs", output_sbs, "The output path to store the side-by-side alignment, - for stdout");
 
     c->add_option("--log", log_filename, "Save logging output to this file as well as to the console.)");
 
@@ -97,10 +131,25 @@ int main(int argc, char **argv) {
 
     c->add_option("--composition-approach", composition_approach,
                   "Desired composition logic. Choices are 'standard' or 'adapted'");
+
+    c->add_option("--memory-limit", memory_limit,
+                  "Abort with an error when the approximate memory held by the alignment goes over this many MB. "
+                  "The peaks of each stage are in the perf section of the JSON log. Defaults to 0, no limit.");
+
+    c->add_option("--walker-trace", walker_trace_filename,
+                  "Write every state expanded and every pruning of the alignment graph search to this CSV file "
+                  "(.gz or .zst to compress it), to be summarized with fstalign_trace_summary.");
   }
   get_wer->add_option("--wer-sidecar", wer_sidecar_filename,
                 "WER sidecar json file.");
 
+  get_wer->add_option("--hyp-list", hyp_list_filename,
+                      "File listing hypotheses to score against the reference, one per line, instead of --hyp. "
+                      "The reference is prepared once and each hypothesis JSON log is written to the path given "
+                      "after a tab on its line, or to <hyp>.json.");
+  get_wer->add_option("--threads", num_threads,
+                      "Number of hypotheses from --hyp-list scored concurrently. Defaults to one per core.");
+
   get_wer->add_option("--speaker-switch-context", speaker_switch_context_size,
                       "Amount of context (in each direction) around "
                       "a speaker switch to investigate for WER. This "
@@ -109,7 +158,7 @@ int main(int argc, char **argv) {
   // Add JSON log output to all sub commands
   get_wer->add_option(
       "--json-log", output_json_log,
-      "Filename for JSON log output, containing structured output from the subcommand you run. Current schema looks like\n\
+      "Filename for JSON log output (- for stdout), containing structured output from the subcommand you run. Current schema looks like\n\
                         {\n\
                             wer:\n\
                             {\n\
@@ -120,6 +169,10 @@ int main(int argc, char **argv) {
                             }\n\
                         }");
 
+  get_wer->add_option("--json-log-ngrams", output_ngram_stats,
+                      "Write the unigrams and bigrams stats to this JSONL file, one compact object per line, "
+                      "instead of the --json-log (- for stdout).");
+
   get_wer->add_flag("--record-case-stats", record_case_stats,
                     "Record precision/recall for how well the hypothesis"
                     "casing matches the reference.");
@@ -127,6 +180,88 @@ int main(int argc, char **argv) {
   get_wer->add_flag("--use-case", use_case, "Keeps token casing and considers tokens with different case as different tokens");
   get_wer->add_flag("--add-inserts-nlp", add_inserts_nlp, "Add inserts to NLP output");
 
+  // batch takes the per pair inputs and outputs from its manifest, and the wer options applying to all of them
+  batch->add_option("-m,--manifest", batch_manifest_filename,
+                    "Tab separated manifest, one pair per line after a header naming the columns among ref, hyp, "
+                    "ref_json, wer_sidecar, output_sbs, output_nlp and json_log.  ref and hyp are required.")
+      ->required();
+  batch->add_option("--threads", num_threads, "Number of pairs scored concurrently. Defaults to one per core.");
+  batch->add_option("--json-log", output_json_log,
+                    "Filename for the JSON log of the batch: the corpus WER and the status of each pair.");
+  batch->add_option("-s,--syn", synonyms_filename, "Synonyms definition filename, shared by all the pairs.");
+
+  // serve takes its inputs from the requests, and the wer options applying to all of them
+  serve->add_option("--socket", socket_filename,
+                    "Unix domain socket to listen on.  Without it, requests are read from stdin and answered on "
+                    "stdout, the logs going to stderr.");
+  serve->add_option("-s,--syn", synonyms_filename,
+                    "Synonyms definition filename, used by the requests not naming their own.");
+  serve->add_option("--max-references", max_references,
+                    "Number of compiled references kept loaded, the least recently used are dropped. Defaults to 32.");
+  serve->add_option("--threads", num_threads,
+                    "Number of socket connections served at once, the others waiting for one to close. Defaults to "
+                    "one per core.");
+
+  for (auto &c : {batch, serve}) {
+    c->add_flag("--disable-cutoffs", disable_cutoffs,
+                "Prevents the synonym engine from adding synonyms of cutoff words (e.g. the-)");
+    c->add_flag("--disable-hyphen-ignore", disable_hyphen_ignore,
+                "Prevents the synonym engine from adding synonyms of hyphenated compound words");
+    c->add_flag("--disable-approx-alignment", disable_approximate_alignment,
+                "Disable getting a first approximate alignment/WER before the more exhaustive search happens");
+    c->add_flag("--disable-levenshtein-fast-path", disable_levenshtein_fast_path,
+                "Always build and walk the alignment graph, even for plain text/CTM inputs without synonyms");
+    c->add_option("--log", log_filename, "Save logging output to this file as well as to the console.)");
+    c->add_option("--numbests", numBests, "The maximum number of minimum error paths through the alignment graph.");
+    c->add_option("--levenstein-max-error-streak", levenstein_maximum_error_streak,
+                  "The maximum number of consecutive errors supported by levenstein approximation.");
+    c->add_option("--pr_threshold", pr_threshold,
+                  "Threshold of occurrences that will be output in Precision and Recall listings");
+    c->add_option("--symbols", symbols_filename, "Symbols table to use as a common starting point.");
+    c->add_option("--composition-approach", composition_approach,
+                  "Desired composition logic. Choices are 'standard' or 'adapted'");
+    c->add_option("--memory-limit", memory_limit,
+                  "Fail the pairs whose alignment holds more than this many MB, approximately. Defaults to 0, no limit.");
+    c->add_option("--speaker-switch-context", speaker_switch_context_size,
+                  "Amount of context (in each direction) around a speaker switch to investigate for WER.");
+    c->add_flag("--record-case-stats", record_case_stats,
+                "Record precision/recall for how well the hypothesis casing matches the reference.");
+    c->add_flag("--use-punctuation", use_punctuation, "Treat punctuation from nlp rows as separate tokens");
+    c->add_flag("--use-case", use_case,
+                "Keeps token casing and considers tokens with different case as different tokens");
+    c->add_flag("--add-inserts-nlp", add_inserts_nlp, "Add inserts to NLP output");
+  }
+
+  // compile-ref takes the reference side of the wer/align options
+  compile_ref->add_option("-r,--ref", ref_filename, "Reference filename (.nlp, .ctm or plain text), - for stdin")
+      ->required();
+  compile_ref->add_option("--ref-format", ref_format,
+                          "Format of the reference, one of nlp, ctm or txt, instead of guessing it from the extension.");
+  compile_ref->add_option("--ref-json", json_norm_filename,
+                          "JSon normalization sidecar file, used in conjunction with .nlp input.");
+  compile_ref->add_option("--wer-sidecar", wer_sidecar_filename, "WER sidecar json file.");
+  compile_ref->add_option("-s,--syn", synonyms_filename, "Synonyms definition filename.");
+  compile_ref->add_flag("--disable-cutoffs", disable_cutoffs,
+                        "Prevents the synonym engine from adding synonyms of cutoff words (e.g. the-)");
+  compile_ref->add_flag("--disable-hyphen-ignore", disable_hyphen_ignore,
+                        "Prevents the synonym engine from adding synonyms of hyphenated compound words");
+  compile_ref->add_flag("--use-punctuation", use_punctuation, "Treat punctuation from nlp rows as separate tokens");
+  compile_ref->add_flag("--use-case", use_case,
+                        "Keeps token casing and considers tokens with different case as different tokens");
+  compile_ref->add_option("--symbols", symbols_filename, "Symbols table to use as a common starting point.");
+  compile_ref->add_option("--log", log_filename, "Save logging output to this file as well as to the console.)");
+  compile_ref->add_option("-o,--output", output_compiled_ref,
+                          std::string("Compiled reference to write, use it as the --ref of wer/align runs. The ") +
+                              CompiledReference::kExtension + " extension is added when missing.")
+      ->required();
+
+  compile_synonyms->add_option("-s,--syn", synonyms_filename, "Synonyms definition filename.")->required();
+  compile_synonyms->add_option("--log", log_filename, "Save logging output to this file as well as to the console.)");
+  compile_synonyms->add_option("-o,--output", output_compiled_synonyms,
+                               std::string("Compiled synonyms to write, use them as the --syn of any subcommand. The ") +
+                                   SynonymEngine::kCompiledExtension + " extension is added when missing.")
+      ->required();
+
   // CLI11_PARSE(app, argc, argv);
   try {
     app.parse(argc, argv);
@@ -146,94 +281,387 @@ int main(int argc, char **argv) {
     return 1;
   }
 
-  logger::InitLoggers(log_filename);
+  auto subcommand = app.get_subcommands()[0];
+  auto command = subcommand->get_name();
+
+  // stdout only carries the responses of serve on stdin, or the outputs written to "-"
+  bool stdout_output = (command == "serve" && socket_filename.empty()) || output_nlp == "-" || output_sbs == "-" ||
+                       output_json_log == "-" || output_ngram_stats == "-";
+  logger::InitLoggers(log_filename, stdout_output);
   auto console = logger::GetLogger("console");
   console->info("fstalign version is {}.{}.{}", FSTALIGNER_VERSION_MAJOR, FSTALIGNER_VERSION_MINOR,
                 FSTALIGNER_VERSION_PATCH);
 
-  auto subcommand = app.get_subcommands()[0];
-  auto command = subcommand->get_name();
+  SynonymOptions syn_opts;
+  syn_opts.disable_cutoffs = disable_cutoffs;
+  syn_opts.disable_hyphen_ignore = disable_hyphen_ignore;
 
+  // stdin can only be read once
+  int stdin_inputs = 0;
+  for (auto &filename : {ref_filename, hyp_filename, json_norm_filename, wer_sidecar_filename}) {
+    stdin_inputs += filename == "-";
+  }
+  if (stdin_inputs > 1) {
+    console->error("only one input can be read from stdin");
+    return 1;
+  }
 
-  // loading "reference" inputs
-  std::unique_ptr<FstLoader> hyp = FstLoader::MakeHypothesisLoader(hyp_filename, hyp_json_norm_filename, use_punctuation, use_case, !symbols_filename.empty());
-  std::unique_ptr<FstLoader> ref = FstLoader::MakeReferenceLoader(ref_filename, wer_sidecar_filename, json_norm_filename, use_punctuation, use_case, !symbols_filename.empty());
+  if (command == "compile-ref") {
+    std::unique_ptr<FstLoader> ref = FstLoader::MakeReferenceLoader(ref_filename, wer_sidecar_filename, json_norm_filename, use_punctuation, use_case, !symbols_filename.empty(), ref_format);
+    SynonymEngine engine(syn_opts);
+    if (synonyms_filename.size() > 0) {
+      engine.LoadFile(synonyms_filename);
+    }
+
+    if (!EndsWithCaseInsensitive(output_compiled_ref, string(CompiledReference::kExtension))) {
+      output_compiled_ref += CompiledReference::kExtension;
+    }
+    CompiledReference::Compile(*ref, engine, symbols_filename);
+    CompiledReference::Write(*ref, output_compiled_ref);
+    console->info("compiled reference written to {}", output_compiled_ref);
+
+    logger::CloseLoggers();
+    console->info("done");
+    return 0;
+  }
+
+  if (command == "compile-synonyms") {
+    SynonymEngine engine(syn_opts);
+    engine.LoadFile(synonyms_filename);
+
+    if (!EndsWithCaseInsensitive(output_compiled_synonyms, string(SynonymEngine::kCompiledExtension))) {
+      output_compiled_synonyms += SynonymEngine::kCompiledExtension;
+    }
+    engine.WriteCompiled(output_compiled_synonyms);
+    console->info("compiled synonyms written to {}", output_compiled_synonyms);
+
+    logger::CloseLoggers();
+    console->info("done");
+    return 0;
+  }
 
   AlignerOptions alignerOptions;
   alignerOptions.speaker_switch_context_size = speaker_switch_context_size;
   alignerOptions.levenstein_first_pass = !disable_approximate_alignment;
   alignerOptions.numBests = numBests;
   alignerOptions.levenstein_maximum_error_streak = levenstein_maximum_error_streak;
+  alignerOptions.levenshtein_fast_path = !disable_levenshtein_fast_path;
   alignerOptions.pr_threshold = pr_threshold;
   alignerOptions.record_case_stats = record_case_stats;
   alignerOptions.symbols_filename = symbols_filename;
   alignerOptions.composition_approach = composition_approach;
+  alignerOptions.memory_limit_bytes = static_cast<int64_t>(memory_limit * 1024 * 1024);
+  alignerOptions.walker_trace_filename = walker_trace_filename;
 
+  if (command == "batch") {
+    auto jobs = ReadBatchManifest(batch_manifest_filename);
 
-  SynonymOptions syn_opts;
-  syn_opts.disable_cutoffs = disable_cutoffs;
-  syn_opts.disable_hyphen_ignore = disable_hyphen_ignore;
+    // loaded once, the jobs only read these rules
+    SynonymEngine engine(syn_opts);
+    if (synonyms_filename.size() > 0) {
+      engine.LoadFile(synonyms_filename);
+    }
+    engine.ShareRules();
+
+    auto load_reference = [&](const BatchJob &job) {
+      return FstLoader::MakeReferenceLoader(job.ref_filename, job.wer_sidecar_filename, job.json_norm_filename,
+                                            use_punctuation, use_case, !symbols_filename.empty());
+    };
+    auto load_hypothesis = [&](const string &filename) {
+      return FstLoader::MakeHypothesisLoader(filename, "", use_punctuation, use_case, !symbols_filename.empty());
+    };
+    auto results = HandleBatch(jobs, engine, alignerOptions, load_reference, load_hypothesis, num_threads,
+                               add_inserts_nlp, use_case);
+
+    logger::CloseLoggers();
+    if (!output_json_log.empty()) {
+      console->info("Writing JSON log output to {}", output_json_log);
+      auto jsonFile = OpenOutput(output_json_log);
+      *jsonFile << results << std::endl;
+    }
+    if (results["numFailures"].asInt() > 0) {
+      console->error("{} of {} pairs failed", results["numFailures"].asInt(), jobs.size());
+      return 1;
+    }
+    console->info("done");
+    return 0;
+  }
+
+  if (command == "serve") {
+    auto load_synonyms = [&](const string &filename) {
+      auto engine = std::make_unique<SynonymEngine>(syn_opts);
+      if (filename.size() > 0) {
+        engine->LoadFile(filename);
+      }
+      engine->ShareRules();
+      return engine;
+    };
+    auto load_reference = [&](const BatchJob &job) {
+      return FstLoader::MakeReferenceLoader(job.ref_filename, job.wer_sidecar_filename, job.json_norm_filename,
+                                            use_punctuation, use_case, !symbols_filename.empty());
+    };
+    auto load_hypothesis = [&](const string &filename) {
+      return FstLoader::MakeHypothesisLoader(filename, "", use_punctuation, use_case, !symbols_filename.empty());
+    };
+    AlignmentServer server(alignerOptions, synonyms_filename, load_synonyms, load_reference, load_hypothesis,
+                           std::max(max_references, 1), add_inserts_nlp, use_case);
+
+    if (socket_filename.empty()) {
+      console->info("serving requests from stdin");
+      server.Serve(std::cin, std::cout);
+    } else {
+      server.ServeSocket(socket_filename, num_threads);
+    }
+
+    logger::CloseLoggers();
+    console->info("done");
+    return 0;
+  }
+
+  if (!hyp_list_filename.empty() && !hyp_filename.empty()) {
+    console->error("--hyp and --hyp-list are mutually exclusive");
+    return 1;
+  }
+
+  WerReport report;
+
+  // loading "reference" inputs
+  std::unique_ptr<FstLoader> hyp;
+  if (hyp_list_filename.empty()) {
+    ScopedPhaseTimer timer(&report.perf, "loadHyp");
+    hyp = FstLoader::MakeHypothesisLoader(hyp_filename, hyp_json_norm_filename, use_punctuation, use_case, !symbols_filename.empty(), hyp_format);
+  }
+  std::unique_ptr<FstLoader> ref;
+  {
+    ScopedPhaseTimer timer(&report.perf, "loadRef");
+    ref = FstLoader::MakeReferenceLoader(ref_filename, wer_sidecar_filename, json_norm_filename, use_punctuation, use_case, !symbols_filename.empty(), ref_format);
+  }
 
   SynonymEngine engine(syn_opts);
-  if (synonyms_filename.size() > 0) {
+  if (ref->getCompiledReference()) {
+    // the synonym rules and options were compiled with the reference
+    engine = ref->getCompiledReference()->engine;
+    if (synonyms_filename.size() > 0) {
+      console->warn("the synonyms of the compiled reference are used, ignoring {}", synonyms_filename);
+    }
+  } else if (synonyms_filename.size() > 0) {
+    ScopedPhaseTimer timer(&report.perf, "loadSynonyms");
     engine.LoadFile(synonyms_filename);
   }
 
-  if (command == "wer") {
-    HandleWer(*ref, *hyp, engine, output_sbs, output_nlp, alignerOptions, add_inserts_nlp, use_case);
-  } else if (command == "align") {
-    if (output_nlp.empty()) {
-      console->error("the output nlp file must be specified");
+  if (command == "wer" && !hyp_list_filename.empty()) {
+    auto jobs = ReadHypothesisList(hyp_list_filename);
+    if (!output_sbs.empty() || !output_nlp.empty() || !output_json_log.empty() || !walker_trace_filename.empty()) {
+      console->warn("--output-sbs, --output-nlp, --json-log and --walker-trace are ignored with --hyp-list");
     }
+    alignerOptions.walker_trace_filename.clear();
 
-    console->info("we'll be writing to {}", output_nlp);
-    ofstream output_nlp_file(output_nlp);
+    // prepare the reference once, the scores stay the ones of separate runs: a hypothesis
+    // with words the reference doesn't have has it prepared again (see Fstalign())
+    if (!ref->getCompiledReference() && !dynamic_cast<FstFileLoader *>(ref.get())) {
+      CompiledReference::Compile(*ref, engine, symbols_filename);
+      engine = ref->getCompiledReference()->engine;
+    }
+    engine.ShareRules();
+
+    auto load_hypothesis = [&](const string &filename) {
+      return FstLoader::MakeHypothesisLoader(filename, hyp_json_norm_filename, use_punctuation, use_case,
+                                             !symbols_filename.empty(), hyp_format);
+    };
+    int failures = HandleWerBatch(*ref, jobs, engine, alignerOptions, load_hypothesis, num_threads, use_case);
+
+    logger::CloseLoggers();
+    if (failures > 0) {
+      console->error("{} of {} hypotheses failed", failures, jobs.size());
+      return 1;
+    }
+    console->info("done");
+    return 0;
+  }
 
-    // TODO: We should instrument FstLoader base class
-    // to have nlp rows and ctm rows and have a getCtmRows/getNlpRows
-    // empty methods that throw exceptions if not implemented.
-    NlpFstLoader *nlpRef = dynamic_cast<NlpFstLoader *>(ref.get());
-    CtmFstLoader *ctmHyp = dynamic_cast<CtmFstLoader *>(hyp.get());
+  // the json log still tells which stage went over the memory limit
+  bool memory_limit_exceeded = false;
+  try {
+    if (command == "wer") {
+      HandleWer(*ref, *hyp, engine, output_sbs, output_nlp, alignerOptions, report, add_inserts_nlp, use_case);
+    } else if (command == "align") {
+      if (output_nlp.empty()) {
+        console->error("the output nlp file must be specified");
+      }
 
-    HandleAlign(*nlpRef, *ctmHyp, engine, output_nlp_file, alignerOptions);
+      console->info("we'll be writing to {}", output_nlp);
+      auto output_nlp_file = OpenOutput(output_nlp);
 
-    output_nlp_file.flush();
-    output_nlp_file.close();
+      // TODO: We should instrument FstLoader base class
+      // to have nlp rows and ctm rows and have a getCtmRows/getNlpRows
+      // empty methods that throw exceptions if not implemented.
+      NlpFstLoader *nlpRef = dynamic_cast<NlpFstLoader *>(ref.get());
+      CtmFstLoader *ctmHyp = dynamic_cast<CtmFstLoader *>(hyp.get());
 
-  } else {
-    console->error("The command {} isn't implemented yet", command);
+      HandleAlign(*nlpRef, *ctmHyp, engine, *output_nlp_file, alignerOptions, report);
+
+      output_nlp_file->flush();
+
+    } else {
+      console->error("The command {} isn't implemented yet", command);
+    }
+  } catch (const MemoryLimitExceeded &e) {
+    console->error("{}", e.what());
+    memory_limit_exceeded = true;
   }
 
   logger::CloseLoggers();
 
   if (!output_json_log.empty()) {
     console->info("Writing JSON log output to {}", output_json_log);
-    ofstream jsonFile;
-    jsonFile.open(output_json_log);
-    jsonFile << jsonLogger::JsonLogger::getLogger().root << std::endl;
-    jsonFile.close();
+    report.WriteJsonLog(output_json_log, output_ngram_stats);
+  } else if (!output_ngram_stats.empty()) {
+    console->info("Writing n-gram stats to {}", output_ngram_stats);
+    auto ngramsFile = OpenOutput(output_ngram_stats);
+    report.WriteNgramStats(*ngramsFile);
   }
 
+  if (memory_limit_exceeded) {
+    return 1;
+  }
   console->info("done");
 }
 
+// one hypothesis per line, optionally followed by a tab and the path of its json log
+vector<HypothesisJob> ReadHypothesisList(const string &filename) {
+  ifstream list(filename);
+  if (!list.is_open()) {
+    throw std::runtime_error("Cannot open input file " + filename);
+  }
+
+  vector<HypothesisJob> jobs;
+  string line;
+  while (getline(list, line)) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    HypothesisJob job;
+    auto tab = line.find('\t');
+    job.hyp_filename = line.substr(0, tab);
+    job.json_log = tab == string::npos ? job.hyp_filename + ".json" : line.substr(tab + 1);
+    jobs.push_back(job);
+  }
+
+  if (jobs.empty()) {
+    throw std::runtime_error("no hypothesis listed in " + filename);
+  }
+  return jobs;
+}
+
+// a header naming the columns, then one ref/hyp pair per line
+vector<BatchJob> ReadBatchManifest(const string &filename) {
+  ifstream manifest(filename);
+  if (!manifest.is_open()) {
+    throw std::runtime_error("Cannot open input file " + filename);
+  }
+
+  static const std::map<string, string BatchJob::*> columns = {{"ref", &BatchJob::ref_filename},
+                                                               {"hyp", &BatchJob::hyp_filename},
+                                                               {"ref_json", &BatchJob::json_norm_filename},
+                                                               {"wer_sidecar", &BatchJob::wer_sidecar_filename},
+                                                               {"output_sbs", &BatchJob::output_sbs},
+                                                               {"output_nlp", &BatchJob::output_nlp},
+                                                               {"json_log", &BatchJob::json_log}};
+
+  auto split_line = [](string line) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    vector<string> fields;
+    size_t begin = 0;
+    for (size_t tab = line.find('\t'); tab != string::npos; tab = line.find('\t', begin)) {
+      fields.push_back(line.substr(begin, tab - begin));
+      begin = tab + 1;
+    }
+    fields.push_back(line.substr(begin));
+    return fields;
+  };
+
+  string line;
+  size_t line_number = 0;
+  vector<string BatchJob::*> header;
+  while (header.empty() && getline(manifest, line)) {
+    line_number++;
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    for (auto &name : split_line(line)) {
+      auto column = columns.find(name);
+      if (column == columns.end()) {
+        throw std::runtime_error("unknown column [" + name + "] in the header of " + filename);
+      }
+      header.push_back(column->second);
+    }
+  }
+  if (std::find(header.begin(), header.end(), &BatchJob::ref_filename) == header.end() ||
+      std::find(header.begin(), header.end(), &BatchJob::hyp_filename) == header.end()) {
+    throw std::runtime_error("the header of " + filename + " must name the ref and hyp columns");
+  }
+
+  vector<BatchJob> jobs;
+  while (getline(manifest, line)) {
+    line_number++;
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    auto fields = split_line(line);
+    if (fields.size() != header.size()) {
+      throw std::runtime_error("line " + to_string(line_number) + " of " + filename + " has " +
+                               to_string(fields.size()) + " columns, the header has " + to_string(header.size()));
+    }
+
+    BatchJob job;
+    for (size_t c = 0; c < header.size(); c++) {
+      job.*header[c] = fields[c];
+    }
+    if (job.ref_filename.empty() || job.hyp_filename.empty()) {
+      throw std::runtime_error("line " + to_string(line_number) + " of " + filename + " lacks its ref or hyp");
+    }
+    jobs.push_back(job);
+  }
+
+  if (jobs.empty()) {
+    throw std::runtime_error("no ref/hyp pair listed in " + filename);
+  }
+  return jobs;
+}
+
 std::unique_ptr<FstLoader> FstLoader::MakeReferenceLoader(const std::string& ref_filename,
                                                           const std::string& wer_sidecar_filename,
                                                           const std::string& json_norm_filename,
                                                           bool use_punctuation,
                                                           bool use_case,
-                                                          bool symbols_file_included) {
+                                                          bool symbols_file_included,
+                                                          const std::string& ref_format) {
   auto console = logger::GetLogger("console");
+  string format = InputFormat(ref_filename, ref_format);
+  if (format == "compiled") {
+    console->info("reading compiled reference from {}", ref_filename);
+    if (!json_norm_filename.empty() || !wer_sidecar_filename.empty()) {
+      console->warn("the normalizations and wer sidecar of the compiled reference are used");
+    }
+    return CompiledReference::Read(ref_filename);
+  }
+
   Json::Value obj;
   if (!json_norm_filename.empty()) {
     console->info("reading json norm info from {}", json_norm_filename);
-    ifstream ifs(json_norm_filename);
+    auto ifs = OpenInput(json_norm_filename);
 
     Json::CharReaderBuilder builder;
     builder["collectComments"] = false;
 
     JSONCPP_STRING errs;
-    Json::parseFromStream(builder, ifs, &obj, &errs);
+    Json::parseFromStream(builder, *ifs, &obj, &errs);
 
     console->info("The json we just read [{}] has {} elements from its root", json_norm_filename, obj.size());
   } else {
@@ -247,13 +675,13 @@ std::unique_ptr<FstLoader> FstLoader::MakeReferenceLoader(const std::string& ref
   Json::Value wer_sidecar_obj;
   if (!wer_sidecar_filename.empty()) {
     console->info("reading wer sidecar info from {}", wer_sidecar_filename);
-    ifstream ifs(wer_sidecar_filename);
+    auto ifs = OpenInput(wer_sidecar_filename);
 
     Json::CharReaderBuilder builder;
     builder["collectComments"] = false;
 
     JSONCPP_STRING errs;
-    Json::parseFromStream(builder, ifs, &wer_sidecar_obj, &errs);
+    Json::parseFromStream(builder, *ifs, &wer_sidecar_obj, &errs);
 
     console->info("The json we just read [{}] has {} elements from its root", wer_sidecar_filename, wer_sidecar_obj.size());
   } else {
@@ -264,17 +692,18 @@ std::unique_ptr<FstLoader> FstLoader::MakeReferenceLoader(const std::string& ref
     JSONCPP_STRING errs;
     Json::parseFromStream(builder, ss, &wer_sidecar_obj, &errs);
   }
-  if (EndsWithCaseInsensitive(ref_filename, string(".nlp"))) {
+  if (format == "nlp") {
     NlpReader nlpReader = NlpReader();
     console->info("reading reference nlp from {}", ref_filename);
     auto vec = nlpReader.read_from_disk(ref_filename);
-    return std::make_unique<NlpFstLoader>(vec, obj, wer_sidecar_obj, true, use_punctuation, use_case);
-  } else if (EndsWithCaseInsensitive(ref_filename, string(".ctm"))) {
+    return std::make_unique<NlpFstLoader>(std::move(vec), std::move(obj), std::move(wer_sidecar_obj), true,
+                                          use_punctuation, use_case);
+  } else if (format == "ctm") {
     console->info("reading reference ctm from {}", ref_filename);
     CtmReader ctmReader = CtmReader();
     auto vect = ctmReader.read_from_disk(ref_filename);
-    return std::make_unique<CtmFstLoader>(vect, use_case);
-  } else if (EndsWithCaseInsensitive(ref_filename, string(".fst"))) {
+    return std::make_unique<CtmFstLoader>(std::move(vect), use_case);
+  } else if (format == "fst") {
     if (!symbols_file_included) {
       console->error("a symbols file must be specified if reading an FST.");
     }
@@ -292,21 +721,26 @@ std::unique_ptr<FstLoader> FstLoader::MakeHypothesisLoader(const std::string& hy
                                                            const std::string& hyp_json_norm_filename,
                                                            bool use_punctuation,
                                                            bool use_case,
-                                                           bool symbols_file_included) {
+                                                           bool symbols_file_included,
+                                                           const std::string& hyp_format) {
   auto console = logger::GetLogger("console");
+  string format = InputFormat(hyp_filename, hyp_format);
+  if (format == "compiled") {
+    throw std::runtime_error("a compiled reference can't be used as the hypothesis");
+  }
 
 
 
   Json::Value hyp_json_obj;
   if (!hyp_json_norm_filename.empty()) {
     console->info("reading hypothesis json norm info from {}", hyp_json_norm_filename);
-    ifstream ifs(hyp_json_norm_filename);
+    auto ifs = OpenInput(hyp_json_norm_filename);
 
     Json::CharReaderBuilder builder;
     builder["collectComments"] = false;
 
     JSONCPP_STRING errs;
-    Json::parseFromStream(builder, ifs, &hyp_json_obj, &errs);
+    Json::parseFromStream(builder, *ifs, &hyp_json_obj, &errs);
 
     console->info("The json we just read [{}] has {} elements from its root", hyp_json_norm_filename, hyp_json_obj.size());
   } else {
@@ -319,7 +753,7 @@ std::unique_ptr<FstLoader> FstLoader::MakeHypothesisLoader(const std::string& hy
   }
 
   // loading "hypothesis" inputymb
-  if (EndsWithCaseInsensitive(hyp_filename, string(".nlp"))) {
+  if (format == "nlp") {
     console->info("reading hypothesis nlp from {}", hyp_filename);
     // Make empty json for wer sidecar
     Json::Value hyp_empty_json;
@@ -333,13 +767,14 @@ std::unique_ptr<FstLoader> FstLoader::MakeHypothesisLoader(const std::string& hy
     auto vec = nlpReader.read_from_disk(hyp_filename);
     // for now, nlp files passed as hypothesis won't have their labels handled as such
     // this also mean that json normalization will be ignored
-    return std::make_unique<NlpFstLoader>(vec, hyp_json_obj, hyp_empty_json, false, use_punctuation, use_case);
-  } else if (EndsWithCaseInsensitive(hyp_filename, string(".ctm"))) {
+    return std::make_unique<NlpFstLoader>(std::move(vec), std::move(hyp_json_obj), std::move(hyp_empty_json), false,
+                                          use_punctuation, use_case);
+  } else if (format == "ctm") {
     console->info("reading hypothesis ctm from {}", hyp_filename);
     CtmReader ctmReader = CtmReader();
     auto vect = ctmReader.read_from_disk(hyp_filename);
-    return std::make_unique<CtmFstLoader>(vect, use_case);
-  } else if (EndsWithCaseInsensitive(hyp_filename, string(".fst"))) {
+    return std::make_unique<CtmFstLoader>(std::move(vect), use_case);
+  } else if (format == "fst") {
     if (!symbols_file_included) {
       console->error("a symbols file must be specified if reading an FST.");
     }
@@ -352,3 +787,27 @@ std::unique_ptr<FstLoader> FstLoader::MakeHypothesisLoader(const std::string& hy
     return hypOneBest;
   }
 }
+
+std::string FstLoader::InputFormat(const std::string& filename, const std::string& format) {
+  if (!format.empty()) {
+    static const vector<string> formats = {"nlp", "ctm", "fst", "txt", "compiled"};
+    if (std::find(formats.begin(), formats.end(), format) == formats.end()) {
+      throw std::runtime_error("unknown input format [" + format + "], expected nlp, ctm, fst, txt or compiled");
+    }
+    return format;
+  }
+
+  // call.nlp.gz is an nlp input
+  string name = WithoutCompressionExtension(filename);
+  if (EndsWithCaseInsensitive(name, string(CompiledReference::kExtension))) {
+    return "compiled";
+  } else if (EndsWithCaseInsensitive(name, string(".nlp"))) {
+    return "nlp";
+  } else if (EndsWithCaseInsensitive(name, string(".ctm"))) {
+    return "ctm";
+  } else if (EndsWithCaseInsensitive(name, string(".fst"))) {
+    return "fst";
+  }
+  // everything else, stdin included, is plain text
+  return "txt";
+}
@@ -1,8 +1,11 @@
 
 #include "utilities.h"
 
+#include <fstream>
 #include <iterator>
 
+#include "CompressedStream.h"
+
 // controlling the graph
 const std::string EPSILON = "<eps>";
 const std::string INS = "<ins>";
@@ -234,13 +237,50 @@ string GetClassLabel(string best_label) {
   return classlabel;
 }
 
-string UnicodeLowercase(string token) {
+// returns false as soon as a multi-byte UTF-8 sequence shows up
+static bool LowercaseAscii(const string &token, string &lower_cased) {
+  lower_cased = token;
+  for (auto &c : lower_cased) {
+    if (static_cast<unsigned char>(c) >= 0x80) {
+      return false;
+    }
+    if (c >= 'A' && c <= 'Z') {
+      c += 'a' - 'A';
+    }
+  }
+  return true;
+}
+
+static string IcuLowercase(const string &token) {
   icu::UnicodeString utoken = icu::UnicodeString::fromUTF8(token);
   std::string lower_cased;
   utoken.toLower().toUTF8String(lower_cased);
   return lower_cased;
 }
 
+string UnicodeLowercase(const string &token) {
+  std::string lower_cased;
+  if (LowercaseAscii(token, lower_cased)) {
+    return lower_cased;
+  }
+  return IcuLowercase(token);
+}
+
+string CaseFolder::Lowercase(const string &token) {
+  std::string lower_cased;
+  if (LowercaseAscii(token, lower_cased)) {
+    return lower_cased;
+  }
+
+  auto it = cache_.find(token);
+  if (it != cache_.end()) {
+    return it->second;
+  }
+  lower_cased = IcuLowercase(token);
+  cache_.emplace(token, lower_cased);
+  return lower_cased;
+}
+
 bool EndsWithCaseInsensitive(const string &value, const string &ending) {
   if (ending.size() > value.size()) {
     return false;
@@ -248,3 +288,33 @@ bool EndsWithCaseInsensitive(const string &value, const string &ending) {
   return equal(ending.rbegin(), ending.rend(), value.rbegin(),
                [](const char a, const char b) { return tolower(a) == tolower(b); });
 }
+
+std::unique_ptr<std::istream> OpenInput(const string &filename) {
+  Compression compression = CompressionOf(filename);
+  if (compression != Compression::kNone) {
+    return OpenCompressedInput(filename, compression);
+  }
+  if (filename == "-") {
+    return std::unique_ptr<std::istream>(new std::istream(std::cin.rdbuf()));
+  }
+  std::unique_ptr<std::istream> input(new std::ifstream(filename));
+  if (!*input) {
+    throw std::runtime_error("Cannot open input file " + filename);
+  }
+  return input;
+}
+
+std::unique_ptr<std::ostream> OpenOutput(const string &filename) {
+  Compression compression = CompressionOf(filename);
+  if (compression != Compression::kNone) {
+    return OpenCompressedOutput(filename, compression);
+  }
+  if (filename == "-") {
+    return std::unique_ptr<std::ostream>(new std::ostream(std::cout.rdbuf()));
+  }
+  std::unique_ptr<std::ostream> output(new std::ofstream(filename));
+  if (!*output) {
+    throw std::runtime_error("Cannot open output file " + filename);
+  }
+  return output;
+}
@@ -20,8 +20,10 @@
 #include <iterator>
 #include <locale>
 #include <map>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <fst/fstlib.h>
@@ -213,6 +215,10 @@ template <typename StringFunction>
 void splitString(const string &str, char delimiter, StringFunction f);
 
 bool EndsWithCaseInsensitive(const string &value, const string &ending);
+// "-" names stdin for the inputs and stdout for the outputs, and .gz/.zst files are
+// (de)compressed on the fly.  Both throw when the file can't be opened
+std::unique_ptr<std::istream> OpenInput(const string &filename);
+std::unique_ptr<std::ostream> OpenOutput(const string &filename);
 bool iequals(const std::string &, const std::string &);
 
 // string manip
@@ -239,6 +245,16 @@ string GetLabelNameFromClassLabel(string classLabel);
 
 string GetClassLabel(string best_label);
 
-string UnicodeLowercase(string token);
+string UnicodeLowercase(const string &token);
+
+// Lowercases tokens for the loaders.  Pure ASCII tokens skip the ICU round trip and
+// the others are memoized, since the same words keep coming back in a transcript.
+class CaseFolder {
+ public:
+  string Lowercase(const string &token);
+
+ private:
+  unordered_map<string, string> cache_;
+};
 
 #endif  // UTILITIES_H_
@@ -4,18 +4,8 @@
 
 using namespace std;
 
-void RecordWerResult(Json::Value &json, WerResult wr) {
-  json["insertions"] = wr.insertions;
-  json["deletions"] = wr.deletions;
-  json["substitutions"] = wr.substitutions;
-  json["numWordsInReference"] = wr.numWordsInReference;
-  json["numErrors"] = wr.NumErrors();
-  json["wer"] = wr.WER();
-}
-
-void RecordWer(wer_alignment &topAlignment) {
+void RecordWer(wer_alignment &topAlignment, WerReport &report) {
   auto logger = logger::GetOrCreateLogger("wer");
-  logger->set_level(spdlog::level::info);
 
   logger->info("best WER: {0}/{1} = {2:.4f} (Total words in reference: {1})", topAlignment.NumErrors(),
                topAlignment.numWordsInReference, topAlignment.WER());
@@ -23,16 +13,13 @@ void RecordWer(wer_alignment &topAlignment) {
                topAlignment.substitutions);
   logger->info("best WER: Precision:{:01.6f} Recall:{:01.6f}", topAlignment.precision, topAlignment.recall);
 
-  jsonLogger::JsonLogger::getLogger().root["wer"]["bestWER"]["wer"] = topAlignment.WER();
-  jsonLogger::JsonLogger::getLogger().root["wer"]["bestWER"]["numErrors"] = topAlignment.NumErrors();
-  jsonLogger::JsonLogger::getLogger().root["wer"]["bestWER"]["numWordsInReference"] = topAlignment.numWordsInReference;
-  jsonLogger::JsonLogger::getLogger().root["wer"]["bestWER"]["insertions"] = topAlignment.insertions;
-  jsonLogger::JsonLogger::getLogger().root["wer"]["bestWER"]["deletions"] = topAlignment.deletions;
-  jsonLogger::JsonLogger::getLogger().root["wer"]["bestWER"]["substitutions"] = topAlignment.substitutions;
-  jsonLogger::JsonLogger::getLogger().root["wer"]["bestWER"]["precision"] = topAlignment.precision;
-  jsonLogger::JsonLogger::getLogger().root["wer"]["bestWER"]["recall"] = topAlignment.recall;
-  jsonLogger::JsonLogger::getLogger().root["wer"]["bestWER"]["meta"] = Json::objectValue;
-  jsonLogger::JsonLogger::getLogger().root["wer"]["classWER"] = Json::objectValue;
+  report.has_best_wer = true;
+  report.best_wer = {topAlignment.insertions, topAlignment.deletions, topAlignment.substitutions,
+                     topAlignment.numWordsInReference, topAlignment.numWordsInHypothesis};
+  report.best_wer_value = topAlignment.WER();
+  report.best_precision = topAlignment.precision;
+  report.best_recall = topAlignment.recall;
+  report.class_wer.clear();
 
   if (topAlignment.label_alignments.size() > 0) {
     logger->info(" -- class label information found --");
@@ -63,13 +50,12 @@ void RecordWer(wer_alignment &topAlignment) {
       //  info.first, (float)info.second / (float)info.first, largestClassNameSize);
       logger->info("class {:{}} WER: {}/{} = {:.4f}", label_name, largestClassNameSize, wr.NumErrors(),
                    wr.numWordsInReference, wr.WER());
-      RecordWerResult(jsonLogger::JsonLogger::getLogger().root["wer"]["classWER"][label_name], wr);
-      jsonLogger::JsonLogger::getLogger().root["wer"]["classWER"][label_name]["meta"] = Json::objectValue;
+      report.class_wer[label_name] = wr;
     }
   }
 }
 
-void RecordSentenceWer(const vector<Stitching> &stitches) {
+void RecordSentenceWer(const vector<Stitching> &stitches, WerReport &report) {
   std::set<std::string> eos_punc{".", "?", "!"};
   vector<WerResult> sentence_wers;
   WerResult curr_wer = {0, 0, 0, 0, 0};
@@ -91,17 +77,14 @@ void RecordSentenceWer(const vector<Stitching> &stitches) {
   }
 
   // Add to log
-  for (int i=0; i < sentence_wers.size(); i++) {
-    RecordWerResult(jsonLogger::JsonLogger::getLogger().root["wer"]["sentenceWer"][i], sentence_wers[i]);
-  }
+  report.sentence_wer = std::move(sentence_wers);
 }
 
 
-void RecordSpeakerWer(const vector<Stitching> &stitches) {
+void RecordSpeakerWer(const vector<Stitching> &stitches, WerReport &report) {
   // Note: stitches must have already been aligned to NLP rows
   // Logic for segment boundaries copied from speaker switch WER code
   auto logger = logger::GetOrCreateLogger("wer");
-  logger->set_level(spdlog::level::info);
 
   unordered_map<string, WerResult> speaker_wers;
   string last_speaker = "";
@@ -149,8 +132,7 @@ void RecordSpeakerWer(const vector<Stitching> &stitches) {
     string speaker_id = a.first;
     WerResult wr = a.second;
     logger->info("speaker {} WER: {}/{} = {:.4f}", speaker_id, wr.NumErrors(), wr.numWordsInReference, wr.WER());
-    RecordWerResult(jsonLogger::JsonLogger::getLogger().root["wer"]["speakerWER"][speaker_id], wr);
-    jsonLogger::JsonLogger::getLogger().root["wer"]["speakerWER"][speaker_id]["meta"] = Json::objectValue;
+    report.speaker_wer[speaker_id] = wr;
   }
 }
 
@@ -202,10 +184,9 @@ vector<int> GetSpeakerSwitchIndices(const vector<Stitching> &stitches) {
   return speakerSwitches;
 }
 
-void RecordSpeakerSwitchWer(const vector<Stitching> &stitches, int speaker_switch_context_size) {
+void RecordSpeakerSwitchWer(const vector<Stitching> &stitches, int speaker_switch_context_size, WerReport &report) {
   // Speaker switch WER is logged to logger and JSON logger
   auto logger = logger::GetOrCreateLogger("wer");
-  logger->set_level(spdlog::level::info);
 
   vector<int> switch_indices = GetSpeakerSwitchIndices(stitches);
 
@@ -246,14 +227,13 @@ void RecordSpeakerSwitchWer(const vector<Stitching> &stitches, int speaker_switc
   logger->info("Speaker switch WER: {0}/{1} = {2:.4f} (Total reference words: {1})", wer.NumErrors(),
                wer.numWordsInReference, wer.WER());
   logger->info("Speaker switch WER: INS:{} DEL:{} SUB:{}", wer.insertions, wer.deletions, wer.substitutions);
-  RecordWerResult(jsonLogger::JsonLogger::getLogger().root["wer"]["speakerSwitchWER"], wer);
-  jsonLogger::JsonLogger::getLogger().root["wer"]["speakerSwitchWER"]["meta"]["windowSize"] =
-      speaker_switch_context_size;
+  report.has_speaker_switch_wer = true;
+  report.speaker_switch_wer = wer;
+  report.speaker_switch_window_size = speaker_switch_context_size;
 }
 
-void RecordCaseWer(const vector<Stitching> &aligned_stitches) {
+void RecordCaseWer(const vector<Stitching> &aligned_stitches, WerReport &report) {
   auto logger = logger::GetOrCreateLogger("wer");
-  logger->set_level(spdlog::level::info);
   int true_positive = 0;  // h is upper and r is upper
   int false_positive = 0;  // h is upper and r is lower
   int false_negative = 0;  // h is lower and r is upper
@@ -328,23 +308,15 @@ void RecordCaseWer(const vector<Stitching> &aligned_stitches) {
   logger->info("case WER, (matching words only): Precision:{:01.6f} Recall:{:01.6f}", base_precision, base_recall);
   logger->info("case WER, (all including substitutions): Precision:{:01.6f} Recall:{:01.6f}", precision_with_sub, recall_with_sub);
 
-  jsonLogger::JsonLogger::getLogger().root["wer"]["caseWER"]["matching"]["precision"] = base_precision;
-  jsonLogger::JsonLogger::getLogger().root["wer"]["caseWER"]["matching"]["recall"] = base_recall;
-  jsonLogger::JsonLogger::getLogger().root["wer"]["caseWER"]["matching"]["true_positive"] = true_positive;
-  jsonLogger::JsonLogger::getLogger().root["wer"]["caseWER"]["matching"]["false_positive"] = false_positive;
-  jsonLogger::JsonLogger::getLogger().root["wer"]["caseWER"]["matching"]["false_negative"] = false_negative;
-
-  jsonLogger::JsonLogger::getLogger().root["wer"]["caseWER"]["all"]["precision"] = precision_with_sub;
-  jsonLogger::JsonLogger::getLogger().root["wer"]["caseWER"]["all"]["recall"] = recall_with_sub;
-  jsonLogger::JsonLogger::getLogger().root["wer"]["caseWER"]["all"]["true_positive"] = sub_tp + true_positive;
-  jsonLogger::JsonLogger::getLogger().root["wer"]["caseWER"]["all"]["false_positive"] = sub_fp + false_positive;
-  jsonLogger::JsonLogger::getLogger().root["wer"]["caseWER"]["all"]["false_negative"] = sub_fn + false_negative;
+  report.has_case_wer = true;
+  report.case_matching = {base_precision, base_recall, true_positive, false_positive, false_negative};
+  report.case_all = {precision_with_sub, recall_with_sub, sub_tp + true_positive, sub_fp + false_positive,
+                     sub_fn + false_negative};
 }
 
-void RecordTagWer(const vector<Stitching>& stitches) {
+void RecordTagWer(const vector<Stitching>& stitches, WerReport &report) {
   // Record per wer_tag ID stats
   auto logger = logger::GetOrCreateLogger("wer");
-  logger->set_level(spdlog::level::info);
   std::map<std::string, WerResult> wer_results;
 
   for (const auto &stitch : stitches) {
@@ -368,8 +340,7 @@ void RecordTagWer(const vector<Stitching>& stitches) {
     string wer_id = a.first;
     WerResult wr = a.second;
     logger->info("Wer Entity ID {} WER: {}/{} = {:.4f}", wer_id, wr.NumErrors(), wr.numWordsInReference, wr.WER());
-    RecordWerResult(jsonLogger::JsonLogger::getLogger().root["wer"]["wer_tag"][wer_id], wr);
-    jsonLogger::JsonLogger::getLogger().root["wer"]["wer_tag"][wer_id]["meta"] = Json::objectValue;
+    report.tag_wer[wer_id] = wr;
   }
 }
 
@@ -528,10 +499,9 @@ void AddErrorGroup(ErrorGroups &groups, size_t &line, string &ref, string &hyp)
 
 void WriteSbs(wer_alignment &topAlignment, const vector<Stitching>& stitches, string sbs_filename) {
   auto logger = logger::GetOrCreateLogger("wer");
-  logger->set_level(spdlog::level::info);
 
-  ofstream myfile;
-  myfile.open(sbs_filename);
+  auto output = OpenOutput(sbs_filename);
+  ostream &myfile = *output;
 
   AlignmentTraversor visitor(topAlignment);
   string prev_tk_classLabel = "";
@@ -603,31 +573,10 @@ void WriteSbs(wer_alignment &topAlignment, const vector<Stitching>& stitches, st
     myfile << fmt::format("{0:>20}\t{1}", group.first, group.second) << endl;
   }
 
-  myfile.close();
+  myfile.flush();
 }
 
-void JsonLogUnigramBigramStats(wer_alignment &topAlignment) {
-  for (const auto &a : topAlignment.unigram_stats) {
-    string word = a.first;
-    gram_error_counter u = a.second;
-    jsonLogger::JsonLogger::getLogger().root["wer"]["unigrams"][word]["correct"] = u.correct;
-    jsonLogger::JsonLogger::getLogger().root["wer"]["unigrams"][word]["insertions"] = u.ins;
-    jsonLogger::JsonLogger::getLogger().root["wer"]["unigrams"][word]["deletions"] = u.del;
-    jsonLogger::JsonLogger::getLogger().root["wer"]["unigrams"][word]["substitutions_fp"] = u.subst_fp;
-    jsonLogger::JsonLogger::getLogger().root["wer"]["unigrams"][word]["substitutions_fn"] = u.subst_fn;
-    jsonLogger::JsonLogger::getLogger().root["wer"]["unigrams"][word]["precision"] = u.precision;
-    jsonLogger::JsonLogger::getLogger().root["wer"]["unigrams"][word]["recall"] = u.recall;
-  }
-
-  for (const auto &a : topAlignment.bigrams_stats) {
-    string word = a.first;
-    gram_error_counter u = a.second;
-    jsonLogger::JsonLogger::getLogger().root["wer"]["bigrams"][word]["correct"] = u.correct;
-    jsonLogger::JsonLogger::getLogger().root["wer"]["bigrams"][word]["insertions"] = u.ins;
-    jsonLogger::JsonLogger::getLogger().root["wer"]["bigrams"][word]["deletions"] = u.del;
-    jsonLogger::JsonLogger::getLogger().root["wer"]["bigrams"][word]["substitutions_fp"] = u.subst_fp;
-    jsonLogger::JsonLogger::getLogger().root["wer"]["bigrams"][word]["substitutions_fn"] = u.subst_fn;
-    jsonLogger::JsonLogger::getLogger().root["wer"]["bigrams"][word]["precision"] = u.precision;
-    jsonLogger::JsonLogger::getLogger().root["wer"]["bigrams"][word]["recall"] = u.recall;
-  }
+void JsonLogUnigramBigramStats(wer_alignment &topAlignment, WerReport &report) {
+  report.unigrams = topAlignment.unigram_stats;
+  report.bigrams = topAlignment.bigrams_stats;
 }
@@ -0,0 +1,96 @@
+#define CATCH_CONFIG_MAIN
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include "../third-party/catch2/single_include/catch2/catch.hpp"
+#include "test-utilties.h"
+
+using Catch::Matchers::Contains;
+
+#include "src/Aligner.h"
+#include "src/fstalign_c.h"
+
+static vector<string> ReadTokens(const std::string &filename) {
+  std::ifstream stream(filename);
+  return vector<string>(std::istream_iterator<string>(stream), std::istream_iterator<string>());
+}
+
+TEST_CASE("Aligner") {
+  AlignerConfig config;
+  Aligner aligner(config);
+
+  SECTION("token sequences") {
+    auto result = aligner.Align(ReadTokens(TEST_DATA + "test1.ref.txt"), ReadTokens(TEST_DATA + "test1.hyp.txt"));
+    REQUIRE(result.wer().NumErrors() == 10);
+    REQUIRE(result.wer().numWordsInReference == 76);
+    REQUIRE(result.wer().insertions == 1);
+    REQUIRE(result.wer().deletions == 2);
+    REQUIRE(result.wer().substitutions == 7);
+    REQUIRE_THAT(result.ToJson(), Contains("\"numErrors\":10"));
+  }
+
+  SECTION("aligned tokens") {
+    auto result = aligner.Align({"the", "Cat", "sat", "on", "the", "mat"}, {"the", "cat", "sat", "on", "a", "mat", "now"});
+    REQUIRE(result.wer().NumErrors() == 2);
+    REQUIRE(result.tokens.size() == 7);
+    REQUIRE(result.tokens[1].ref == "cat");
+    REQUIRE(result.tokens[1].comment.empty());
+    REQUIRE(result.tokens[4].comment == "sub(a)");
+    REQUIRE(result.tokens[6].ref == "<ins>");
+    REQUIRE(result.tokens[6].comment == "ins");
+  }
+
+  SECTION("concurrent alignments") {
+    vector<int> errors(4, -1);
+    vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+      threads.emplace_back([&, t]() {
+        vector<string> hyp = {"one", "two", "three", "four"};
+        hyp.resize(4 - t);
+        errors[t] = aligner.Align({"one", "two", "three", "four"}, hyp).wer().NumErrors();
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    REQUIRE(errors == vector<int>({0, 1, 2, 3}));
+  }
+}
+
+TEST_CASE("C API") {
+  fstalign_config config;
+  fstalign_config_init(&config);
+  char *error = nullptr;
+
+  SECTION("alignment") {
+    fstalign_aligner *aligner = fstalign_aligner_new(&config, &error);
+    REQUIRE(aligner != nullptr);
+
+    fstalign_result *result = fstalign_align_text(aligner, "the cat sat on the mat", "the cat sat on mat", &error);
+    REQUIRE(result != nullptr);
+
+    fstalign_wer wer;
+    fstalign_result_wer(result, &wer);
+    REQUIRE(wer.num_errors == 1);
+    REQUIRE(wer.deletions == 1);
+    REQUIRE(wer.num_words_in_reference == 6);
+
+    REQUIRE(fstalign_result_size(result) == 6);
+    fstalign_token token;
+    fstalign_result_token(result, 4, &token);
+    REQUIRE(std::string(token.hyp) == "<del>");
+    REQUIRE(std::string(token.comment) == "del");
+    REQUIRE_THAT(std::string(fstalign_result_json(result)), Contains("\"deletions\":1"));
+
+    fstalign_result_free(result);
+    fstalign_aligner_free(aligner);
+  }
+
+  SECTION("errors") {
+    config.synonyms_filename = "../test/data/missing.rules.txt";
+    REQUIRE(fstalign_aligner_new(&config, &error) == nullptr);
+    REQUIRE(error != nullptr);
+    REQUIRE_THAT(std::string(error), Contains("Cannot open input file"));
+    fstalign_free_error(error);
+  }
+}
@@ -11,9 +11,10 @@
 StdVectorFst GetFstFromString(SymbolTable *symbols, const std::string str) {
   OneBestFstLoader loader;
   loader.BuildFromString(str);
-  loader.addToSymbolTable(*symbols);
+  SymbolInterner vocab(*symbols);
+  std::vector<int> token_ids = loader.convertToIntVector(vocab);
   std::vector<int> map;
-  return  loader.convertToFst(*symbols, map);
+  return  loader.convertToFst(vocab, token_ids, map);
 }
 
 StdVectorFst GetStdFstA() {
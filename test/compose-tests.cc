@@ -8,6 +8,7 @@
 using Catch::Matchers::Contains;
 
 #include "src/AdaptedComposition.h"
+#include "src/SynonymEngine.h"
 #include "src/logging.h"
 
 // there just to setup the loggers
@@ -170,3 +171,38 @@ TEST_CASE("composition()") {
     REQUIRE(found_deleted_end);
   }
 }
+
+TEST_CASE("synonym labels") {
+  // number of ___<id>_SYN_<lhs>-<rhs>___ symbols after applying the rules to the text
+  auto count_synonym_labels = [](const std::string &text) {
+    SymbolTable symbols;
+    symbols.AddSymbol("<eps>");
+    auto fst = GetFstFromString(&symbols, text);
+
+    SynonymOptions opts;
+    SynonymEngine engine(opts);
+    engine.ParseStrings({"i am | i'm ; i am"});
+    engine.ApplyToFst(fst, symbols);
+
+    int labels = 0;
+    for (SymbolTableIterator it(symbols); !it.Done(); it.Next()) {
+      if (isSynonymLabel(it.Symbol())) {
+        labels++;
+      }
+    }
+    return labels;
+  };
+
+  SECTION("one label per alternative, whatever the number of matches") {
+    std::string text = "i am here";
+    REQUIRE(count_synonym_labels(text) == 2);
+    for (int i = 0; i < 50; i++) {
+      text += " and i am here";
+    }
+    REQUIRE(count_synonym_labels(text) == 2);
+  }
+
+  SECTION("matches following each other get their own label") {
+    REQUIRE(count_synonym_labels("i am i am i am") == 4);
+  }
+}
@@ -131,6 +131,29 @@ TEST_CASE("map-repeat") {
   REQUIRE(dist == 3);
 }
 
+TEST_CASE("edit-operations") {
+  vint a = {1, 2, 3, 4, 5};
+  vint b = {1, 8, 3, 5, 6};
+
+  auto ops = GetEditOperations(a, b);
+  std::vector<EditOperation> expected = {EDIT_MATCH, EDIT_SUB, EDIT_MATCH, EDIT_DEL, EDIT_MATCH, EDIT_INS};
+  REQUIRE(ops == expected);
+
+  // on ties, the substitution comes last and the deletion first
+  vint c = {1, 2};
+  vint d = {3};
+  ops = GetEditOperations(c, d);
+  expected = {EDIT_DEL, EDIT_SUB};
+  REQUIRE(ops == expected);
+
+  vint empty = {};
+  ops = GetEditOperations(empty, a);
+  REQUIRE(ops.size() == a.size());
+  for (auto op : ops) {
+    REQUIRE(op == EDIT_INS);
+  }
+}
+
 TEST_CASE("test-long-seq") {
   srand(time(NULL));
   int ins_rate = 20;  // over 1k, so 2%
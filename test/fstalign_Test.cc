@@ -1,6 +1,13 @@
 #define CATCH_CONFIG_MAIN
 #include "../third-party/catch2/single_include/catch2/catch.hpp"
 
+#include <json/json.h>
+#include <sys/stat.h>
+
+#include <sstream>
+#include <vector>
+
+#include "src/Ctm.h"
 #include "test-utilties.h"
 
 using Catch::Matchers::Contains;
@@ -83,6 +90,12 @@ TEST_CASE_METHOD(UniqueTestsFixture, "main-standard-composition()") {
     REQUIRE(compareFiles(sbs_output.c_str(), testFile.c_str()));
   }
 
+  SECTION("syn_1 (the standard composition skips the levenshtein fast path)") {
+    const auto result =
+        exec(command("wer", approach, "syn_1.ref.txt", "syn_1.hyp.txt", sbs_output) + " --json-log - 2> /dev/null");
+    REQUIRE_THAT(result, !Contains("\"levenshteinFastPath\""));
+  }
+
   SECTION("syn_1 (with synonyms)") {
     const auto result = exec(command("wer", approach, "syn_1.ref.txt", "syn_1.hyp.txt", sbs_output, "", TEST_SYNONYMS));
 
@@ -184,6 +197,13 @@ TEST_CASE_METHOD(UniqueTestsFixture, "main-standard-composition()") {
     REQUIRE_THAT(result, Contains("WER: INS:0 DEL:0 SUB:1"));
   }
 
+  SECTION("syn_11 (repeated synonyms)") {
+    const auto result = exec(command("wer", approach, "syn_11.ref.txt", "syn_11.hyp.txt", sbs_output, "", TEST_SYNONYMS));
+
+    REQUIRE_THAT(result, Contains("WER: 0/9 = 0.0"));
+    REQUIRE_THAT(result, Contains("WER: INS:0 DEL:0 SUB:0"));
+  }
+
   // synonyms for noise codes
 
   SECTION("noise_1 (wer -- hyp1)") {
@@ -369,6 +389,115 @@ TEST_CASE_METHOD(UniqueTestsFixture, "main-standard-composition()") {
     REQUIRE_THAT(result, Contains("WER: Precision:0.893333 Recall:0.881579"));
   }
 
+  SECTION("bigram_1 (n-gram stats)") {
+    const auto json_log = sbs_output + ".json";
+    const auto ngrams_log = sbs_output + ".ngrams.jsonl";
+    auto read_file = [](const std::string &filename) {
+      std::ifstream file(filename);
+      return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    };
+
+    // the streamed log is laid out as jsoncpp writes it: sorted members, 17 digits numbers
+    exec(command("wer", approach, "test1.ref.txt", "test1.hyp.txt", sbs_output) + " --json-log " + json_log);
+    auto json_content = read_file(json_log);
+    REQUIRE_THAT(json_content, Contains("\"unigrams\""));
+    std::istringstream json_stream(json_content);
+    Json::Value parsed;
+    json_stream >> parsed;
+    std::ostringstream jsoncpp_content;
+    jsoncpp_content << parsed << std::endl;
+    REQUIRE(json_content == jsoncpp_content.str());
+
+    const auto result = exec(command("wer", approach, "test1.ref.txt", "test1.hyp.txt", sbs_output) + " --json-log " +
+                             json_log + " --json-log-ngrams " + ngrams_log);
+    REQUIRE_THAT(result, Contains("WER: 10/76 = 0.1316"));
+    json_content = read_file(json_log);
+    REQUIRE_THAT(json_content, Contains("\"bestWER\""));
+    REQUIRE_THAT(json_content, !Contains("\"unigrams\""));
+    const auto ngrams_content = read_file(ngrams_log);
+    REQUIRE_THAT(ngrams_content, Contains("{\"type\":\"unigram\",\"gram\":"));
+    REQUIRE_THAT(ngrams_content, Contains("{\"type\":\"bigram\",\"gram\":"));
+    // the unigrams then the bigrams, each sorted by n-gram
+    std::istringstream ngrams_lines(ngrams_content);
+    std::string line;
+    std::vector<std::pair<std::string, std::string>> grams;
+    while (std::getline(ngrams_lines, line)) {
+      std::istringstream line_stream(line);
+      Json::Value gram;
+      line_stream >> gram;
+      grams.emplace_back(gram["type"].asString(), gram["gram"].asString());
+    }
+    REQUIRE(!grams.empty());
+    REQUIRE(std::is_sorted(grams.begin(), grams.end(), [](const std::pair<std::string, std::string> &a,
+                                                          const std::pair<std::string, std::string> &b) {
+      // "unigram" before "bigram"
+      return a.first != b.first ? a.first > b.first : a.second < b.second;
+    }));
+
+    remove(json_log.c_str());
+    remove(ngrams_log.c_str());
+  }
+
+  SECTION("perf section") {
+    const auto result = exec(command("wer", approach, "twenty.ref.nlp", "twenty.hyp.txt", sbs_output, "",
+                                     TEST_SYNONYMS, "twenty.norm.json") +
+                             " --json-log - 2> /dev/null");
+
+    REQUIRE_THAT(result, Contains("\"preparationMs\""));
+    REQUIRE_THAT(result, Contains("\"synonymRules\""));
+    REQUIRE_THAT(result, Contains("\"refSynonyms\""));
+    REQUIRE_THAT(result, Contains("\"phasesMs\""));
+    REQUIRE_THAT(result, Contains("\"loadRef\""));
+    REQUIRE_THAT(result, Contains("\"walk\""));
+    REQUIRE_THAT(result, Contains("\"counters\""));
+    REQUIRE_THAT(result, Contains("\"walkerStatesPopped\""));
+    REQUIRE_THAT(result, Contains("\"walkerHeapHighWater\""));
+    REQUIRE_THAT(result, Contains("\"memoryPeakBytes\""));
+    REQUIRE_THAT(result, Contains("\"walker\""));
+    REQUIRE_THAT(result, Contains("\"stitches\""));
+  }
+
+  SECTION("memory limit") {
+    const auto result = exec(command("wer", approach, "twenty.ref.nlp", "twenty.hyp.txt", sbs_output, "",
+                                     TEST_SYNONYMS, "twenty.norm.json") +
+                             " --memory-limit 0.0001 --json-log - 2>&1");
+
+    REQUIRE_THAT(result, Contains("memory limit of 0.1 KB exceeded when symbols grew"));
+    REQUIRE_THAT(result, Contains("\"memoryPeakBytes\""));
+  }
+
+  SECTION("memory limit in preparation") {
+    // above the symbols, below the reference fst with its normalizations
+    const auto result = exec(command("wer", approach, "twenty.ref.nlp", "twenty.hyp.txt", sbs_output, "",
+                                     TEST_SYNONYMS, "twenty.norm.json") +
+                             " --memory-limit 0.002 --json-log - 2>&1");
+
+    REQUIRE_THAT(result, Contains("memory limit of 2.0 KB exceeded when refFst grew"));
+    REQUIRE_THAT(result, Contains("\"refFst\""));
+    REQUIRE_THAT(result, !Contains("\"walker\""));
+  }
+
+  SECTION("walker trace") {
+    const auto trace = std::string{"test1.walker_trace.csv"};
+    const auto result =
+        exec(command("wer", approach, "test1.ref.txt", "test1.hyp.txt", sbs_output) + " --walker-trace " + trace);
+
+    // the same alignment, walked rather than taking the levenshtein fast path
+    REQUIRE_THAT(result, Contains("WER: 10/76 = 0.1316"));
+    std::ifstream trace_file(trace);
+    const std::string trace_content((std::istreambuf_iterator<char>(trace_file)), std::istreambuf_iterator<char>());
+    REQUIRE_THAT(trace_content,
+                 Contains("event,loop,state,refA,refB,numWords,numErrors,cost,heapA,heapB,enqueued,pruned\n"));
+    // the standard composition doesn't know the reference and hypothesis states
+    REQUIRE_THAT(trace_content, Contains("\nexpand,1,0,-1,-1,"));
+
+#ifdef FSTALIGN_TRACE_SUMMARY
+    const auto summary = exec(std::string{FSTALIGN_TRACE_SUMMARY} + " " + trace);
+    REQUIRE_THAT(summary, Contains("the trace comes from the standard composition"));
+#endif
+    remove(trace.c_str());
+  }
+
   // test oracle WER calculation with lattice FST archive as hypothesis input
   SECTION("oracle_1") {
     const auto result = exec(
@@ -453,6 +582,45 @@ TEST_CASE_METHOD(UniqueTestsFixture, "main-adapted-composition()") {
     REQUIRE(compareFiles(sbs_output.c_str(), testFile.c_str()));
   }
 
+  SECTION("syn_1 (without levenshtein fast path)") {
+    const auto result = exec(command("wer", approach, "syn_1.ref.txt", "syn_1.hyp.txt", sbs_output, "", "", nullptr,
+                                     false, -1, "--disable-levenshtein-fast-path"));
+    const auto testFile = std::string{TEST_DATA} + "syn_1.hyp.sbs";
+
+    REQUIRE_THAT(result, Contains("WER: 8/21 = 0.3810"));
+    REQUIRE_THAT(result, Contains("WER: INS:3 DEL:2 SUB:3"));
+
+    REQUIRE(compareFiles(sbs_output.c_str(), testFile.c_str()));
+  }
+
+  // the fast path must write the same side-by-side as the alignment graph
+  SECTION("levenshtein fast path (same output as the graph)") {
+    const auto graph_sbs = sbs_output + ".graph";
+    const std::vector<std::pair<const char *, const char *>> runs = {
+        // CTM hypothesis with substitutions, insertions and deletions
+        {"fast_path_1.ref.txt", "fast_path_1.hyp.ctm"},
+        // equal-cost alignments: either repetition can be deleted, either word of the swap matched
+        {"fast_path_2.ref.txt", "fast_path_2.hyp.txt"},
+        {"syn_1.ref.txt", "syn_1.hyp.txt"},
+    };
+    for (const auto &run : runs) {
+      const auto fast = exec(command("wer", approach, run.first, run.second, sbs_output) + " --json-log - 2> /dev/null");
+      const auto graph = exec(command("wer", approach, run.first, run.second, graph_sbs, "", "", nullptr, false, -1,
+                                      "--disable-levenshtein-fast-path --json-log - 2> /dev/null"));
+
+      REQUIRE_THAT(fast, Contains("\"levenshteinFastPath\""));
+      REQUIRE_THAT(graph, !Contains("\"levenshteinFastPath\""));
+      REQUIRE(compareFiles(sbs_output.c_str(), graph_sbs.c_str()));
+    }
+    remove(graph_sbs.c_str());
+  }
+
+  SECTION("levenshtein fast path (skipped for other numbests)") {
+    const auto result = exec(command("wer", approach, "syn_1.ref.txt", "syn_1.hyp.txt", sbs_output, "", "", nullptr,
+                                     false, -1, "--numbests 5 --json-log - 2> /dev/null"));
+    REQUIRE_THAT(result, !Contains("\"levenshteinFastPath\""));
+  }
+
   SECTION("syn_1 (with synonyms)") {
     const auto result = exec(command("wer", approach, "syn_1.ref.txt", "syn_1.hyp.txt", sbs_output, "", TEST_SYNONYMS));
 
@@ -553,6 +721,13 @@ TEST_CASE_METHOD(UniqueTestsFixture, "main-adapted-composition()") {
     REQUIRE_THAT(result, Contains("WER: INS:0 DEL:0 SUB:1"));
   }
 
+  SECTION("syn_11 (repeated synonyms)") {
+    const auto result = exec(command("wer", approach, "syn_11.ref.txt", "syn_11.hyp.txt", sbs_output, "", TEST_SYNONYMS));
+
+    REQUIRE_THAT(result, Contains("WER: 0/9 = 0.0"));
+    REQUIRE_THAT(result, Contains("WER: INS:0 DEL:0 SUB:0"));
+  }
+
   SECTION("syn_compound_1") {
     const auto result = exec(
         command("wer", approach, "syn_compound_1.ref.txt", "syn_compound_1.hyp.txt", sbs_output, "", TEST_SYNONYMS));
@@ -840,6 +1015,46 @@ TEST_CASE_METHOD(UniqueTestsFixture, "main-adapted-composition()") {
     REQUIRE_THAT(result, Contains("WER: Precision:0.893333 Recall:0.881579"));
   }
 
+  SECTION("walker trace") {
+    const auto trace = std::string{"test1.walker_trace.csv"};
+    const auto result =
+        exec(command("wer", approach, "test1.ref.txt", "test1.hyp.txt", sbs_output) + " --walker-trace " + trace);
+    REQUIRE_THAT(result, Contains("WER: 10/76 = 0.1316"));
+
+    // every row is located at the reference and hypothesis states of the composed state
+    std::ifstream trace_file(trace);
+    std::string line;
+    REQUIRE(std::getline(trace_file, line));
+    REQUIRE(line == "event,loop,state,refA,refB,numWords,numErrors,cost,heapA,heapB,enqueued,pruned");
+    int expansions = 0;
+    int prunings = 0;
+    while (std::getline(trace_file, line)) {
+      std::vector<std::string> fields;
+      std::stringstream row(line);
+      for (std::string field; std::getline(row, field, ',');) {
+        fields.push_back(field);
+      }
+      REQUIRE(fields.size() == 12);
+      REQUIRE(std::stoll(fields[3]) >= 0);
+      REQUIRE(std::stoll(fields[4]) >= 0);
+      expansions += fields[0] == "expand";
+      prunings += fields[0] == "prune";
+    }
+    REQUIRE(expansions > 0);
+    REQUIRE(prunings > 0);
+
+#ifdef FSTALIGN_TRACE_SUMMARY
+    const auto summary = exec(std::string{FSTALIGN_TRACE_SUMMARY} + " " + trace + " --bins 10");
+    REQUIRE_THAT(summary, Contains(std::to_string(expansions) + " states expanded, " + std::to_string(prunings) +
+                                   " prunings"));
+    REQUIRE_THAT(summary, Contains("reference states 0-"));
+    REQUIRE_THAT(summary, Contains("hypothesis states off the diagonal on average"));
+    REQUIRE_THAT(summary, Contains("busiest reference stretches"));
+    REQUIRE_THAT(summary, !Contains("expansions without their reference and hypothesis states"));
+#endif
+    remove(trace.c_str());
+  }
+
   // test oracle WER calculation with lattice FST archive as hypothesis input
   SECTION("oracle_1") {
     const auto result = exec(
@@ -853,7 +1068,399 @@ TEST_CASE_METHOD(UniqueTestsFixture, "main-adapted-composition()") {
     REQUIRE_THAT(result, Contains("WER: INS:0 DEL:1 SUB:0"));
   }
 
+  SECTION("stdin inputs and stdout outputs") {
+    // the logs go to stderr once an output is written to stdout
+    auto result = exec("cat ../test/data/test1.hyp.txt | ./fstalign wer --ref ../test/data/test1.ref.txt --hyp - "
+                       "--json-log - 2> /dev/null");
+    REQUIRE_THAT(result, Contains("\"numErrors\" : 10"));
+    REQUIRE_THAT(result, !Contains("WER: 10/76"));
+
+    result = exec("cat ../test/data/twenty.ref.nlp | ./fstalign wer --ref - --ref-format nlp "
+                  "--ref-json ../test/data/twenty.norm.json --hyp ../test/data/twenty.hyp.txt --syn " +
+                  TEST_SYNONYMS + " --pr_threshold 1 --output-sbs " + sbs_output);
+    REQUIRE(compareFiles(sbs_output.c_str(), (TEST_DATA + "twenty.hyp.sbs").c_str()));
+  }
+
+  SECTION("compressed inputs and outputs") {
+    const auto ref_gz = sbs_output + ".ref.nlp.gz";
+    // the extensions are case insensitive
+    const auto sbs_gz = sbs_output + ".GZ";
+    exec("gzip -c ../test/data/twenty.ref.nlp > " + ref_gz);
+    exec("./fstalign wer --ref " + ref_gz +
+         " --ref-json ../test/data/twenty.norm.json "
+         "--hyp ../test/data/twenty.hyp.txt --syn " +
+         TEST_SYNONYMS + " --pr_threshold 1 --output-sbs " + sbs_gz);
+    exec("gunzip -c " + sbs_gz + " > " + sbs_output);
+    REQUIRE(compareFiles(sbs_output.c_str(), (TEST_DATA + "twenty.hyp.sbs").c_str()));
+    remove(ref_gz.c_str());
+    remove(sbs_gz.c_str());
+  }
+
+  // compiled references
+
+  SECTION("compiled reference (nlp)") {
+    const auto testFile = std::string{TEST_DATA} + "twenty.hyp.sbs";
+    const auto compiled_ref = sbs_output + ".fstalign-ref";
+    exec("./fstalign compile-ref --ref ../test/data/twenty.ref.nlp "
+         "--ref-json ../test/data/twenty.norm.json "
+         "--syn " +
+         TEST_SYNONYMS + " --output " + compiled_ref);
+
+    const auto result = exec("./fstalign wer --ref " + compiled_ref +
+                             " --hyp ../test/data/twenty.hyp.txt "
+                             "--pr_threshold 1 --output-sbs " +
+                             sbs_output);
+    REQUIRE(compareFiles(sbs_output.c_str(), testFile.c_str()));
+    remove(compiled_ref.c_str());
+  }
+
+  SECTION("compiled reference (text)") {
+    const auto compiled_ref = sbs_output + ".fstalign-ref";
+    exec("./fstalign compile-ref --ref ../test/data/test1.ref.txt --output " + compiled_ref);
+
+    const auto result = exec("./fstalign wer --ref " + compiled_ref + " --hyp ../test/data/test1.hyp.txt");
+    REQUIRE_THAT(result, Contains("WER: 10/76 = 0.1316"));
+    REQUIRE_THAT(result, Contains("WER: INS:1 DEL:2 SUB:7"));
+    remove(compiled_ref.c_str());
+  }
+
+  SECTION("compiled reference (same output as the source)") {
+    const auto compiled_ref = sbs_output + ".fstalign-ref";
+    const auto direct_sbs = sbs_output + ".direct";
+    // made of reference words only, so the compiled fst is used as is, in an order
+    // leaving the walk many ties to break
+    const auto reversed_hyp = sbs_output + ".reversed.txt";
+    {
+      std::ifstream ref(TEST_DATA + "test1.ref.txt");
+      std::vector<std::string> words;
+      std::string word;
+      while (ref >> word) {
+        words.push_back(word);
+      }
+      std::ofstream hyp(reversed_hyp);
+      for (auto it = words.rbegin(); it != words.rend(); ++it) {
+        hyp << *it << " ";
+      }
+    }
+
+    struct Case {
+      std::string ref;
+      std::string hyp;
+      // the reference side options, given to both runs
+      std::string ref_options;
+    };
+    const std::vector<Case> cases = {
+        // synonyms and normalizations
+        {TEST_DATA + "syn_7.ref.nlp", TEST_DATA + "syn_7.hyp2.txt",
+         "--syn " + TEST_DATA + "syn_7.synonym.rules.txt --ref-json " + TEST_DATA + "syn_7.norm.json"},
+        // cutoff synonyms
+        {TEST_DATA + "syn_9.ref.txt", TEST_DATA + "syn_9.hyp.txt", "--syn " + TEST_DATA + "syn_9.synonym.rules.txt"},
+        // hyphenated compounds
+        {TEST_DATA + "syn_compound_1.ref.txt", TEST_DATA + "syn_compound_1.hyp.txt", ""},
+        {TEST_DATA + "syn_compound_2.ref.txt", TEST_DATA + "syn_compound_2.hyp.txt", ""},
+        // ctm hypothesis and reference
+        {TEST_DATA + "noise_1.ref.nlp", TEST_DATA + "noise.hyp1.ctm", "--syn " + TEST_SYNONYMS},
+        {TEST_DATA + "syn_8.hyp.ctm", TEST_DATA + "syn_8.ref.nlp", ""},
+        // nlp with class labels
+        {TEST_DATA + "twenty.ref.nlp", TEST_DATA + "twenty.hyp.txt",
+         "--syn " + TEST_SYNONYMS + " --ref-json " + TEST_DATA + "twenty.norm.json"},
+        {TEST_DATA + "test1.ref.txt", reversed_hyp, "--syn " + TEST_SYNONYMS},
+    };
+    for (const auto &c : cases) {
+      INFO(c.ref + " vs " + c.hyp);
+      exec("./fstalign wer --ref " + c.ref + " --hyp " + c.hyp + " " + c.ref_options + " --output-sbs " + direct_sbs);
+      exec("./fstalign compile-ref --ref " + c.ref + " " + c.ref_options + " --output " + compiled_ref);
+      exec("./fstalign wer --ref " + compiled_ref + " --hyp " + c.hyp + " --output-sbs " + sbs_output);
+      REQUIRE(compareFiles(sbs_output, direct_sbs));
+    }
+
+    remove(compiled_ref.c_str());
+    remove(direct_sbs.c_str());
+    remove(reversed_hyp.c_str());
+  }
+
+  SECTION("compiled synonyms") {
+    const auto testFile = std::string{TEST_DATA} + "twenty.hyp.sbs";
+    const auto compiled_syn = sbs_output + ".fstalign-syn";
+    exec("./fstalign compile-synonyms --syn " + TEST_SYNONYMS + " --output " + compiled_syn);
+
+    const auto result = exec(command("wer", approach, "twenty.ref.nlp", "twenty.hyp.txt", sbs_output, "", compiled_syn,
+                                     "twenty.norm.json", false, -1, "--pr_threshold 1"));
+    REQUIRE(compareFiles(sbs_output.c_str(), testFile.c_str()));
+    remove(compiled_syn.c_str());
+  }
+
+  SECTION("hypothesis list") {
+    const auto hyp_list = sbs_output + ".hyps";
+    const auto json_log_1 = sbs_output + ".1.json";
+    const auto json_log_2 = sbs_output + ".2.json";
+    {
+      std::ofstream list(hyp_list);
+      list << "../test/data/test1.hyp.txt\t" << json_log_1 << "\n";
+      list << "# comments and empty lines are skipped\n\n";
+      list << "../test/data/test1.ref.txt\t" << json_log_2 << "\n";
+    }
+
+    const auto result =
+        exec("./fstalign wer --ref ../test/data/test1.ref.txt --threads 2 --hyp-list " + hyp_list);
+    REQUIRE_THAT(result, Contains("test1.hyp.txt: WER: 10/76 = 0.1316 (INS:1 DEL:2 SUB:7)"));
+    REQUIRE_THAT(result, Contains("test1.ref.txt: WER: 0/76 = 0.0000 (INS:0 DEL:0 SUB:0)"));
+
+    std::ifstream json_1(json_log_1);
+    const std::string json_content((std::istreambuf_iterator<char>(json_1)), std::istreambuf_iterator<char>());
+    REQUIRE_THAT(json_content, Contains("\"numErrors\" : 10"));
+
+    remove(hyp_list.c_str());
+    remove(json_log_1.c_str());
+    remove(json_log_2.c_str());
+  }
+
+  SECTION("hypothesis list (same results as separate runs)") {
+    const auto hyp_list = sbs_output + ".hyps";
+    const auto single_log = sbs_output + ".single.json";
+    auto read_wer = [](const std::string &json_log) {
+      std::ifstream in(json_log);
+      Json::Value log;
+      in >> log;
+      return log["wer"];
+    };
+
+    // the reference side options and the hypotheses scored against it
+    const std::vector<std::pair<std::string, std::vector<std::string>>> runs = {
+        {"--ref ../test/data/twenty.ref.nlp --ref-json ../test/data/twenty.norm.json --syn " + TEST_SYNONYMS,
+         {"twenty.hyp.txt", "twenty.hyp.punc_case.txt"}},
+        // the last hypothesis only has reference words
+        {"--ref ../test/data/syn_compound_1.ref.txt",
+         {"syn_compound_1.hyp.txt", "syn_compound_2.hyp.txt", "syn_compound_1.ref.txt"}},
+    };
+    for (const auto &run : runs) {
+      const auto &hyps = run.second;
+      {
+        std::ofstream list(hyp_list);
+        for (size_t i = 0; i < hyps.size(); i++) {
+          list << TEST_DATA + hyps[i] << "\t" << sbs_output << ".list." << i << ".json\n";
+        }
+      }
+      exec("./fstalign wer " + run.first + " --threads 2 --hyp-list " + hyp_list);
+
+      for (size_t i = 0; i < hyps.size(); i++) {
+        INFO(run.first + " --hyp " + hyps[i]);
+        const auto list_log = sbs_output + ".list." + std::to_string(i) + ".json";
+        exec("./fstalign wer " + run.first + " --hyp " + TEST_DATA + hyps[i] + " --json-log " + single_log);
+        REQUIRE(read_wer(list_log) == read_wer(single_log));
+        remove(list_log.c_str());
+      }
+    }
+
+    remove(hyp_list.c_str());
+    remove(single_log.c_str());
+  }
+
+  SECTION("batch") {
+    const auto manifest = sbs_output + ".tsv";
+    const auto json_log = sbs_output + ".json";
+    {
+      std::ofstream tsv(manifest);
+      tsv << "ref\thyp\tref_json\toutput_sbs\n";
+      tsv << "../test/data/test1.ref.txt\t../test/data/test1.hyp.txt\t\t\n";
+      tsv << "../test/data/twenty.ref.nlp\t../test/data/twenty.hyp.txt\t../test/data/twenty.norm.json\t" << sbs_output
+          << "\n";
+    }
+
+    const auto result = exec("./fstalign batch --threads 2 --pr_threshold 1 --syn " + TEST_SYNONYMS + " --manifest " +
+                             manifest + " --json-log " + json_log);
+    REQUIRE_THAT(result, Contains("WER: 10/76 = 0.1316"));
+    REQUIRE_THAT(result, Contains("corpus WER:"));
+    REQUIRE(compareFiles(sbs_output.c_str(), (TEST_DATA + "twenty.hyp.sbs").c_str()));
+
+    std::ifstream json_file(json_log);
+    const std::string json_content((std::istreambuf_iterator<char>(json_file)), std::istreambuf_iterator<char>());
+    REQUIRE_THAT(json_content, Contains("\"corpusWER\""));
+    REQUIRE_THAT(json_content, Contains("\"numFailures\" : 0"));
+
+    remove(manifest.c_str());
+    remove(json_log.c_str());
+  }
+
+  SECTION("batch (shared reference)") {
+    const auto manifest = sbs_output + ".tsv";
+    const auto single_sbs = sbs_output + ".single";
+
+    struct Row {
+      std::string ref;
+      std::string hyp;
+      std::string ref_json;
+    };
+    // each reference is scored by several jobs
+    const std::vector<std::pair<std::string, std::vector<Row>>> batches = {
+        // synonyms and normalizations
+        {TEST_DATA + "syn_7.synonym.rules.txt",
+         {{"syn_7.ref.nlp", "syn_7.hyp.txt", "syn_7.norm.json"},
+          {"syn_7.ref.nlp", "syn_7.hyp2.txt", "syn_7.norm.json"},
+          {"syn_7.ref.nlp", "syn_7.hyp3.txt", "syn_7.norm.json"}}},
+        // hyphenated compounds and nlp with class labels
+        {TEST_SYNONYMS,
+         {{"syn_compound_1.ref.txt", "syn_compound_1.hyp.txt", ""},
+          {"syn_compound_1.ref.txt", "syn_compound_2.hyp.txt", ""},
+          {"twenty.ref.nlp", "twenty.hyp.txt", "twenty.norm.json"},
+          {"twenty.ref.nlp", "twenty.hyp.punc_case.txt", "twenty.norm.json"}}},
+    };
+    for (const auto &batch : batches) {
+      const auto &rows = batch.second;
+      {
+        std::ofstream tsv(manifest);
+        tsv << "ref\thyp\tref_json\toutput_sbs\n";
+        for (size_t i = 0; i < rows.size(); i++) {
+          tsv << TEST_DATA + rows[i].ref << "\t" << TEST_DATA + rows[i].hyp << "\t"
+              << (rows[i].ref_json.empty() ? "" : TEST_DATA + rows[i].ref_json) << "\t" << sbs_output << "." << i
+              << "\n";
+        }
+      }
+      const auto result = exec("./fstalign batch --threads 2 --pr_threshold 1 --syn " + batch.first + " --manifest " +
+                               manifest);
+      REQUIRE_THAT(result, Contains("of the references are scored by several jobs"));
+
+      // the jobs sharing a reference write what scoring their pair alone writes
+      for (size_t i = 0; i < rows.size(); i++) {
+        INFO(rows[i].ref + " vs " + rows[i].hyp);
+        const auto batch_sbs = sbs_output + "." + std::to_string(i);
+        exec(command("wer", approach, rows[i].ref.c_str(), rows[i].hyp.c_str(), single_sbs, "", batch.first,
+                     rows[i].ref_json.empty() ? nullptr : rows[i].ref_json.c_str(), false, -1, "--pr_threshold 1"));
+        REQUIRE(compareFiles(batch_sbs, single_sbs));
+        remove(batch_sbs.c_str());
+      }
+    }
+
+    remove(manifest.c_str());
+    remove(single_sbs.c_str());
+  }
+
+  SECTION("serve (stdin)") {
+    const auto requests = sbs_output + ".requests";
+    {
+      std::ofstream lines(requests);
+      lines << "{\"id\":1,\"ref\":\"../test/data/test1.ref.txt\",\"hyp\":\"../test/data/test1.hyp.txt\"}\n";
+      lines << "{\"id\":2,\"ref\":\"../test/data/test1.ref.txt\",\"hyp\":\"../test/data/test1.ref.txt\"}\n";
+      lines << "{\"id\":3,\"ref\":\"../test/data/missing.txt\",\"hyp\":\"../test/data/test1.hyp.txt\"}\n";
+      lines << "{\"id\":4,\"command\":\"stats\"}\n";
+    }
+
+    // the logs go to stderr, stdout only holds the responses
+    const auto result = exec("./fstalign serve --syn " + TEST_SYNONYMS + " < " + requests + " 2> /dev/null");
+    REQUIRE_THAT(result, Contains("{\"id\":1,\"log\":{\"wer\":{\"bestWER\":{"));
+    REQUIRE_THAT(result, Contains("\"numErrors\":10,\"numWordsInReference\":76"));
+    REQUIRE_THAT(result, Contains("{\"id\":2,\"log\":{\"wer\":{\"bestWER\":{\"deletions\":0,\"insertions\":0"));
+    REQUIRE_THAT(result, Contains("{\"id\":3,\"error\":"));
+    REQUIRE_THAT(result, Contains("\"referenceHits\":1"));
+
+    remove(requests.c_str());
+  }
+
+  SECTION("serve (socket)") {
+    const auto socket_path = sbs_output + ".sock";
+    exec("./fstalign serve --threads 1 --syn " + TEST_SYNONYMS + " --socket " + socket_path + " > /dev/null 2>&1 &");
+
+    int first = connectUnixSocket(socket_path, 10000);
+    REQUIRE(first >= 0);
+    struct stat sb;
+    REQUIRE(stat(socket_path.c_str(), &sb) == 0);
+    REQUIRE((sb.st_mode & 0777) == 0600);
+
+    sendLine(first, "{\"id\":1,\"ref\":\"../test/data/test1.ref.txt\",\"hyp\":\"../test/data/test1.hyp.txt\"}");
+    const auto response = readLine(first, 30000);
+    REQUIRE_THAT(response, Contains("{\"id\":1,\"log\":{\"wer\":{\"bestWER\":{"));
+    REQUIRE_THAT(response, Contains("\"numErrors\":10,\"numWordsInReference\":76"));
+
+    // with --threads 1, a second connection waits for the first one to be closed
+    int second = connectUnixSocket(socket_path, 10000);
+    REQUIRE(second >= 0);
+    sendLine(second, "{\"id\":2,\"command\":\"ping\"}");
+    REQUIRE(readLine(second, 1000).empty());
+    close(first);
+    REQUIRE(readLine(second, 10000) == "{\"id\":2,\"status\":\"ok\"}");
+
+    sendLine(second, "{\"id\":3,\"command\":\"shutdown\"}");
+    REQUIRE(readLine(second, 10000) == "{\"id\":3,\"status\":\"ok\"}");
+    close(second);
+    // the server removes its socket once stopped
+    for (int i = 0; i < 100 && stat(socket_path.c_str(), &sb) == 0; i++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    REQUIRE(stat(socket_path.c_str(), &sb) != 0);
+
+    // a file that isn't a socket is never replaced
+    const auto regular_file = sbs_output + ".not-a-socket";
+    {
+      std::ofstream file(regular_file);
+      file << "keep me\n";
+    }
+    const auto result = exec("./fstalign serve --socket " + regular_file + " 2>&1");
+    REQUIRE_THAT(result, Contains("isn't a socket"));
+    std::ifstream kept(regular_file);
+    std::string content;
+    std::getline(kept, content);
+    REQUIRE(content == "keep me");
+    remove(regular_file.c_str());
+  }
+
   // cleanup (after each test)
   remove(sbs_output.c_str());
   remove(nlp_output.c_str());
 }
+
+TEST_CASE_METHOD(UniqueTestsFixture, "CtmReader") {
+  const auto ctm_path = getOutputSbsPath() + ".ctm";
+  auto write_ctm = [&](const std::string &content) {
+    std::ofstream ctm(ctm_path);
+    ctm << content;
+  };
+  CtmReader reader;
+
+  SECTION("mixed tab and space separators") {
+    write_ctm("rec.wav\t1 0.50\t \t0.25  hello\n\nrec.wav 1\t0.75 0.5\tworld \n");
+    const auto records = reader.read_from_disk(ctm_path);
+    REQUIRE(records.size() == 2);
+    REQUIRE(records[0].recording == "rec.wav");
+    REQUIRE(records[0].channel == "1");
+    REQUIRE(records[0].start_time_secs == 0.5f);
+    REQUIRE(records[0].duration_secs == 0.25f);
+    REQUIRE(records[0].word == "hello");
+    REQUIRE(records[1].start_time_secs == 0.75f);
+    REQUIRE(records[1].word == "world");
+  }
+
+  SECTION("confidence column on some lines") {
+    write_ctm(
+        "rec.wav 1 0.0 0.5 hello 0.8\n"
+        "rec.wav 1 0.5 0.5 big\n"
+        "rec.wav 1 1.0 0.5 world 0.25 extra columns\n");
+    const auto records = reader.read_from_disk(ctm_path);
+    REQUIRE(records.size() == 3);
+    REQUIRE(records[0].confidence == 0.8f);
+    // the default confidence when the column is missing
+    REQUIRE(records[1].confidence == 1.0f);
+    // the columns past the sixth are ignored
+    REQUIRE(records[2].word == "world");
+    REQUIRE(records[2].confidence == 0.25f);
+  }
+
+  SECTION("fewer than 5 columns") {
+    write_ctm("rec.wav 1 0.0 0.5 hello\nrec.wav 1 0.5 big\n");
+    REQUIRE_THROWS_WITH(reader.read_from_disk(ctm_path),
+                        Contains("line 2 of " + ctm_path + " has 4 columns, at least 5 expected"));
+  }
+
+  SECTION("invalid numbers") {
+    write_ctm("rec.wav 1 0.0 0.5 hello\nrec.wav 1 start 0.5 big\n");
+    REQUIRE_THROWS_WITH(reader.read_from_disk(ctm_path), Contains("invalid number [start] on line 2"));
+
+    write_ctm("rec.wav 1 0.0 0.5 hello high\n");
+    REQUIRE_THROWS_WITH(reader.read_from_disk(ctm_path), Contains("invalid number [high] on line 1"));
+
+    // longer than any float
+    write_ctm("rec.wav 1 0.0 0." + std::string(100, '5') + " hello\n");
+    REQUIRE_THROWS_WITH(reader.read_from_disk(ctm_path), Contains("invalid number on line 1"));
+  }
+
+  remove(ctm_path.c_str());
+}
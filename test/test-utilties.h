@@ -1,8 +1,11 @@
 #include <algorithm>
 #include <array>
+#include <chrono>
+#include <cstring>
 #include <fstream>
 #include <iterator>
 #include <string>
+#include <thread>
 #include "src/logging.h"
 #ifndef __TEST_UTILITIES_H__
 #define __TEST_UTILITIES_H__ 1
@@ -13,6 +16,9 @@ const std::string TEST_SYNONYMS = "../sample_data/synonyms.rules.txt";
 #include <direct.h>
 #define GetCurrentDir _getcwd
 #else
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <unistd.h>
 #define GetCurrentDir getcwd
 #endif
@@ -120,4 +126,57 @@ bool compareFiles(const std::string &p1, const std::string &p2) {
                     std::istreambuf_iterator<char>(f2.rdbuf()));
 }
 
+#ifndef WINDOWS
+// Connects to the unix domain socket of a server started in the background, retrying
+// until it listens.  Returns the connected descriptor, or -1 after timeout_ms
+int connectUnixSocket(const std::string &path, int timeout_ms) {
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  while (std::chrono::steady_clock::now() < deadline) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == 0) {
+      return fd;
+    }
+    close(fd);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  return -1;
+}
+
+// Sends a request line on a connected socket
+void sendLine(int fd, const std::string &line) {
+  const auto data = line + "\n";
+  for (size_t sent = 0; sent < data.size();) {
+    auto written = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (written <= 0) {
+      throw std::runtime_error("the connection was closed");
+    }
+    sent += written;
+  }
+}
+
+// Reads a response line from a connected socket, without its newline.  Returns an
+// empty string when nothing complete came within timeout_ms
+std::string readLine(int fd, int timeout_ms) {
+  std::string line;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  char c;
+  while (true) {
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+    struct pollfd pfd = {fd, POLLIN, 0};
+    if (left.count() <= 0 || poll(&pfd, 1, left.count()) <= 0 || read(fd, &c, 1) != 1) {
+      return "";
+    }
+    if (c == '\n') {
+      return line;
+    }
+    line += c;
+  }
+}
+#endif
+
 #endif
@@ -0,0 +1,76 @@
+# Script to gather peak memory metrics of fstalign binaries on large NLP/CTM pairs
+
+# converts a plain text transcript to an NLP reference, one token per row
+text_to_nlp() {
+    local in_txt=$1
+    local out_nlp=$2
+
+    echo "token|speaker|ts|endTs|punctuation|case|tags|wer_tags" > "${out_nlp}"
+    tr -s ' \t' '\n\n' < "${in_txt}" | awk 'NF>0{
+        printf "%s|%d|%.2f|%.2f|%s|LC|[]|[]\n", $1, int(NR / 200) % 2 + 1, NR * 0.5, NR * 0.5 + 0.4, (NR % 12 == 0 ? "." : "")
+    }' >> "${out_nlp}"
+}
+
+# converts a plain text transcript to a CTM hypothesis with confidence scores
+text_to_ctm() {
+    local in_txt=$1
+    local out_ctm=$2
+
+    tr -s ' \t' '\n\n' < "${in_txt}" | awk 'NF>0{
+        printf "recording.wav 1 %.2f 0.40 %s %.2f\n", NR * 0.5, $1, 0.5 + (NR % 50) / 100.0
+    }' > "${out_ctm}"
+}
+
+benchmark_binary() {
+    local binary=$1     # fstalign binary to measure
+    local command=$2    # fstalign subcommand, wer or align
+    local ref=$3        # NLP reference
+    local hyp=$4        # CTM hypothesis
+    local ref_length=$5 # number of words in the reference
+    local outdir=$6     # directory to write outputs and stats to
+    local outcsv=$7     # output to write comma separated stats to
+
+    local stats="${outdir}/stats.${command}.txt"
+    /usr/bin/time -v "${binary}" "${command}" --ref "${ref}" --hyp "${hyp}" \
+        --output-nlp "${outdir}/out.${command}.nlp" 2> "${stats}" > /dev/null
+
+    runtime=$(grep "Elapsed (wall clock) time" "${stats}" | awk 'NF>1{print $NF}')
+    ram=$(grep "Maximum resident set size" "${stats}" | awk 'NF>1{print $NF}')
+
+    echo "${binary},${command},${ref_length},${runtime},${ram}" >> "${outcsv}"
+}
+
+main() {
+    echo "$0 $@"  # Print the command line for logging
+
+    local outcsv=$1
+    shift
+    # binaries to compare, e.g. the previous release and the current build
+    local binaries=("$@")
+    if [ ${#binaries[@]} -eq 0 ]; then
+        binaries=(fstalign)
+    fi
+
+    echo "binary,command,length,runtime,max_rss_kb" >> "${outcsv}"
+
+    dir="temp_memory"
+    mkdir -p "${dir}"
+    for ref_length in 10000 50000 200000; do
+        perl generate_wer_test_data.pl --ins_fract 0.05 \
+            --del_fract 0.05 \
+            --sub_fract 0.1 \
+            --ref_length ${ref_length} \
+            --oref "${dir}/ref.txt" \
+            --ohyp "${dir}/hyp.txt"
+
+        text_to_nlp "${dir}/ref.txt" "${dir}/ref.nlp"
+        text_to_ctm "${dir}/hyp.txt" "${dir}/hyp.ctm"
+
+        for binary in "${binaries[@]}"; do
+            benchmark_binary "${binary}" wer "${dir}/ref.nlp" "${dir}/hyp.ctm" ${ref_length} "${dir}" "${outcsv}"
+            benchmark_binary "${binary}" align "${dir}/ref.nlp" "${dir}/hyp.ctm" ${ref_length} "${dir}" "${outcsv}"
+        done
+    done
+}
+
+main "$@"